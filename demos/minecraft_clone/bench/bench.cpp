@@ -0,0 +1,105 @@
+#include "bench.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <string_view>
+
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+struct Benchmark
+{
+    const char* name;
+    void (*func)(int argc, char** argv);
+    const char* usage;
+};
+
+const Benchmark benchmarks[] = {
+    {"memory", bench::memory_report, "[render_distance] compares paletted and flat tile storage of generated chunks"},
+    {"chunk_map", bench::chunk_map_bench, "[radius] [threads] compares ChunkMap with std::unordered_map"},
+    {"region", bench::region_bench, "[radius] compares loading chunks from region files with generating them"},
+    {"raycast", bench::raycast_bench, "[radius] [rays] measures World::raycast and World::for_each_block_in_aabb over generated terrain"},
+    {"light", bench::light_bench, "[radius] measures initial chunk lighting and light updates after large edits"},
+    {"depth", bench::depth_bench, "[radius] compares generating columns down to different depths"},
+    {"snapshot", bench::snapshot_bench, "[radius] [readers] [frames] meshes chunk snapshots on reader threads while the world is edited"},
+    {"edit", bench::edit_bench, "[radius] compares the bulk edits of World with set_blocks"},
+    {"cursor", bench::cursor_bench, "[radius] [steps] compares BlockCursor with reading tiles through their chunks"},
+    {"mesh", bench::mesh_bench, "[radius_tiles] [edits] measures draw count, meshing latency and remesh cost of the chunk size the game is built with"},
+    {"noise", bench::noise_bench, "[radius] compares the noise backends on batched samples and on chunk generation"},
+    {"climate", bench::climate_bench, "[radius] measures the climate map and how often its biomes differ from per column sampling"},
+    {"lattice", bench::lattice_bench, "[radius] [spacing x y z] compares lattice interpolated warp and cave noise with sampling every tile"},
+    {"caves", bench::cave_bench, "[seeds] [radius] checks that bounding the cave noise over cells changes nothing and measures what it saves"},
+    {"graph", bench::graph_bench, "[rows] compares the terrain height as a noise graph with the same expression written by hand"},
+    {"queue", bench::queue_bench, "[radius] [teleports] [workers] measures how soon the chunks under the camera are generated after teleports"},
+    {"pool", bench::pool_bench, "[radius] [workers] measures remesh latency on the task pool while it generates, per QoS class"},
+    {"decorate", bench::decorate_bench, "[radius] [workers] measures what decorating across chunk borders costs generation"},
+};
+} // namespace
+
+int run_benchmarks(int argc, char** argv)
+{
+    for (auto& benchmark : benchmarks)
+    {
+        if (argc > 0 && std::string_view(argv[0]) == benchmark.name)
+        {
+            benchmark.func(argc - 1, argv + 1);
+            return 0;
+        }
+    }
+
+    fmt::print("usage: mc.out bench <name> [args...]\n");
+    for (auto& benchmark : benchmarks)
+        fmt::print("    {} {}\n", benchmark.name, benchmark.usage);
+
+    return 1;
+}
+
+std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> bench::generate_chunks(WorldGen& gen, const std::vector<glm::ivec2>& poses)
+{
+    std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> chunks;
+
+    std::vector<ChunkGenRequest> requests;
+    for (auto pos : poses)
+        requests.push_back(ChunkGenRequest{.pos = pos});
+
+    gen.in_requests.push(std::move(requests));
+
+    while (chunks.size() < poses.size())
+        gen.out_chunks.fetch_some_blocking(chunks, poses.size() - chunks.size());
+
+    return chunks;
+}
+
+std::vector<glm::ivec2> bench::chunks_in_radius(glm::ivec2 center, int radius)
+{
+    std::vector<glm::ivec2> poses;
+
+    for (int x = -radius; x <= radius; ++x)
+    {
+        int y_range = static_cast<float>(std::sqrt(static_cast<float>(radius * radius - x * x)));
+
+        for (int y = -y_range; y <= y_range; ++y)
+            poses.push_back(center + glm::ivec2(x, y));
+    }
+
+    return poses;
+}
+
+size_t bench::resident_memory()
+{
+    size_t pages = 0, resident_pages = 0;
+
+    if (FILE* f = fopen("/proc/self/statm", "r"))
+    {
+        if (fscanf(f, "%zu %zu", &pages, &resident_pages) != 2) resident_pages = 0;
+        fclose(f);
+    }
+
+    return resident_pages * sysconf(_SC_PAGESIZE);
+}
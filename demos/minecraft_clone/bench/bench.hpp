@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+class Chunk;
+class WorldGen;
+
+// reports and benchmarks that run without a window, started with `mc.out bench <name> [args...]`
+int run_benchmarks(int argc, char** argv);
+
+namespace bench
+{
+// generates whole columns down to world y 0 on the worker threads of gen, in the order they finish
+std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> generate_chunks(WorldGen& gen, const std::vector<glm::ivec2>& poses);
+
+// chunk positions within radius of center, the same area World::update loads
+std::vector<glm::ivec2> chunks_in_radius(glm::ivec2 center, int radius);
+
+// resident set size of the process in bytes, read from /proc/self/statm
+size_t resident_memory();
+
+void memory_report(int argc, char** argv);
+void chunk_map_bench(int argc, char** argv);
+void region_bench(int argc, char** argv);
+void raycast_bench(int argc, char** argv);
+void light_bench(int argc, char** argv);
+void depth_bench(int argc, char** argv);
+void snapshot_bench(int argc, char** argv);
+void edit_bench(int argc, char** argv);
+void cursor_bench(int argc, char** argv);
+void mesh_bench(int argc, char** argv);
+void noise_bench(int argc, char** argv);
+void climate_bench(int argc, char** argv);
+void lattice_bench(int argc, char** argv);
+void cave_bench(int argc, char** argv);
+void graph_bench(int argc, char** argv);
+void queue_bench(int argc, char** argv);
+void pool_bench(int argc, char** argv);
+void decorate_bench(int argc, char** argv);
+} // namespace bench
@@ -0,0 +1,89 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// generates on a single worker, so the time is that of one core
+std::map<std::pair<int, int>, std::unique_ptr<Chunk>> generate(uint64_t seed, const std::vector<glm::ivec2>& poses, bool cave_bounds, double& ms)
+{
+    WorldGen gen(seed);
+    gen.compress_chunks = false;
+    gen.cave_bounds     = cave_bounds;
+    gen.init(1);
+
+    auto start  = Clock::now();
+    auto chunks = bench::generate_chunks(gen, poses);
+    ms += ms_since(start);
+
+    std::map<std::pair<int, int>, std::unique_ptr<Chunk>> by_pos;
+    for (auto& [pos, chunk] : chunks)
+        by_pos[{pos.x, pos.y}] = std::move(chunk);
+
+    return by_pos;
+}
+
+} // namespace
+
+void bench::cave_bench(int argc, char** argv)
+{
+    int seed_count = argc > 0 ? std::atoi(argv[0]) : 16;
+    int radius     = argc > 1 ? std::atoi(argv[1]) : 3;
+
+    auto poses = chunks_in_radius({0, 0}, radius);
+
+    fmt::print("cave benchmark, {} seeds of {} columns on one worker\n", seed_count, poses.size());
+
+    double sampled_ms = 0, bounded_ms = 0;
+    size_t differences = 0, compared = 0;
+
+    for (int s = 0; s < seed_count; ++s)
+    {
+        uint64_t seed = 0xfada23 + s * 7919;
+
+        auto sampled = generate(seed, poses, false, sampled_ms);
+        auto bounded = generate(seed, poses, true, bounded_ms);
+
+        size_t seed_differences = 0;
+
+        for (auto& [pos, chunk] : bounded)
+        {
+            const Chunk* other = sampled.at(pos).get();
+
+            if (chunk->loaded_beg() != other->loaded_beg())
+            {
+                seed_differences++;
+                continue;
+            }
+
+            for (uint32_t y = chunk->loaded_beg() * Chunk::chunk_size; y < Chunk::height; ++y)
+                for (uint32_t z = 0; z < Chunk::chunk_size; ++z)
+                    for (uint32_t x = 0; x < Chunk::chunk_size; ++x)
+                        seed_differences += chunk->get_block(x, y, z) != other->get_block(x, y, z);
+
+            compared += (Chunk::height - chunk->loaded_beg() * Chunk::chunk_size) * Chunk::chunk_surface_area;
+        }
+
+        if (seed_differences) fmt::print("  seed {:#x}: {} tiles differ\n", seed, seed_differences);
+        differences += seed_differences;
+    }
+
+    fmt::print("  sampling every tile: {:.1f} ms, with cell bounds: {:.1f} ms ({:.2f}x)\n", sampled_ms, bounded_ms,
+        sampled_ms / bounded_ms);
+    fmt::print("  {} of {} tiles differ\n", differences, compared);
+}
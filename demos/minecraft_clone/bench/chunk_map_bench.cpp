@@ -0,0 +1,252 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <fmt/core.h>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/chunk_map.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::vector<std::unique_ptr<Chunk>> make_chunks(size_t count)
+{
+    std::vector<std::unique_ptr<Chunk>> chunks(count);
+    for (auto& chunk : chunks)
+        chunk = std::make_unique<Chunk>();
+
+    return chunks;
+}
+
+// the map World used before ChunkMap
+struct UnorderedChunkMap
+{
+    std::unordered_map<glm::ivec2, std::unique_ptr<Chunk>> map;
+
+    Chunk* get(glm::ivec2 pos) const
+    {
+        auto it = map.find(pos);
+        return it != map.end() ? it->second.get() : nullptr;
+    }
+
+    void insert(glm::ivec2 pos, std::unique_ptr<Chunk> chunk) { map[pos] = std::move(chunk); }
+};
+
+struct Results
+{
+    double insert_ms;
+    double lookup_ms;
+    double link_ms;
+};
+
+template <typename Map>
+Results run_single_threaded(const std::vector<glm::ivec2>& poses, const std::vector<glm::ivec2>& queries)
+{
+    Results results;
+
+    {
+        Map map;
+        auto chunks = make_chunks(poses.size());
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < poses.size(); ++i)
+            map.insert(poses[i], std::move(chunks[i]));
+        results.insert_ms = ms_since(start);
+
+        size_t hits = 0;
+
+        start = Clock::now();
+        for (auto pos : queries)
+            hits += map.get(pos) != nullptr;
+        results.lookup_ms = ms_since(start);
+
+        if (hits == 0) fmt::print("no lookup hit\n");
+    }
+
+    {
+        // what World::set_chunk does, four neighbor lookups and the insert
+        Map map;
+        auto chunks = make_chunks(poses.size());
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < poses.size(); ++i)
+        {
+            auto pos   = poses[i];
+            auto chunk = std::move(chunks[i]);
+
+            auto neighbors = chunk->m_neighbor = {
+                .xp = map.get(pos + glm::ivec2(1, 0)),
+                .xn = map.get(pos + glm::ivec2(-1, 0)),
+                .zp = map.get(pos + glm::ivec2(0, 1)),
+                .zn = map.get(pos + glm::ivec2(0, -1)),
+            };
+
+            if (neighbors.xp) neighbors.xp->m_neighbor.xn = chunk.get();
+            if (neighbors.xn) neighbors.xn->m_neighbor.xp = chunk.get();
+            if (neighbors.zp) neighbors.zp->m_neighbor.zn = chunk.get();
+            if (neighbors.zn) neighbors.zn->m_neighbor.zp = chunk.get();
+
+            map.insert(pos, std::move(chunk));
+        }
+        results.link_ms = ms_since(start);
+    }
+
+    return results;
+}
+
+// lookups per second of reader threads while the main thread keeps inserting and erasing a band of chunks
+template <typename Get, typename Insert, typename Erase>
+double run_concurrent(int threads, const std::vector<glm::ivec2>& queries, int radius, Get&& get, Insert&& insert, Erase&& erase)
+{
+    std::atomic<bool> stop           = false;
+    std::atomic<size_t> total_lookups = 0;
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < threads; ++t)
+    {
+        readers.emplace_back([&, t] {
+            size_t lookups = 0, hits = 0;
+
+            for (size_t i = t * 7919; !stop.load(std::memory_order_relaxed); ++i)
+            {
+                hits += get(queries[i % queries.size()]) != nullptr;
+                lookups++;
+            }
+
+            total_lookups += lookups + (hits == 0);
+        });
+    }
+
+    auto start = Clock::now();
+
+    // a strip of chunks beyond the radius, like loading and evicting while moving
+    for (int round = 0; ms_since(start) < 500.0; ++round)
+    {
+        int x = radius + 1 + round % 4;
+
+        for (int z = -radius; z <= radius; ++z)
+            insert(glm::ivec2(x, z));
+        for (int z = -radius; z <= radius; ++z)
+            erase(glm::ivec2(x, z));
+    }
+
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    return total_lookups / (ms_since(start) / 1000.0);
+}
+
+} // namespace
+
+void bench::chunk_map_bench(int argc, char** argv)
+{
+    int radius  = argc > 0 ? std::atoi(argv[0]) : 64;
+    int threads = argc > 1 ? std::atoi(argv[1]) : 6;
+
+    auto poses = chunks_in_radius({0, 0}, radius);
+
+    // lookups in the bounding square of the loaded circle, about 3/4 of them hit
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> dist(-radius, radius);
+
+    std::vector<glm::ivec2> queries(4 * 1024 * 1024);
+    for (auto& query : queries)
+        query = glm::ivec2(dist(rng), dist(rng));
+
+    // chunks usually arrive in generation order, which is roughly this but not exactly
+    std::shuffle(poses.begin(), poses.end(), rng);
+
+    // best of a few runs, alternating between the maps
+    Results unordered = {1e30, 1e30, 1e30}, open = unordered;
+
+    auto keep_best = [](Results& best, const Results& r) {
+        best.insert_ms = std::min(best.insert_ms, r.insert_ms);
+        best.lookup_ms = std::min(best.lookup_ms, r.lookup_ms);
+        best.link_ms   = std::min(best.link_ms, r.link_ms);
+    };
+
+    for (int run = 0; run < 5; ++run)
+    {
+        keep_best(unordered, run_single_threaded<UnorderedChunkMap>(poses, queries));
+        keep_best(open, run_single_threaded<ChunkMap>(poses, queries));
+    }
+
+    fmt::print("chunk map benchmark, {} chunks (radius {}), {} lookups\n", poses.size(), radius, queries.size());
+    fmt::print("{:>16} {:>14} {:>14} {:>14}\n", "", "insert ns/op", "lookup ns/op", "link ns/chunk");
+
+    auto print_row = [&](const char* name, const Results& r) {
+        fmt::print("{:>16} {:14.1f} {:14.1f} {:14.1f}\n", name, r.insert_ms * 1e6 / poses.size(), r.lookup_ms * 1e6 / queries.size(),
+            r.link_ms * 1e6 / poses.size());
+    };
+
+    print_row("unordered_map", unordered);
+    print_row("ChunkMap", open);
+
+    fmt::print("concurrent lookups while inserting and erasing on the main thread:\n");
+
+    for (int t = 1; t <= threads; t *= 2)
+    {
+        double locked_rate = [&] {
+            UnorderedChunkMap map;
+            std::shared_mutex lock;
+            auto chunks = make_chunks(poses.size());
+            for (size_t i = 0; i < poses.size(); ++i)
+                map.insert(poses[i], std::move(chunks[i]));
+
+            return run_concurrent(
+                t, queries, radius,
+                [&](glm::ivec2 pos) {
+                    auto guard = std::shared_lock(lock);
+                    return map.get(pos);
+                },
+                [&](glm::ivec2 pos) {
+                    auto chunk = std::make_unique<Chunk>();
+                    auto guard = std::unique_lock(lock);
+                    map.insert(pos, std::move(chunk));
+                },
+                [&](glm::ivec2 pos) {
+                    std::unique_ptr<Chunk> chunk;
+                    auto guard = std::unique_lock(lock);
+                    if (auto it = map.map.find(pos); it != map.map.end())
+                    {
+                        chunk = std::move(it->second);
+                        map.map.erase(it);
+                    }
+                });
+        }();
+
+        double open_rate = [&] {
+            ChunkMap map;
+            auto chunks = make_chunks(poses.size());
+            for (size_t i = 0; i < poses.size(); ++i)
+                map.insert(poses[i], std::move(chunks[i]));
+
+            return run_concurrent(
+                t, queries, radius,
+                [&](glm::ivec2 pos) { return map.get(pos); },
+                [&](glm::ivec2 pos) { map.insert(pos, std::make_unique<Chunk>()); },
+                [&](glm::ivec2 pos) { map.erase(pos); });
+        }();
+
+        fmt::print("  {} threads: unordered_map + shared_mutex {:8.1f} M/s, ChunkMap {:8.1f} M/s\n", t, locked_rate / 1e6,
+            open_rate / 1e6);
+    }
+}
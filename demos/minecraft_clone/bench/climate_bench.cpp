@@ -0,0 +1,80 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdlib>
+
+#include <fmt/core.h>
+
+#include "../game/world/climate_map.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+void bench::climate_bench(int argc, char** argv)
+{
+    int radius = argc > 0 ? std::atoi(argv[0]) : 48;
+
+    // the noise WorldGen decides biomes with
+    AmplifiedNoise biome(0.003378, 03.2, 5);
+    AmplifiedNoise amp(0.001739, 02.7, 3);
+
+    ClimateMap climate(biome, amp);
+
+    auto poses = chunks_in_radius({0, 0}, radius);
+
+    fmt::print("climate benchmark, {} chunks, regions of {} tiles with a point every {} tiles\n", poses.size(),
+        ClimateMap::region_size, ClimateMap::grid_spacing);
+
+    // the first pass samples the regions, the second one only reads them
+    for (const char* pass : {"cold", "cached"})
+    {
+        size_t uniform = 0;
+
+        auto start = Clock::now();
+        for (auto pos : poses)
+            uniform += climate.chunk_climate(pos).uniform_biome.has_value();
+
+        fmt::print("  {:>6}: {:.3f} ms per chunk, {:.1f}% of chunks have a single biome\n", pass,
+            ms_since(start) / poses.size(), 100.0 * uniform / poses.size());
+    }
+
+    auto stats = climate.stats();
+    fmt::print("  regions: {} hits, {} misses, {} cached\n", stats.region_hits, stats.region_misses, stats.cached_regions);
+
+    // against sampling the noise at every column
+    size_t mismatched = 0, desert = 0;
+
+    auto start = Clock::now();
+    for (auto pos : poses)
+    {
+        ChunkClimate chunk_climate = climate.chunk_climate(pos);
+
+        for (int32_t z = 0; z < Chunk::chunk_size; ++z)
+        {
+            for (int32_t x = 0; x < Chunk::chunk_size; ++x)
+            {
+                double real_x = pos.x * Chunk::chunk_size + x;
+                double real_z = pos.y * Chunk::chunk_size + z;
+
+                Biome exact = ClimateMap::biome_of(climate.aridity(real_x, real_z));
+
+                mismatched += exact != chunk_climate.get(x, z);
+                desert += exact == Biome::desert;
+            }
+        }
+    }
+
+    size_t columns = poses.size() * Chunk::chunk_surface_area;
+
+    fmt::print("  per column sampling (with the lookups): {:.3f} ms per chunk\n", ms_since(start) / poses.size());
+    fmt::print("  {} of {} columns ({:.4f}%) get another biome than the exact noise, {:.1f}% are desert\n", mismatched,
+        columns, 100.0 * mismatched / columns, 100.0 * desert / columns);
+}
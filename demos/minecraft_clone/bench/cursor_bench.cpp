@@ -0,0 +1,143 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include <fmt/core.h>
+
+#include "../game/world/block_cursor.hpp"
+#include "../game/world/world.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// the way tiles are read without a cursor, through the chunk of every position
+Tile block_at(const World& world, glm::ivec3 pos)
+{
+    glm::ivec3 chunk_pos = Chunk::real_pos_to_chunk_pos(pos);
+    glm::ivec3 in_pos    = Chunk::real_pos_to_in_chunk_pos(pos);
+
+    const Chunk* chunk = world.get_chunk({chunk_pos.x, chunk_pos.z});
+
+    return chunk ? chunk->get_block(in_pos.x, Chunk::real_y_to_column_y(pos.y), in_pos.z) : Tile::air;
+}
+
+} // namespace
+
+void bench::cursor_bench(int argc, char** argv)
+{
+    int radius = argc > 0 ? std::atoi(argv[0]) : 4;
+    int steps  = argc > 1 ? std::atoi(argv[1]) : 4'000'000;
+
+    WorldGen gen(0xfada23);
+    gen.init(6);
+
+    World world;
+    for (auto& [pos, chunk] : generate_chunks(gen, chunks_in_radius({0, 0}, radius)))
+    {
+        chunk->m_unsaved = false;
+        world.set_chunk(std::move(chunk), pos);
+    }
+
+    // through the surface, a chunk short of the edge of the loaded area
+    int32_t extent = (radius - 1) * Chunk::chunk_size;
+    glm::ivec3 min = {-extent, 32, -extent}, max = {extent - 1, 95, extent - 1};
+
+    size_t tiles = size_t(max.x - min.x + 1) * (max.y - min.y + 1) * (max.z - min.z + 1);
+
+    fmt::print("cursor benchmark, {} chunks (radius {}), {} tiles\n", world.chunks().size(), radius, tiles);
+
+    // solid tiles among the 26 neighbors of every tile in the box
+    auto start = Clock::now();
+
+    size_t accessor_sum = 0;
+    for (int32_t y = min.y; y <= max.y; ++y)
+        for (int32_t z = min.z; z <= max.z; ++z)
+            for (int32_t x = min.x; x <= max.x; ++x)
+                for (int32_t dy = -1; dy <= 1; ++dy)
+                    for (int32_t dz = -1; dz <= 1; ++dz)
+                        for (int32_t dx = -1; dx <= 1; ++dx)
+                            if (dx || dy || dz) accessor_sum += is_solid(block_at(world, {x + dx, y + dy, z + dz}));
+
+    double accessor_ms = ms_since(start);
+
+    start = Clock::now();
+
+    size_t cursor_sum = 0;
+    for (int32_t y = min.y; y <= max.y; ++y)
+    {
+        for (int32_t z = min.z; z <= max.z; ++z)
+        {
+            BlockCursor cursor(world, {min.x, y, z});
+
+            for (int32_t x = min.x; x <= max.x; ++x, cursor.move(1, 0, 0))
+                for (int32_t dy = -1; dy <= 1; ++dy)
+                    for (int32_t dz = -1; dz <= 1; ++dz)
+                        for (int32_t dx = -1; dx <= 1; ++dx)
+                            if (dx || dy || dz) cursor_sum += is_solid(cursor.get(dx, dy, dz));
+        }
+    }
+
+    double cursor_ms = ms_since(start);
+
+    fmt::print("  26 neighbors: World::get_chunk + get_block {:8.2f} ms, BlockCursor {:8.2f} ms, {:5.1f}x, sums {}\n",
+        accessor_ms, cursor_ms, accessor_ms / cursor_ms, accessor_sum == cursor_sum ? "match" : "DIFFER");
+
+    // unit steps in random directions, turned back at the box
+    auto walk_steps = [&] {
+        std::vector<glm::ivec3> out;
+        out.reserve(steps);
+
+        std::mt19937 rng(0x5eed);
+        glm::ivec3 pos = (min + max) / 2;
+
+        for (int i = 0; i < steps; ++i)
+        {
+            glm::ivec3 d = {};
+            d[rng() % 3] = rng() & 1 ? 1 : -1;
+
+            for (int a = 0; a < 3; ++a)
+                if (pos[a] + d[a] < min[a] || pos[a] + d[a] > max[a]) d[a] = -d[a];
+
+            pos += d;
+            out.push_back(d);
+        }
+
+        return out;
+    }();
+
+    start = Clock::now();
+
+    size_t accessor_walk = 0;
+    glm::ivec3 pos       = (min + max) / 2;
+    for (glm::ivec3 d : walk_steps)
+    {
+        pos += d;
+        accessor_walk += (uint32_t)block_at(world, pos);
+    }
+
+    accessor_ms = ms_since(start);
+
+    start = Clock::now();
+
+    size_t cursor_walk = 0;
+    BlockCursor cursor(world, (min + max) / 2);
+    for (glm::ivec3 d : walk_steps)
+    {
+        cursor.move(d);
+        cursor_walk += (uint32_t)cursor.get();
+    }
+
+    cursor_ms = ms_since(start);
+
+    fmt::print("  random walk:  World::get_chunk + get_block {:8.2f} ms, BlockCursor {:8.2f} ms, {:5.1f}x, sums {}\n",
+        accessor_ms, cursor_ms, accessor_ms / cursor_ms, accessor_walk == cursor_walk ? "match" : "DIFFER");
+}
@@ -0,0 +1,116 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/world_gen.hpp"
+#include "../util/task_pool.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Run
+{
+    double first_ms; // until the first column was handed out
+    double total_ms;
+    WorldGenStats stats;
+    std::vector<TaskPoolWorkerStats> workers;
+
+    size_t leaves;
+    size_t edge_leaves; // within a tile of the edge of their chunk, most of them written by a neighbour's tree
+};
+
+Run generate(int radius, uint32_t worker_count, bool decorations, size_t max_proto_chunks)
+{
+    TaskPool pool(worker_count);
+
+    WorldGen gen(0xfada23);
+    gen.decorations      = decorations;
+    gen.max_proto_chunks = max_proto_chunks;
+    gen.init(pool.worker_count(), pool);
+
+    auto poses = bench::chunks_in_radius({0, 0}, radius);
+
+    std::vector<ChunkGenRequest> requests;
+    for (auto pos : poses)
+        requests.push_back(ChunkGenRequest{.pos = pos});
+
+    Run run = {};
+
+    auto start = Clock::now();
+    gen.in_requests.push(std::move(requests));
+
+    std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> chunks;
+    while (chunks.size() < poses.size())
+    {
+        gen.out_chunks.fetch_some_blocking(chunks, poses.size() - chunks.size());
+        if (run.first_ms == 0) run.first_ms = ms_since(start);
+    }
+
+    run.total_ms = ms_since(start);
+    run.stats    = gen.stats();
+    run.workers  = pool.stats();
+
+    for (auto& [pos, chunk] : chunks)
+    {
+        for (uint32_t y = chunk->loaded_beg() * Chunk::chunk_size; y < Chunk::height; ++y)
+        {
+            for (uint32_t z = 0; z < Chunk::chunk_size; ++z)
+            {
+                for (uint32_t x = 0; x < Chunk::chunk_size; ++x)
+                {
+                    if (chunk->get_block(x, y, z) != Tile::leaf) continue;
+
+                    bool edge = x == 0 || z == 0 || x == Chunk::chunk_size - 1 || z == Chunk::chunk_size - 1;
+
+                    run.leaves++;
+                    run.edge_leaves += edge;
+                }
+            }
+        }
+    }
+
+    return run;
+}
+
+void print_run(const char* name, const Run& run, size_t columns)
+{
+    fmt::print("  {}: {:.1f} ms, first column after {:.1f} ms, {:.2f} ms per column\n", name, run.total_ms, run.first_ms,
+        run.total_ms / columns);
+    fmt::print("    {} stage steps, {} decorated, {} columns held, {} leaves, {} on chunk edges\n", run.stats.stages,
+        run.stats.decorated, run.stats.protos, run.leaves, run.edge_leaves);
+
+    for (size_t i = 0; i < run.workers.size(); ++i)
+    {
+        auto& worker = run.workers[i];
+        fmt::print("    worker {}: {} tasks, {} stolen, {:.1f} ms busy, {:.1f} ms idle\n", i, worker.tasks, worker.steals,
+            worker.busy_ms, worker.idle_ms);
+    }
+}
+
+} // namespace
+
+void bench::decorate_bench(int argc, char** argv)
+{
+    int radius            = argc > 0 ? std::atoi(argv[0]) : 12;
+    uint32_t worker_count = argc > 1 ? std::atoi(argv[1]) : 0;
+
+    size_t columns = chunks_in_radius({0, 0}, radius).size();
+
+    fmt::print("decoration benchmark, {} columns\n", columns);
+
+    print_run("carved only", generate(radius, worker_count, false, 1024), columns);
+    print_run("decorated", generate(radius, worker_count, true, 1024), columns);
+    // the columns decorated early are dropped and generated again when a neighbour needs them later
+    print_run("decorated, 64 columns held", generate(radius, worker_count, true, 64), columns);
+}
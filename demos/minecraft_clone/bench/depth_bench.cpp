@@ -0,0 +1,58 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdlib>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+void bench::depth_bench(int argc, char** argv)
+{
+    int radius = argc > 0 ? std::atoi(argv[0]) : 6;
+
+    auto poses = chunks_in_radius({0, 0}, radius);
+
+    WorldGen gen(0xfada23);
+    gen.init(6);
+
+    fmt::print("depth benchmark, {} columns (radius {}), the world spans y {} to {}\n", poses.size(), radius, Chunk::min_y,
+        Chunk::column_y_to_real_y(Chunk::height));
+
+    // columns are always generated down to the bottom of their surface, deeper vertical chunks only on request
+    for (int32_t bottom_y : {0, -128, -256, Chunk::min_y})
+    {
+        std::vector<ChunkGenRequest> requests;
+        for (auto pos : poses)
+            requests.push_back(ChunkGenRequest{.pos = pos, .beg = (uint32_t)Chunk::real_y_to_column_y(bottom_y) / Chunk::chunk_size});
+
+        auto start = Clock::now();
+
+        gen.in_requests.push(std::move(requests));
+
+        std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> chunks;
+        while (chunks.size() < poses.size())
+            gen.out_chunks.fetch_some_blocking(chunks, poses.size() - chunks.size());
+
+        double seconds = seconds_since(start);
+
+        ChunkMemoryUsage usage;
+        for (auto& [pos, chunk] : chunks)
+            usage += chunk->memory_usage();
+
+        fmt::print("  down to y {:5}: {:8.1f} columns/s (6 threads), {:6} vertical chunks, {:8.2f} MB\n", bottom_y,
+            poses.size() / seconds, usage.vertical_chunks, usage.resident_bytes / (1024.0 * 1024.0));
+    }
+}
@@ -0,0 +1,169 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <optional>
+
+#include <fmt/core.h>
+
+#include "../game/world/light_engine.hpp"
+#include "../game/world/world.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// processes the queued light in one go, returns the milliseconds it took
+double settle(World& world)
+{
+    auto& engine = world.light_engine();
+    auto start   = Clock::now();
+
+    do
+    {
+        engine.start(world.light_budget);
+        engine.wait();
+    } while (engine.stats().pending_nodes > 0);
+
+    return ms_since(start);
+}
+
+// the same edits as BlockEdits for World::set_blocks, tile(pos) returns the new tile or nothing for blocks left as they are
+template <class TileAt>
+std::vector<BlockEdit> box_edits(glm::ivec3 min, glm::ivec3 max, TileAt&& tile_at)
+{
+    std::vector<BlockEdit> edits;
+
+    for (int32_t y = min.y; y <= max.y; ++y)
+        for (int32_t z = min.z; z <= max.z; ++z)
+            for (int32_t x = min.x; x <= max.x; ++x)
+                if (std::optional<Tile> tile = tile_at(glm::ivec3(x, y, z))) edits.push_back(BlockEdit{{x, y, z}, *tile});
+
+    return edits;
+}
+
+} // namespace
+
+void bench::edit_bench(int argc, char** argv)
+{
+    int radius = argc > 0 ? std::atoi(argv[0]) : 6;
+
+    WorldGen gen(0xfada23);
+    gen.init(6);
+
+    // the bulk operations edit one world, set_blocks an identical copy of it
+    World bulk, per_block;
+
+    for (auto& [pos, chunk] : generate_chunks(gen, chunks_in_radius({0, 0}, radius)))
+    {
+        std::vector<uint8_t> data;
+        chunk->serialize(data);
+
+        auto copy = Chunk::deserialize(data.data(), data.size());
+        LightEngine::light_chunk(copy.get());
+
+        // nothing to write back when the worlds are destroyed
+        chunk->m_unsaved = false;
+        copy->m_unsaved  = false;
+
+        bulk.set_chunk(std::move(chunk), pos);
+        per_block.set_chunk(std::move(copy), pos);
+    }
+
+    settle(bulk);
+    settle(per_block);
+
+    fmt::print("edit benchmark, {} chunks (radius {}), 64x64x64 edits through the surface\n", bulk.chunks().size(), radius);
+
+    auto run = [&](const char* name, auto&& bulk_edit, const std::vector<BlockEdit>& edits) {
+        bulk.get_updated_chunks();
+        per_block.get_updated_chunks();
+
+        auto start     = Clock::now();
+        size_t changed = bulk_edit();
+        double bulk_ms = ms_since(start);
+
+        size_t bulk_marked = bulk.get_updated_chunks().size();
+        double bulk_light  = settle(bulk);
+
+        start               = Clock::now();
+        per_block.set_blocks(edits);
+        double per_block_ms = ms_since(start);
+
+        size_t per_block_marked = per_block.get_updated_chunks().size();
+        double per_block_light  = settle(per_block);
+
+        fmt::print("  {:14} {:7} changed: bulk {:8.2f} ms (light {:8.2f} ms), set_blocks {:8.2f} ms (light {:8.2f} ms), "
+                   "{:5.1f}x, {}/{} chunks marked\n",
+            name, changed, bulk_ms, bulk_light, per_block_ms, per_block_light, per_block_ms / bulk_ms, bulk_marked,
+            per_block_marked);
+    };
+
+    glm::ivec3 min = {-32, 32, -32}, max = {31, 95, 31};
+
+    run("fill stone", [&] { return bulk.fill_box(min, max, Tile::stone); },
+        box_edits(min, max, [](glm::ivec3) { return std::optional(Tile::stone); }));
+
+    run("fill air", [&] { return bulk.fill_box(min, max, Tile::air); },
+        box_edits(min, max, [](glm::ivec3) { return std::optional(Tile::air); }));
+
+    glm::ivec3 center = {16, 40, 16};
+    int32_t r         = 32;
+
+    run("sphere r=32", [&] { return bulk.fill_sphere(center, r, Tile::air); },
+        box_edits(center - r, center + r, [&](glm::ivec3 pos) -> std::optional<Tile> {
+            glm::ivec3 d = pos - center;
+            if (d.x * d.x + d.y * d.y + d.z * d.z <= r * r) return Tile::air;
+            return std::nullopt;
+        }));
+
+    min = {-64, -20, 0}, max = {-1, 43, 63};
+
+    // set_blocks has to read every block to find the ones to replace, that is not part of its timing
+    run("replace", [&] { return bulk.replace_in_box(min, max, Tile::stone, Tile::glass); },
+        box_edits(min, max, [&](glm::ivec3 pos) -> std::optional<Tile> {
+            auto* chunk = per_block.get_chunk(Chunk::real_pos_to_chunk_pos(glm::ivec2(pos.x, pos.z)));
+            int32_t y   = Chunk::real_y_to_column_y(pos.y);
+            if (chunk && chunk->get_block(pos.x & (Chunk::chunk_size - 1), y, pos.z & (Chunk::chunk_size - 1)) == Tile::stone) return Tile::glass;
+            return std::nullopt;
+        }));
+
+    auto region = bulk.copy_region(min, max);
+
+    auto start     = Clock::now();
+    auto copy      = bulk.copy_region(min, max);
+    double copy_ms = ms_since(start);
+
+    glm::ivec3 to = {40, 10, -90};
+
+    run("paste", [&] { return bulk.paste_region(region, to); },
+        box_edits(to, to + region.size - 1, [&](glm::ivec3 pos) { return std::optional(region.tiles[region.index(pos - to)]); }));
+
+    fmt::print("  copy_region of 64x64x64: {:.2f} ms\n", copy_ms);
+
+    // a vertical chunk dug out block by block keeps its storage, filling it with the air it holds changes nothing
+    constexpr int32_t size = Chunk::chunk_size;
+
+    min = {0, 0, 0}, max = {size - 1, size - 1, size - 1};
+
+    bulk.set_blocks(box_edits(min, max, [](glm::ivec3) { return std::optional(Tile::air); }));
+    size_t refilled = bulk.fill_box(min, max, Tile::air);
+
+    const Chunk* dug = bulk.get_chunk({0, 0});
+    uint32_t open    = 0;
+    for (int32_t z = 0; z < size; ++z)
+        for (int32_t x = 0; x < size; ++x)
+            open += dug->is_exposed_to_sky(x, Chunk::real_y_to_column_y(0), z);
+
+    fmt::print("  fill air over a dug out vertical chunk: {} changed, {}/{} columns open to the sky\n", refilled, open, size * size);
+
+    auto bulk_usage = bulk.memory_usage(), per_block_usage = per_block.memory_usage();
+    fmt::print("  chunk storage: bulk {:.2f} MB, set_blocks {:.2f} MB\n", bulk_usage.resident_bytes / (1024.0 * 1024.0),
+        per_block_usage.resident_bytes / (1024.0 * 1024.0));
+}
@@ -0,0 +1,132 @@
+#include "bench.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../util/noise.hpp"
+#include "../util/noise_graph.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+using Row = std::array<double, Chunk::chunk_size>;
+
+// the positions of a row of tiles along x and the amplitude of its columns
+struct RowInput
+{
+    Row x, y, z, amp;
+};
+
+} // namespace
+
+void bench::graph_bench(int argc, char** argv)
+{
+    int row_count = argc > 0 ? std::atoi(argv[0]) : 1 << 14;
+    int repeats   = 5;
+
+    namespace ng = noise_graph;
+
+    // the noise of the warped terrain height of WorldGen
+    AmplifiedNoise p(0.006445, 70.3, 92);
+    AmplifiedNoise p1(0.063000, 17.3, 288);
+
+    double base_height = 60.7;
+
+    auto amp    = ng::input(0);
+    auto warp_x = ng::noise(p1, ng::coord_z, ng::coord_x, ng::coord_y);
+    auto warp_z = ng::noise(p1, ng::coord_x, ng::coord_y, ng::coord_z);
+    auto height = ng::warp(ng::noise(p, ng::coord_x, ng::coord_z), warp_x * amp * 0.9, 0, warp_z * amp * 1.1) * amp + base_height;
+
+    std::mt19937 rng(0x5eed);
+    std::uniform_int_distribution<int> coord(-4000, 4000);
+    std::uniform_real_distribution<double> amplitude(-2.7, 2.7);
+
+    std::vector<RowInput> rows(row_count);
+    for (auto& row : rows)
+    {
+        double x = coord(rng), y = coord(rng) / 32, z = coord(rng);
+
+        for (int i = 0; i < Chunk::chunk_size; ++i)
+        {
+            row.x[i]   = x + i;
+            row.y[i]   = y;
+            row.z[i]   = z;
+            row.amp[i] = amplitude(rng);
+        }
+    }
+
+    std::vector<Row> by_hand(row_count), by_graph(row_count);
+
+    // the same expression written out the way WorldGen did before the graph
+    auto hand_written = [&] {
+        Row a, b;
+
+        for (int r = 0; r < row_count; ++r)
+        {
+            const RowInput& row = rows[r];
+
+            p1.noise(row.z.data(), row.x.data(), row.y.data(), a.data(), Chunk::chunk_size);
+            p1.noise(row.x.data(), row.y.data(), row.z.data(), b.data(), Chunk::chunk_size);
+
+            for (int x = 0; x < Chunk::chunk_size; ++x)
+            {
+                a[x] = row.x[x] + a[x] * row.amp[x] * 0.9;
+                b[x] = row.z[x] + b[x] * row.amp[x] * 1.1;
+            }
+
+            p.noise(a.data(), b.data(), a.data(), Chunk::chunk_size);
+
+            for (int x = 0; x < Chunk::chunk_size; ++x)
+                by_hand[r][x] = a[x] * row.amp[x] + base_height;
+        }
+    };
+
+    auto graph = [&] {
+        for (int r = 0; r < row_count; ++r)
+        {
+            const RowInput& row    = rows[r];
+            const double* inputs[] = {row.amp.data()};
+
+            ng::evaluate(height, ng::Batch{row.x.data(), row.y.data(), row.z.data(), inputs}, by_graph[r].data(), Chunk::chunk_size);
+        }
+    };
+
+    fmt::print("noise graph benchmark, warped terrain height over {} rows of {}\n", row_count, Chunk::chunk_size);
+
+    double hand_ms = 1e30, graph_ms = 1e30;
+
+    // alternated, the best of the repeats
+    for (int r = 0; r < repeats; ++r)
+    {
+        auto start = Clock::now();
+        hand_written();
+        hand_ms = std::min(hand_ms, ms_since(start));
+
+        start = Clock::now();
+        graph();
+        graph_ms = std::min(graph_ms, ms_since(start));
+    }
+
+    size_t differences = 0;
+    for (int r = 0; r < row_count; ++r)
+        for (int x = 0; x < Chunk::chunk_size; ++x)
+            differences += by_hand[r][x] != by_graph[r][x];
+
+    double samples = static_cast<double>(row_count) * Chunk::chunk_size;
+
+    fmt::print("  by hand: {:8.1f} ms, {:6.1f} M samples/s\n", hand_ms, samples / hand_ms / 1e3);
+    fmt::print("    graph: {:8.1f} ms, {:6.1f} M samples/s ({:.2f}x), {} samples differ\n", graph_ms, samples / graph_ms / 1e3,
+        hand_ms / graph_ms, differences);
+}
@@ -0,0 +1,151 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/world_gen.hpp"
+#include "../util/noise.hpp"
+#include "../util/noise_lattice.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Generated
+{
+    std::map<std::pair<int, int>, std::unique_ptr<Chunk>> chunks;
+    double ms;
+};
+
+// generates on a single worker, so the time is that of one core
+Generated generate(const std::vector<glm::ivec2>& poses, glm::ivec3 warp_lattice, glm::ivec3 cave_lattice)
+{
+    WorldGen gen(0xfada23);
+    gen.compress_chunks = false;
+    gen.warp_lattice    = warp_lattice;
+    gen.cave_lattice    = cave_lattice;
+    gen.init(1);
+
+    Generated generated;
+
+    auto start   = Clock::now();
+    auto chunks  = bench::generate_chunks(gen, poses);
+    generated.ms = ms_since(start);
+
+    for (auto& [pos, chunk] : chunks)
+        generated.chunks[{pos.x, pos.y}] = std::move(chunk);
+
+    return generated;
+}
+
+// tiles that differ from the reference, over the vertical chunks both have loaded
+size_t count_differences(const Generated& reference, const Generated& generated, size_t& compared)
+{
+    size_t differences = 0;
+
+    for (auto& [pos, chunk] : generated.chunks)
+    {
+        const Chunk* other = reference.chunks.at(pos).get();
+
+        uint32_t beg = std::max(chunk->loaded_beg(), other->loaded_beg()) * Chunk::chunk_size;
+        for (uint32_t y = beg; y < Chunk::height; ++y)
+            for (uint32_t z = 0; z < Chunk::chunk_size; ++z)
+                for (uint32_t x = 0; x < Chunk::chunk_size; ++x)
+                    differences += chunk->get_block(x, y, z) != other->get_block(x, y, z);
+
+        compared += (Chunk::height - beg) * Chunk::chunk_surface_area;
+    }
+
+    return differences;
+}
+
+} // namespace
+
+void bench::lattice_bench(int argc, char** argv)
+{
+    int radius = argc > 0 ? std::atoi(argv[0]) : 6;
+
+    glm::ivec3 spacing = {4, 8, 4};
+    for (int i = 0; i < 3 && i + 1 < argc; ++i)
+        spacing[i] = std::atoi(argv[i + 1]);
+
+    fmt::print("lattice benchmark, spacing {}x{}x{}\n", spacing.x, spacing.y, spacing.z);
+
+    // the error of the interpolated fields against sampling every tile, over a box like the cave pass covers
+    glm::ivec3 box_origin = {-37 * Chunk::chunk_size, -20, 11 * Chunk::chunk_size};
+    glm::ivec3 box_size   = {Chunk::chunk_size, 160, Chunk::chunk_size};
+
+    std::vector<int32_t> tile_x(Chunk::chunk_size);
+    for (int32_t x = 0; x < Chunk::chunk_size; ++x)
+        tile_x[x] = x;
+
+    // the frequencies and amplitudes of the warp and cave noise of WorldGen
+    for (auto [name, freq, amp] : {std::tuple{"warp", 0.063, 17.3}, std::tuple{"cave", 0.0231, 1.0}})
+    {
+        AmplifiedNoise noise(freq, amp, 77);
+
+        auto sampler = [&](const double* x, const double* y, const double* z, double* out, uint32_t count) {
+            noise.noise(x, y, z, out, count);
+        };
+
+        NoiseLattice full(sampler, glm::ivec3(1), box_origin, box_size);
+        NoiseLattice coarse(sampler, spacing, box_origin, box_size);
+
+        std::vector<double> a(Chunk::chunk_size), b(Chunk::chunk_size);
+        double max_error = 0, sum_error = 0;
+
+        for (int32_t y = 0; y < box_size.y; ++y)
+        {
+            for (int32_t z = 0; z < box_size.z; ++z)
+            {
+                full.sample(y, z, tile_x.data(), Chunk::chunk_size, a.data());
+                coarse.sample(y, z, tile_x.data(), Chunk::chunk_size, b.data());
+
+                for (int32_t x = 0; x < Chunk::chunk_size; ++x)
+                {
+                    max_error = std::max(max_error, std::abs(a[x] - b[x]));
+                    sum_error += std::abs(a[x] - b[x]);
+                }
+            }
+        }
+
+        fmt::print("  {} noise (amplitude {}): mean error {:.4f}, max error {:.4f}\n", name, amp,
+            sum_error / (box_size.x * box_size.y * box_size.z), max_error);
+    }
+
+    auto poses = chunks_in_radius({0, 0}, radius);
+
+    fmt::print("  chunk generation, {} columns on one worker:\n", poses.size());
+
+    Generated reference = generate(poses, glm::ivec3(1), glm::ivec3(1));
+    fmt::print("    {:>12}: {:8.1f} ms\n", "full", reference.ms);
+
+    struct Config
+    {
+        const char* name;
+        glm::ivec3 warp, cave;
+    };
+
+    for (auto [name, warp, cave] : {Config{"warp lattice", spacing, glm::ivec3(1)}, Config{"cave lattice", glm::ivec3(1), spacing},
+             Config{"both", spacing, spacing}})
+    {
+        Generated generated = generate(poses, warp, cave);
+
+        size_t compared    = 0;
+        size_t differences = count_differences(reference, generated, compared);
+
+        fmt::print("    {:>12}: {:8.1f} ms ({:.2f}x), {:.3f}% of the loaded tiles ({}) differ from full resolution\n", name,
+            generated.ms, reference.ms / generated.ms, 100.0 * differences / compared, differences);
+    }
+}
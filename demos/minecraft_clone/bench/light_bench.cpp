@@ -0,0 +1,142 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include <fmt/core.h>
+
+#include "../game/world/light_engine.hpp"
+#include "../game/world/world.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// runs light batches of the world's budget until the queues are empty, like consecutive frames would
+void settle(World& world, const char* name, size_t edit_count)
+{
+    auto& engine   = world.light_engine();
+    size_t before  = engine.stats().processed_nodes;
+    size_t batches = 0;
+    auto start     = Clock::now();
+
+    do
+    {
+        engine.start(world.light_budget);
+        engine.wait();
+        batches++;
+    } while (engine.stats().pending_nodes > 0);
+
+    double seconds = seconds_since(start);
+    size_t nodes   = engine.stats().processed_nodes - before;
+
+    fmt::print("  {:24} {:7} edits {:9} nodes {:8.2f} ms {:6.2f} M nodes/s, {} frames of {} nodes\n", name, edit_count,
+        nodes, seconds * 1000.0, nodes / seconds / 1e6, batches, world.light_budget);
+}
+
+} // namespace
+
+void bench::light_bench(int argc, char** argv)
+{
+    int radius = argc > 0 ? std::atoi(argv[0]) : 8;
+
+    WorldGen gen(0xfada23);
+    gen.init(6);
+
+    auto chunks = generate_chunks(gen, chunks_in_radius({0, 0}, radius));
+
+    fmt::print("light benchmark, {} chunks (radius {})\n", chunks.size(), radius);
+
+    // generated chunks are lit already, this relights them on one thread
+    auto start = Clock::now();
+    for (auto& [pos, chunk] : chunks)
+        LightEngine::light_chunk(chunk.get());
+    double light_time = seconds_since(start);
+
+    fmt::print("  light_chunk (1 thread): {:8.1f} chunks/s, {:.1f} us per chunk\n", chunks.size() / light_time,
+        light_time * 1e6 / chunks.size());
+
+    World world;
+
+    for (auto& [pos, chunk] : chunks)
+    {
+        // nothing to write back when the world is destroyed
+        chunk->m_unsaved = false;
+        world.set_chunk(std::move(chunk), pos);
+    }
+
+    settle(world, "chunk borders", 0);
+
+    std::vector<BlockEdit> edits;
+
+    auto sphere = [&](glm::ivec3 center, int r, Tile tile) {
+        edits.clear();
+        for (int x = -r; x <= r; ++x)
+            for (int y = -r; y <= r; ++y)
+                for (int z = -r; z <= r; ++z)
+                    if (x * x + y * y + z * z <= r * r) edits.push_back(BlockEdit{center + glm::ivec3(x, y, z), tile});
+        return world.set_blocks(edits);
+    };
+
+    auto surface = [&](int x, int z) {
+        float top = Chunk::column_y_to_real_y(Chunk::height);
+        auto hit  = world.raycast(glm::vec3(x + 0.5f, top, z + 0.5f), glm::vec3(0.f, -1.f, 0.f), Chunk::height);
+        return glm::ivec3(x, hit ? hit->pos.y : 64, z);
+    };
+
+    glm::ivec3 crater = surface(0, 0);
+
+    size_t applied = sphere(crater, 24, Tile::air);
+    settle(world, "dig sphere r=24", applied);
+
+    applied = sphere(crater, 24, Tile::stone);
+    settle(world, "fill sphere r=24", applied);
+
+    // a roof over a wide area shades everything below it, removing it lets the sun back in
+    edits.clear();
+    for (int x = -64; x < 64; ++x)
+        for (int z = -64; z < 64; ++z)
+            edits.push_back(BlockEdit{glm::ivec3(x, 200, z), Tile::stone});
+
+    applied = world.set_blocks(edits);
+    settle(world, "roof 128x128", applied);
+
+    for (auto& edit : edits)
+        edit.tile = Tile::air;
+
+    applied = world.set_blocks(edits);
+    settle(world, "remove roof", applied);
+
+    std::mt19937 rng(42);
+    int extent = std::max(radius - 2, 1) * Chunk::chunk_size;
+    std::uniform_int_distribution<int> horizontal(-extent, extent);
+
+    edits.clear();
+    for (int i = 0; i < 1000; ++i)
+    {
+        glm::ivec3 pos = surface(horizontal(rng), horizontal(rng));
+        edits.push_back(BlockEdit{pos + glm::ivec3(0, 1, 0), Tile::lamp});
+    }
+
+    applied = world.set_blocks(edits);
+    settle(world, "place 1000 lamps", applied);
+
+    for (auto& edit : edits)
+        edit.tile = Tile::air;
+
+    applied = world.set_blocks(edits);
+    settle(world, "remove 1000 lamps", applied);
+
+    auto usage = world.memory_usage();
+    auto pool  = Chunk::light_array_pool().stats();
+
+    fmt::print("  light arrays: {} live ({:.2f} MB), chunk storage in total {:.2f} MB\n", pool.live_blocks,
+        pool.live_blocks * (double)Chunk::light_array_bytes / (1024.0 * 1024.0), usage.resident_bytes / (1024.0 * 1024.0));
+}
@@ -0,0 +1,58 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdlib>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+void print_usage(const char* name, const ChunkMemoryUsage& usage)
+{
+    fmt::print("{:>10}: {:8.2f} MB in {} vertical chunks ({:.1f} KB per vertical chunk)\n", name,
+        usage.resident_bytes / (1024.0 * 1024.0), usage.vertical_chunks,
+        usage.vertical_chunks ? usage.resident_bytes / 1024.0 / usage.vertical_chunks : 0.0);
+}
+} // namespace
+
+void bench::memory_report(int argc, char** argv)
+{
+    int render_distance = argc > 0 ? std::atoi(argv[0]) : 10;
+
+    WorldGen gen(0xfada23);
+    gen.compress_chunks = false;
+    gen.init(6);
+
+    auto chunks = generate_chunks(gen, chunks_in_radius({0, 0}, render_distance));
+
+    ChunkMemoryUsage flat;
+    for (auto& [pos, chunk] : chunks)
+        flat += chunk->memory_usage();
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto& [pos, chunk] : chunks)
+        chunk->compress();
+
+    double compress_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    ChunkMemoryUsage paletted;
+    for (auto& [pos, chunk] : chunks)
+        paletted += chunk->memory_usage();
+
+    fmt::print("memory report for {} chunks (render distance {})\n", chunks.size(), render_distance);
+    print_usage("flat", flat);
+    print_usage("paletted", paletted);
+    fmt::print("  paletted storage takes {:.1f}% of flat, compressing took {:.2f} ms ({:.1f} us per chunk)\n",
+        100.0 * paletted.resident_bytes / flat.resident_bytes, compress_ms, compress_ms * 1000.0 / chunks.size());
+    fmt::print("  process rss: {:.2f} MB\n", resident_memory() / (1024.0 * 1024.0));
+
+    auto pool = Chunk::tile_array_pool().stats();
+    fmt::print("  tile array pool: {} live, {} peak, {} reserved in {} slabs ({:.2f} MB)\n", pool.live_blocks, pool.peak_blocks,
+        pool.reserved_blocks, pool.slab_count, pool.reserved_blocks * pool.block_size / (1024.0 * 1024.0));
+    fmt::print("  bits per tile: 1: {} 2: {} 4: {} 8: {}, uniform (no storage): {}\n",
+        paletted.bits_histogram[0], paletted.bits_histogram[1], paletted.bits_histogram[2], paletted.bits_histogram[3], paletted.uniform_chunks);
+}
@@ -0,0 +1,128 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk_snapshot.hpp"
+#include "../game/world/world.hpp"
+#include "../game/world/world_gen.hpp"
+#include "../render/chunk/chunk_mesher.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+void bench::mesh_bench(int argc, char** argv)
+{
+    int radius_tiles = argc > 0 ? std::atoi(argv[0]) : 192;
+    int edit_count   = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+    // the same area whatever the chunk size
+    int radius = std::max(radius_tiles / Chunk::chunk_size, 2);
+
+    WorldGen gen(0xfada23);
+    gen.init(6);
+
+    World world;
+    std::vector<const Chunk*> chunks;
+
+    for (auto& [pos, chunk] : generate_chunks(gen, chunks_in_radius({0, 0}, radius)))
+    {
+        chunk->m_unsaved = false;
+        chunks.push_back(chunk.get());
+        world.set_chunk(std::move(chunk), pos);
+    }
+
+    fmt::print("mesh benchmark, {}^3 vertical chunks, {} per column, {} columns (radius {} tiles)\n", Chunk::chunk_size,
+        Chunk::vertical_chunk_count, chunks.size(), radius * Chunk::chunk_size);
+
+    // the worst case mesh is a checkerboard, a face on every side of half the tiles
+    std::vector<Quad> quads(3 * Chunk::chunk_volume);
+
+    // meshes the vertical chunk like the renderer does, returns the quad count
+    auto mesh = [&](const Chunk* chunk, uint32_t vertical_chunk) -> size_t {
+        Quad* it = quads.data();
+        mesh_vertical_chunk(ChunkSnapshot(chunk, vertical_chunk), it, quads.data() + quads.size());
+        return it - quads.data();
+    };
+
+    size_t draws = 0, total_quads = 0, meshed = 0;
+    double total_ms = 0, max_ms = 0;
+
+    for (const Chunk* chunk : chunks)
+    {
+        for (uint32_t v = chunk->loaded_beg(); v < Chunk::vertical_chunk_count; ++v)
+        {
+            if (chunk->is_vertical_chunk_empty(v)) continue;
+
+            auto start   = Clock::now();
+            size_t count = mesh(chunk, v);
+            double ms    = ms_since(start);
+
+            meshed++;
+            total_ms += ms;
+            max_ms = std::max(max_ms, ms);
+
+            // every mesh is a draw of its own
+            draws += count != 0;
+            total_quads += count;
+        }
+    }
+
+    fmt::print("  initial meshing: {} vertical chunks in {:.1f} ms, {:.3f} ms mean, {:.3f} ms max\n", meshed, total_ms,
+        total_ms / meshed, max_ms);
+    fmt::print("  draws: {}, quads: {} ({:.0f} per draw, {:.2f} MB of vertices)\n", draws, total_quads,
+        (double)total_quads / draws, total_quads * sizeof(Quad) / (1024.0 * 1024.0));
+
+    // digs single blocks at the surface and remeshes what each one marked, the edit at the border of a vertical
+    // chunk also remeshes its neighbor
+    std::mt19937 rng(0x5eed);
+    int32_t extent = (radius - 1) * Chunk::chunk_size;
+
+    world.get_updated_chunks();
+
+    size_t remeshed = 0;
+    double remesh_ms = 0, max_remesh_ms = 0;
+
+    for (int i = 0; i < edit_count; ++i)
+    {
+        int32_t x = (int32_t)(rng() % (2 * extent)) - extent;
+        int32_t z = (int32_t)(rng() % (2 * extent)) - extent;
+
+        glm::ivec3 in_pos  = Chunk::real_pos_to_in_chunk_pos({x, 0, z});
+        const Chunk* chunk = world.get_chunk(Chunk::real_pos_to_chunk_pos(glm::ivec2(x, z)));
+
+        uint32_t height = chunk ? chunk->get_height(in_pos.x, in_pos.z) : 0;
+        if (height == 0) continue;
+
+        world.set_block({x, Chunk::column_y_to_real_y(height - 1), z}, Tile::air);
+
+        auto start = Clock::now();
+
+        for (auto [updated, mask] : world.get_updated_chunks())
+        {
+            for (; mask; mask &= mask - 1, remeshed++)
+                mesh(updated, std::countr_zero(mask));
+        }
+
+        double ms = ms_since(start);
+
+        remesh_ms += ms;
+        max_remesh_ms = std::max(max_remesh_ms, ms);
+    }
+
+    fmt::print("  remesh after a block edit: {:.3f} ms mean, {:.3f} ms max, {:.2f} vertical chunks per edit\n",
+        remesh_ms / edit_count, max_remesh_ms, (double)remeshed / edit_count);
+}
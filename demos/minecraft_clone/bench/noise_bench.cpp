@@ -0,0 +1,137 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/world_gen.hpp"
+#include "../util/noise.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+constexpr NoiseBackend backends[] = {NoiseBackend::scalar, NoiseBackend::sse41, NoiseBackend::avx2};
+
+// evaluates the samples in batches of a chunk row, returns the samples per second
+template <class T>
+double measure_kernel(const AmplifiedNoise& noise, const std::vector<T>& x, const std::vector<T>& y, const std::vector<T>& z,
+    std::vector<T>& out, bool three_d, int repeats)
+{
+    auto start = Clock::now();
+
+    for (int r = 0; r < repeats; ++r)
+    {
+        for (size_t i = 0; i < x.size(); i += Chunk::chunk_size)
+        {
+            uint32_t count = std::min<size_t>(Chunk::chunk_size, x.size() - i);
+
+            if (three_d)
+                noise.noise(x.data() + i, y.data() + i, z.data() + i, out.data() + i, count);
+            else
+                noise.noise(x.data() + i, y.data() + i, out.data() + i, count);
+        }
+    }
+
+    return x.size() * repeats / (ms_since(start) / 1000.0);
+}
+
+} // namespace
+
+void bench::noise_bench(int argc, char** argv)
+{
+    int radius = argc > 0 ? std::atoi(argv[0]) : 8;
+
+    NoiseBackend initial = get_noise_backend();
+
+    // the same frequency and amplitude as the warp noise of WorldGen, sampled along rows of tiles like WorldGen does
+    AmplifiedNoise noise(0.063, 17.3, 288);
+
+    std::mt19937 rng(0x5eed);
+    std::uniform_int_distribution<int> coord(-4000, 4000);
+
+    size_t sample_count = 1 << 16;
+    int repeats         = 10;
+
+    std::vector<double> x(sample_count), y(sample_count), z(sample_count), out(sample_count), expected(sample_count);
+    for (size_t i = 0; i < sample_count; i += Chunk::chunk_size)
+    {
+        double row_x = coord(rng), row_y = coord(rng) / 16, row_z = coord(rng);
+
+        for (int j = 0; j < Chunk::chunk_size; ++j)
+        {
+            x[i + j] = row_x + j;
+            y[i + j] = row_y;
+            z[i + j] = row_z;
+        }
+    }
+
+    std::vector<float> xf(x.begin(), x.end()), yf(y.begin(), y.end()), zf(z.begin(), z.end()), outf(sample_count);
+
+    fmt::print("noise benchmark, {} samples in rows of {}\n", sample_count, Chunk::chunk_size);
+
+    for (bool three_d : {false, true})
+    {
+        fmt::print("  {}d noise:\n", three_d ? 3 : 2);
+
+        for (size_t i = 0; i < sample_count; ++i)
+            expected[i] = three_d ? noise.noise(x[i], y[i], z[i]) : noise.noise(x[i], y[i]);
+
+        for (NoiseBackend backend : backends)
+        {
+            if (!is_noise_backend_supported(backend)) continue;
+            set_noise_backend(backend);
+
+            double rate   = measure_kernel(noise, x, y, z, out, three_d, repeats);
+            double rate_f = measure_kernel(noise, xf, yf, zf, outf, three_d, repeats);
+
+            double diff = 0, diff_f = 0;
+            for (size_t i = 0; i < sample_count; ++i)
+            {
+                diff   = std::max(diff, std::abs(out[i] - expected[i]));
+                diff_f = std::max(diff_f, std::abs(outf[i] - expected[i]));
+            }
+
+            fmt::print("    {:>7}: double {:6.1f} M samples/s (max diff {:.1e}), float {:6.1f} M samples/s (max diff {:.1e})\n",
+                noise_backend_name(backend), rate / 1e6, diff, rate_f / 1e6, diff_f);
+        }
+    }
+
+    // a single worker gives the throughput of one core
+    auto poses = chunks_in_radius({0, 0}, radius);
+
+    fmt::print("  chunk generation, {} columns on one worker:\n", poses.size());
+
+    double scalar_rate = 0;
+
+    for (NoiseBackend backend : backends)
+    {
+        if (!is_noise_backend_supported(backend)) continue;
+        set_noise_backend(backend);
+
+        WorldGen gen(0xfada23);
+        gen.init(1);
+
+        auto start  = Clock::now();
+        auto chunks = generate_chunks(gen, poses);
+        double ms   = ms_since(start);
+
+        double rate = chunks.size() / (ms / 1000.0);
+        if (backend == NoiseBackend::scalar) scalar_rate = rate;
+
+        fmt::print("    {:>7}: {:8.1f} ms, {:6.1f} columns/s per core ({:.2f}x)\n", noise_backend_name(backend), ms, rate,
+            rate / scalar_rate);
+    }
+
+    set_noise_backend(initial);
+}
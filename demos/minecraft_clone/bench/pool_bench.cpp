@@ -0,0 +1,137 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk_snapshot.hpp"
+#include "../game/world/world_gen.hpp"
+#include "../render/chunk/chunk_mesher.hpp"
+#include "../util/task_pool.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct RemeshTimes
+{
+    std::vector<double> latency_ms; // from submitting a remesh until it finished
+    double generation_ms;
+    std::vector<TaskPoolWorkerStats> workers;
+};
+
+// generates the chunks in radius on the pool while the vertical chunks of meshed are remeshed on it every few ms, the
+// way a player editing the world while flying would
+RemeshTimes remesh_while_generating(const std::vector<const Chunk*>& meshed, int radius, uint32_t worker_count, TaskQoS remesh_qos)
+{
+    TaskPool pool(worker_count);
+
+    WorldGen gen(0x5eed);
+    gen.init(pool.worker_count(), pool);
+
+    auto poses = bench::chunks_in_radius({0, 0}, radius);
+
+    std::vector<ChunkGenRequest> requests;
+    for (auto pos : poses)
+        requests.push_back(ChunkGenRequest{.pos = pos});
+
+    RemeshTimes times;
+    times.latency_ms.resize(meshed.size());
+
+    std::atomic<size_t> remeshed = 0;
+
+    auto start = Clock::now();
+    gen.in_requests.push(std::move(requests));
+
+    for (size_t i = 0; i < meshed.size(); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        pool.submit(remesh_qos, [&, i, submitted = Clock::now()] {
+            const Chunk* chunk = meshed[i];
+
+            // the worst case mesh is a checkerboard, a face on every side of half the tiles
+            thread_local std::vector<Quad> quads(3 * Chunk::chunk_volume);
+
+            for (uint32_t v = chunk->loaded_beg(); v < Chunk::vertical_chunk_count; ++v)
+            {
+                Quad* it = quads.data();
+                if (!chunk->is_vertical_chunk_empty(v)) mesh_vertical_chunk(ChunkSnapshot(chunk, v), it, quads.data() + quads.size());
+            }
+
+            times.latency_ms[i] = ms_since(submitted);
+            remeshed++;
+        });
+    }
+
+    std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> chunks;
+    while (chunks.size() < poses.size())
+        gen.out_chunks.fetch_some_blocking(chunks, poses.size() - chunks.size());
+
+    times.generation_ms = ms_since(start);
+
+    while (remeshed < meshed.size())
+        std::this_thread::yield();
+
+    times.workers = pool.stats();
+
+    return times;
+}
+
+} // namespace
+
+void bench::pool_bench(int argc, char** argv)
+{
+    int radius            = argc > 0 ? std::atoi(argv[0]) : 8;
+    uint32_t worker_count = argc > 1 ? std::atoi(argv[1]) : 0;
+    int remesh_count      = 100;
+
+    // the chunks that get remeshed, generated up front
+    WorldGen gen(0xfada23);
+    gen.init(1);
+
+    std::vector<std::unique_ptr<Chunk>> owned;
+    std::vector<const Chunk*> meshed;
+
+    for (auto& [pos, chunk] : generate_chunks(gen, chunks_in_radius({0, 0}, 5)))
+        owned.push_back(std::move(chunk));
+
+    for (int i = 0; i < remesh_count; ++i)
+        meshed.push_back(owned[i % owned.size()].get());
+
+    fmt::print("task pool benchmark, {} columns generated while {} columns are remeshed every 5 ms\n", chunks_in_radius({0, 0}, radius).size(),
+        remesh_count);
+
+    for (TaskQoS qos : {TaskQoS::background, TaskQoS::latency_critical})
+    {
+        auto times = remesh_while_generating(meshed, radius, worker_count, qos);
+
+        std::sort(times.latency_ms.begin(), times.latency_ms.end());
+
+        double mean = 0;
+        for (double ms : times.latency_ms)
+            mean += ms / times.latency_ms.size();
+
+        fmt::print("  remeshing as {}, {} workers:\n", qos == TaskQoS::background ? "background" : "latency critical",
+            times.workers.size());
+        fmt::print("    remesh latency {:.1f} ms mean, {:.1f} ms median, {:.1f} ms max, generation took {:.1f} ms\n", mean,
+            times.latency_ms[times.latency_ms.size() / 2], times.latency_ms.back(), times.generation_ms);
+
+        for (size_t i = 0; i < times.workers.size(); ++i)
+        {
+            auto& worker = times.workers[i];
+            fmt::print("    worker {}: {} tasks, {} stolen, {:.1f} ms busy, {:.1f} ms idle\n", i, worker.tasks, worker.steals,
+                worker.busy_ms, worker.idle_ms);
+        }
+    }
+}
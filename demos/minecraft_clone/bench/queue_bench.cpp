@@ -0,0 +1,138 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct TeleportTimes
+{
+    double center_ms; // until the chunk under the camera is generated
+    double near_ms;   // until the chunks within near_radius of it are
+};
+
+struct Run
+{
+    std::vector<TeleportTimes> times;
+    GenQueueStats stats;
+};
+
+constexpr int near_radius = 2;
+
+// the chunks around center in the order World::update requests them
+std::vector<ChunkGenRequest> scan_order(glm::ivec2 center, int radius)
+{
+    std::vector<ChunkGenRequest> requests;
+
+    for (auto pos : bench::chunks_in_radius(center, radius))
+        requests.push_back(ChunkGenRequest{.pos = pos});
+
+    return requests;
+}
+
+// teleports without waiting for the chunks of the previous spot to finish, like a player flying fast would
+Run teleport(int radius, int teleports, int workers, bool focus)
+{
+    WorldGen gen(0xfada23);
+    gen.init(workers);
+
+    Run run;
+    std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> chunks;
+
+    for (int t = 0; t < teleports; ++t)
+    {
+        glm::ivec2 center = {t * 997, -t * 661};
+
+        auto start = Clock::now();
+
+        if (focus)
+        {
+            // the camera looks along +x
+            gen.in_requests.set_focus(GenFocus{
+                .pos             = glm::vec2(center) + 0.5f,
+                .dir             = {1, 0},
+                .cancel_distance = static_cast<float>(radius + 3),
+            });
+        }
+
+        gen.in_requests.push(scan_order(center, radius));
+
+        int near_count   = 0;
+        int near_total   = 0;
+        TeleportTimes tt = {-1, -1};
+
+        for (int x = -near_radius; x <= near_radius; ++x)
+            for (int z = -near_radius; z <= near_radius; ++z)
+                near_total += x * x + z * z <= near_radius * near_radius;
+
+        while (tt.near_ms < 0)
+        {
+            chunks.clear();
+            gen.out_chunks.fetch_some_blocking(chunks, 64);
+
+            for (auto& [pos, chunk] : chunks)
+            {
+                auto diff = pos - center;
+                if (diff.x * diff.x + diff.y * diff.y > near_radius * near_radius) continue;
+
+                if (diff == glm::ivec2(0)) tt.center_ms = ms_since(start);
+                if (++near_count == near_total) tt.near_ms = ms_since(start);
+            }
+        }
+
+        run.times.push_back(tt);
+    }
+
+    run.stats = gen.in_requests.stats();
+
+    return run;
+}
+
+} // namespace
+
+void bench::queue_bench(int argc, char** argv)
+{
+    int radius    = argc > 0 ? std::atoi(argv[0]) : 8;
+    int teleports = argc > 1 ? std::atoi(argv[1]) : 6;
+    int workers   = argc > 2 ? std::atoi(argv[2]) : 2;
+
+    fmt::print("generation queue benchmark, {} teleports, {} chunks requested per teleport, {} workers\n", teleports,
+        chunks_in_radius({0, 0}, radius).size(), workers);
+    fmt::print("  time until the chunk under the camera and the chunks within {} of it are generated:\n", near_radius);
+
+    for (bool focus : {false, true})
+    {
+        auto [times, stats] = teleport(radius, teleports, workers, focus);
+
+        double center_sum = 0, center_max = 0, near_sum = 0, near_max = 0;
+
+        for (auto& tt : times)
+        {
+            center_sum += tt.center_ms;
+            center_max = std::max(center_max, tt.center_ms);
+            near_sum += tt.near_ms;
+            near_max = std::max(near_max, tt.near_ms);
+        }
+
+        fmt::print("    {:>11}: center {:8.1f} ms mean {:8.1f} ms max, near {:8.1f} ms mean {:8.1f} ms max\n",
+            focus ? "focused" : "in order", center_sum / times.size(), center_max, near_sum / times.size(), near_max);
+        fmt::print("                 {} requests, {} cancelled, {} still queued\n", stats.pushed, stats.cancelled, stats.queued);
+
+        for (size_t i = 0; i < times.size(); ++i)
+            fmt::print("        teleport {}: {:8.1f} ms, {:8.1f} ms\n", i, times[i].center_ms, times[i].near_ms);
+    }
+}
@@ -0,0 +1,180 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <random>
+
+#include <fmt/core.h>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "../game/world/world.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 dir;
+};
+
+// the same traversal without any caching, every block is looked up through World::get_chunk and Chunk::get_block
+std::optional<glm::ivec3> naive_raycast(const World& world, glm::vec3 origin, glm::vec3 dir, float max_dist)
+{
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+
+    dir = glm::normalize(dir);
+
+    glm::ivec3 pos = glm::floor(origin);
+    glm::ivec3 step;
+    glm::vec3 t_max, t_delta;
+
+    for (int a = 0; a < 3; ++a)
+    {
+        step[a]    = dir[a] > 0.f ? 1 : dir[a] < 0.f ? -1 : 0;
+        t_delta[a] = step[a] ? 1.f / std::abs(dir[a]) : infinity;
+        t_max[a]   = step[a] ? ((pos[a] + (step[a] > 0)) - origin[a]) / dir[a] : infinity;
+    }
+
+    for (float t = 0.f; t <= max_dist;)
+    {
+        int32_t y = Chunk::real_y_to_column_y(pos.y);
+
+        if (y >= 0 && y < Chunk::height)
+        {
+            if (auto* chunk = world.get_chunk(Chunk::real_pos_to_chunk_pos(glm::ivec2(pos.x, pos.z))))
+            {
+                if (chunk->get_block(pos.x & (Chunk::chunk_size - 1), y, pos.z & (Chunk::chunk_size - 1)) != Tile::air)
+                    return pos;
+            }
+        }
+
+        int axis = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+
+        t = t_max[axis];
+        pos[axis] += step[axis];
+        t_max[axis] += t_delta[axis];
+    }
+
+    return std::nullopt;
+}
+
+size_t naive_count_in_aabb(const World& world, glm::ivec3 min, glm::ivec3 max)
+{
+    size_t count = 0;
+
+    for (int32_t z = min.z; z <= max.z; ++z)
+    {
+        for (int32_t x = min.x; x <= max.x; ++x)
+        {
+            auto* chunk = world.get_chunk(Chunk::real_pos_to_chunk_pos(glm::ivec2(x, z)));
+            if (chunk == nullptr) continue;
+
+            int32_t y_beg = std::max(Chunk::real_y_to_column_y(min.y), 0);
+            int32_t y_end = std::min(Chunk::real_y_to_column_y(max.y), Chunk::height - 1);
+
+            for (int32_t y = y_beg; y <= y_end; ++y)
+                count += chunk->get_block(x & (Chunk::chunk_size - 1), y, z & (Chunk::chunk_size - 1)) != Tile::air;
+        }
+    }
+
+    return count;
+}
+
+} // namespace
+
+void bench::raycast_bench(int argc, char** argv)
+{
+    int radius       = argc > 0 ? std::atoi(argv[0]) : 8;
+    size_t ray_count = argc > 1 ? std::atoi(argv[1]) : 200'000;
+
+    WorldGen gen(0xfada23);
+    gen.init(6);
+
+    World world;
+
+    for (auto& [pos, chunk] : generate_chunks(gen, chunks_in_radius({0, 0}, radius)))
+    {
+        // nothing to write back when the world is destroyed
+        chunk->m_unsaved = false;
+        world.set_chunk(std::move(chunk), pos);
+    }
+
+    // origins stay a few chunks inside the loaded area, above and below the surface
+    std::mt19937 rng(1234);
+    float extent = std::max(radius - 3, 1) * Chunk::chunk_size * 0.7f;
+    std::uniform_real_distribution<float> horizontal(-extent, extent), vertical(20.f, 160.f), unit(-1.f, 1.f);
+
+    std::vector<Ray> rays(ray_count);
+    for (auto& ray : rays)
+    {
+        ray.origin = {horizontal(rng), vertical(rng), horizontal(rng)};
+
+        do ray.dir = {unit(rng), unit(rng), unit(rng)};
+        while (glm::length(ray.dir) < 0.1f || glm::length(ray.dir) > 1.f);
+    }
+
+    fmt::print("raycast benchmark, {} chunks (radius {}), {} rays\n", world.chunks().size(), radius, rays.size());
+
+    for (float max_dist : {8.f, 64.f, 256.f})
+    {
+        size_t hits = 0, mismatches = 0;
+
+        auto start = Clock::now();
+        for (auto& ray : rays)
+            hits += world.raycast(ray.origin, ray.dir, max_dist).has_value();
+        double seconds = seconds_since(start);
+
+        start = Clock::now();
+        for (auto& ray : rays)
+            naive_raycast(world, ray.origin, ray.dir, max_dist);
+        double naive_seconds = seconds_since(start);
+
+        for (auto& ray : rays)
+        {
+            auto hit   = world.raycast(ray.origin, ray.dir, max_dist);
+            auto naive = naive_raycast(world, ray.origin, ray.dir, max_dist);
+            mismatches += hit.has_value() != naive.has_value() || (hit && hit->pos != *naive);
+        }
+
+        fmt::print("  max distance {:5.0f}: {:10.0f} rays/s, naive {:10.0f} rays/s ({:.1f}x), {:5.1f}% hit, {} mismatches\n",
+            max_dist, rays.size() / seconds, rays.size() / naive_seconds, naive_seconds / seconds, 100.0 * hits / rays.size(), mismatches);
+    }
+
+    for (glm::ivec3 box_size : {glm::ivec3(1, 2, 1), glm::ivec3(16, 16, 16), glm::ivec3(64, 64, 64)})
+    {
+        size_t query_count = std::max<size_t>(rays.size() / (box_size.x * box_size.y * box_size.z), 100);
+        size_t blocks = 0, naive_blocks = 0;
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < query_count; ++i)
+        {
+            glm::ivec3 min = glm::floor(rays[i % rays.size()].origin);
+            world.for_each_block_in_aabb(min, min + box_size - 1, [&](glm::ivec3, Tile) { blocks++; });
+        }
+        double seconds = seconds_since(start);
+
+        start = Clock::now();
+        for (size_t i = 0; i < query_count; ++i)
+        {
+            glm::ivec3 min = glm::floor(rays[i % rays.size()].origin);
+            naive_blocks += naive_count_in_aabb(world, min, min + box_size - 1);
+        }
+        double naive_seconds = seconds_since(start);
+
+        fmt::print("  aabb {}x{}x{}: {:10.0f} queries/s, naive {:10.0f} queries/s ({:.1f}x), {} solid blocks, {} mismatches\n",
+            box_size.x, box_size.y, box_size.z, query_count / seconds, query_count / naive_seconds, naive_seconds / seconds,
+            blocks, blocks > naive_blocks ? blocks - naive_blocks : naive_blocks - blocks);
+    }
+}
@@ -0,0 +1,134 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk.hpp"
+#include "../game/world/region_store.hpp"
+#include "../game/world/world_gen.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// drops the region files from the page cache so the next load reads them from disk
+void evict_page_cache(const std::filesystem::path& dir)
+{
+    for (auto& file : std::filesystem::directory_iterator(dir))
+    {
+        int fd = open(file.path().c_str(), O_RDONLY);
+        if (fd < 0) continue;
+
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+struct LoadResult
+{
+    double seconds;
+    size_t bytes_read;
+    size_t mismatches;
+};
+
+LoadResult load_all(const std::filesystem::path& dir, bool use_io_uring, const std::vector<glm::ivec2>& poses,
+    const std::unordered_map<glm::ivec2, std::vector<uint8_t>>& expected)
+{
+    RegionStore store(dir);
+    store.init(use_io_uring);
+
+    auto start = Clock::now();
+    store.load(poses);
+
+    std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> chunks;
+    while (chunks.size() + store.stats().missing_chunks < poses.size())
+        store.out_chunks.fetch_some_blocking(chunks, poses.size());
+
+    LoadResult result{seconds_since(start), store.stats().bytes_read, store.stats().missing_chunks};
+
+    std::vector<uint8_t> data;
+    for (auto& [pos, chunk] : chunks)
+    {
+        data.clear();
+        chunk->serialize(data);
+        result.mismatches += data != expected.at(pos);
+    }
+
+    return result;
+}
+
+} // namespace
+
+void bench::region_bench(int argc, char** argv)
+{
+    int radius = argc > 0 ? std::atoi(argv[0]) : 16;
+    auto dir   = std::filesystem::temp_directory_path() / "mc_region_bench";
+
+    std::filesystem::remove_all(dir);
+
+    auto poses = chunks_in_radius({0, 0}, radius);
+
+    WorldGen gen(0xfada23);
+    gen.init(6);
+
+    auto start       = Clock::now();
+    auto chunks      = generate_chunks(gen, poses);
+    double gen_time = seconds_since(start);
+
+    std::unordered_map<glm::ivec2, std::vector<uint8_t>> expected;
+    for (auto& [pos, chunk] : chunks)
+        chunk->serialize(expected[pos]);
+
+    size_t chunk_bytes = 0;
+    for (auto& [pos, data] : expected)
+        chunk_bytes += data.size();
+
+    start = Clock::now();
+    {
+        RegionStore store(dir);
+        store.init();
+
+        for (auto& [pos, chunk] : chunks)
+            store.save(pos, std::move(chunk));
+
+        // the destructor waits for the writes
+    }
+    double save_time = seconds_since(start);
+
+    size_t file_bytes = 0;
+    for (auto& file : std::filesystem::directory_iterator(dir))
+        file_bytes += file.file_size();
+
+    fmt::print("region benchmark, {} chunks (radius {})\n", poses.size(), radius);
+    fmt::print("  generate (6 threads): {:8.1f} chunks/s\n", poses.size() / gen_time);
+    fmt::print("  save     (1 thread):  {:8.1f} chunks/s, {:.2f} MB of chunk data, {:.2f} MB of region files\n",
+        poses.size() / save_time, chunk_bytes / (1024.0 * 1024.0), file_bytes / (1024.0 * 1024.0));
+
+    for (bool use_io_uring : {false, true})
+    {
+        for (bool cold : {true, false})
+        {
+            if (cold) evict_page_cache(dir);
+
+            auto result = load_all(dir, use_io_uring, poses, expected);
+
+            fmt::print("  load {:8} {:4} (1 thread):  {:8.1f} chunks/s, {:8.1f} MB/s, {} mismatches\n",
+                use_io_uring ? "io_uring" : "mmap", cold ? "cold" : "warm", poses.size() / result.seconds,
+                result.bytes_read / (1024.0 * 1024.0) / result.seconds, result.mismatches);
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,221 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+#include <fmt/core.h>
+
+#include "../game/world/chunk_snapshot.hpp"
+#include "../game/world/world.hpp"
+#include "../game/world/world_gen.hpp"
+#include "../render/chunk/chunk_mesher.hpp"
+#include "../util/concurent_queue.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// hash of the quads of the mesh
+uint64_t mesh_hash(const ChunkSnapshot& snapshot, std::vector<Quad>& quads)
+{
+    Quad* it = quads.data();
+    mesh_vertical_chunk(snapshot, it, quads.data() + quads.size());
+
+    uint64_t hash = 0xcbf29ce484222325;
+    for (Quad* quad = quads.data(); quad < it; ++quad)
+        for (auto& vert : quad->verts)
+            hash = (hash ^ vert.data) * 0x100000001b3;
+
+    return hash;
+}
+
+struct MeshJob
+{
+    ChunkSnapshot snapshot;
+    bool checked           = false;
+    uint64_t expected_hash = 0; // of the mesh right after the snapshot was taken
+    bool stop              = false;
+};
+
+struct FrameResults
+{
+    double main_ms;
+    size_t snapshots;
+    size_t copies;
+    size_t checked;
+    size_t mismatches;
+};
+
+// digs a trail of small overlapping craters, one per frame, and meshes the vertical chunks each one touched. without
+// readers they are meshed on the main thread like the renderer does, otherwise their snapshots are handed to the
+// readers and the main thread goes on with the next crater, usually in the same vertical chunks
+FrameResults run_frames(World& world, int frame_count, int reader_count, int extent, uint32_t seed)
+{
+    ConcurentQueue<MeshJob> jobs;
+    std::atomic<size_t> mismatches = 0;
+    std::atomic<int> running       = reader_count;
+
+    std::vector<std::jthread> readers;
+    for (int i = 0; i < reader_count; ++i)
+    {
+        readers.emplace_back([&] {
+            std::vector<Quad> quads(3 * Chunk::chunk_volume);
+            std::vector<MeshJob> batch;
+
+            for (;;)
+            {
+                batch.clear();
+                jobs.fetch_some_blocking(batch, 16);
+
+                size_t stops = 0;
+                for (auto& job : batch)
+                {
+                    if (job.stop)
+                    {
+                        stops++;
+                        continue;
+                    }
+
+                    uint64_t hash = mesh_hash(job.snapshot, quads);
+                    if (job.checked && hash != job.expected_hash) mismatches++;
+                }
+
+                if (stops == 0) continue;
+
+                // the other stops of the batch belong to other readers
+                for (size_t i = 1; i < stops; ++i)
+                    jobs.push(MeshJob{.stop = true});
+
+                running--;
+                return;
+            }
+        });
+    }
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> start_pos(-extent, extent), step(-4, 4);
+
+    std::vector<Quad> quads(3 * Chunk::chunk_volume);
+    std::vector<BlockEdit> edits;
+    std::vector<MeshJob> frame_jobs;
+
+    FrameResults results = {};
+    size_t copies_before = Chunk::copy_on_write_count();
+    glm::ivec2 crater    = {start_pos(rng), start_pos(rng)};
+
+    for (int frame = 0; frame < frame_count; ++frame)
+    {
+        crater.x = std::clamp(crater.x + step(rng), -extent, extent);
+        crater.y = std::clamp(crater.y + step(rng), -extent, extent);
+
+        glm::vec3 origin(crater.x + 0.5f, Chunk::column_y_to_real_y(Chunk::height), crater.y + 0.5f);
+        auto hit = world.raycast(origin, glm::vec3(0.f, -1.f, 0.f), Chunk::height);
+        if (!hit) continue;
+
+        edits.clear();
+        for (int x = -3; x <= 3; ++x)
+            for (int y = -3; y <= 3; ++y)
+                for (int z = -3; z <= 3; ++z)
+                    if (x * x + y * y + z * z <= 9) edits.push_back(BlockEdit{hit->pos + glm::ivec3(x, y, z), Tile::air});
+
+        auto start = Clock::now();
+
+        world.set_blocks(edits);
+
+        frame_jobs.clear();
+        for (auto [chunk, mask] : world.get_updated_chunks())
+        {
+            for (; mask; mask &= mask - 1)
+            {
+                ChunkSnapshot snapshot(chunk, std::countr_zero(mask));
+
+                if (reader_count == 0)
+                    mesh_hash(snapshot, quads);
+                else
+                    frame_jobs.push_back(MeshJob{std::move(snapshot)});
+
+                results.snapshots++;
+            }
+        }
+
+        results.main_ms += ms_since(start);
+
+        // outside of the timing, the readers see these snapshots only after the next craters changed the world
+        if (frame % 4 == 0)
+        {
+            for (auto& job : frame_jobs)
+            {
+                job.checked       = true;
+                job.expected_hash = mesh_hash(job.snapshot, quads);
+                results.checked++;
+            }
+        }
+
+        jobs.push(std::move(frame_jobs));
+    }
+
+    for (int i = 0; i < reader_count; ++i)
+        jobs.push(MeshJob{.stop = true});
+
+    // a reader may start waiting right after the notification of a push, wake it up until all are done
+    while (running > 0)
+    {
+        jobs.notify_all();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    readers.clear();
+
+    results.main_ms /= frame_count;
+    results.copies     = Chunk::copy_on_write_count() - copies_before;
+    results.mismatches = mismatches;
+
+    return results;
+}
+
+} // namespace
+
+void bench::snapshot_bench(int argc, char** argv)
+{
+    int radius       = argc > 0 ? std::atoi(argv[0]) : 8;
+    int reader_count = argc > 1 ? std::atoi(argv[1]) : 4;
+    int frame_count  = argc > 2 ? std::atoi(argv[2]) : 400;
+
+    WorldGen gen(0xfada23);
+    gen.init(6);
+
+    World world;
+
+    for (auto& [pos, chunk] : generate_chunks(gen, chunks_in_radius({0, 0}, radius)))
+    {
+        // nothing to write back when the world is destroyed
+        chunk->m_unsaved = false;
+        world.set_chunk(std::move(chunk), pos);
+    }
+
+    world.get_updated_chunks();
+
+    int extent = std::max(radius - 2, 1) * Chunk::chunk_size;
+
+    fmt::print("snapshot benchmark, {} chunks (radius {}), {} frames digging a crater each\n", world.chunks().size(),
+        radius, frame_count);
+
+    for (int readers : {0, reader_count})
+    {
+        auto results = run_frames(world, frame_count, readers, extent, 42 + readers);
+
+        fmt::print("  {} readers: {:6.3f} ms per frame on the main thread, {} snapshots, {} copies on write, {} of {} "
+                   "checked meshes differ\n",
+            readers, results.main_ms, results.snapshots, results.copies, results.mismatches, results.checked);
+    }
+}
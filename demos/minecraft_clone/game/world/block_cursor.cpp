@@ -0,0 +1,124 @@
+#include "block_cursor.hpp"
+
+#include <algorithm>
+
+#include "world.hpp"
+
+namespace
+{
+// follows the neighbor links, nullptr once one is missing
+const Chunk* walk(const Chunk* chunk, int32_t dx, int32_t dz)
+{
+    for (; chunk && dx > 0; --dx) chunk = chunk->m_neighbor.xp;
+    for (; chunk && dx < 0; ++dx) chunk = chunk->m_neighbor.xn;
+    for (; chunk && dz > 0; --dz) chunk = chunk->m_neighbor.zp;
+    for (; chunk && dz < 0; ++dz) chunk = chunk->m_neighbor.zn;
+
+    return chunk;
+}
+
+} // namespace
+
+BlockCursor::BlockCursor(const Chunk* chunk, glm::ivec3 pos) : m_base(chunk)
+{
+    glm::ivec3 chunk_pos = Chunk::real_pos_to_chunk_pos(pos);
+
+    m_offset         = {chunk_pos.x, chunk_pos.z};
+    m_vertical_chunk = chunk_pos.y;
+    m_in_pos         = Chunk::real_pos_to_in_chunk_pos(pos);
+
+    load_columns();
+}
+
+BlockCursor::BlockCursor(const World& world, glm::ivec3 pos) : m_world(&world)
+{
+    pos.y = Chunk::real_y_to_column_y(pos.y);
+
+    glm::ivec3 chunk_pos = Chunk::real_pos_to_chunk_pos(pos);
+
+    m_base_pos       = {chunk_pos.x, chunk_pos.z};
+    m_base           = world.get_chunk(m_base_pos);
+    m_vertical_chunk = chunk_pos.y;
+    m_in_pos         = Chunk::real_pos_to_in_chunk_pos(pos);
+
+    load_columns();
+}
+
+void BlockCursor::move(int32_t dx, int32_t dy, int32_t dz)
+{
+    glm::ivec3 pos  = m_in_pos + glm::ivec3(dx, dy, dz);
+    glm::ivec3 step = Chunk::real_pos_to_chunk_pos(pos);
+
+    m_in_pos = Chunk::real_pos_to_in_chunk_pos(pos);
+
+    if (step == glm::ivec3(0)) return;
+
+    m_vertical_chunk += step.y;
+
+    if (step.x != 0 || step.z != 0)
+    {
+        m_offset += glm::ivec2(step.x, step.z);
+        load_columns();
+    }
+    else if (std::abs(step.y) == 1)
+    {
+        // two of the layers are still cached
+        if (step.y > 0)
+            std::copy(m_views + 9, m_views + 27, m_views);
+        else
+            std::copy_backward(m_views, m_views + 18, m_views + 27);
+
+        refresh_layer(step.y > 0 ? 2 : 0);
+    }
+    else
+    {
+        refresh();
+    }
+}
+
+void BlockCursor::refresh()
+{
+    for (int32_t y = 0; y < 3; ++y)
+        refresh_layer(y);
+}
+
+void BlockCursor::refresh_layer(int32_t y)
+{
+    // vertical chunks out of range read as air
+    uint32_t vertical_chunk = m_vertical_chunk + y - 1;
+
+    for (int32_t i = 0; i < 9; ++i)
+    {
+        const Chunk* column = m_columns[i];
+        m_views[i + y * 9]  = column ? column->view_tiles(vertical_chunk) : Chunk::view_uniform(Tile::air);
+    }
+}
+
+const Chunk* BlockCursor::find_chunk(glm::ivec2 offset) const
+{
+    if (m_base)
+    {
+        // diagonal neighbors can be linked through either side
+        if (const Chunk* chunk = walk(walk(m_base, offset.x, 0), 0, offset.y)) return chunk;
+        if (const Chunk* chunk = walk(walk(m_base, 0, offset.y), offset.x, 0)) return chunk;
+    }
+
+    return m_world ? m_world->get_chunk(m_base_pos + offset) : nullptr;
+}
+
+void BlockCursor::load_columns()
+{
+    // walks from the chunk the cursor is in stay short
+    if (const Chunk* center = find_chunk(m_offset))
+    {
+        m_base = center;
+        m_base_pos += m_offset;
+        m_offset = {};
+    }
+
+    for (int32_t z = 0; z < 3; ++z)
+        for (int32_t x = 0; x < 3; ++x)
+            m_columns[x + z * 3] = find_chunk(m_offset + glm::ivec2(x - 1, z - 1));
+
+    refresh();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cassert>
+#include <cstdlib>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "chunk.hpp"
+
+class World;
+
+// position in the tiles of a world that keeps views of the vertical chunk it is in and the 26 around it, so tiles up to
+// a chunk away are read without finding their chunk. neighboring columns are found through the neighbor links of the
+// chunks, or in the world if the cursor has one and the links don't reach them. tiles of chunks that aren't found read
+// as air. the views go stale when the vertical chunks are written, refresh rereads them
+class BlockCursor
+{
+public:
+    // pos is in tiles of chunk, with y counted from the bottom of the column like Chunk does
+    BlockCursor(const Chunk* chunk, glm::ivec3 pos);
+    // pos is in world tiles
+    BlockCursor(const World& world, glm::ivec3 pos);
+
+    inline Tile get() const { return get(0, 0, 0); }
+    // the tile at the offset from the cursor, which can reach up to a chunk away in every direction
+    inline Tile get(int32_t dx, int32_t dy, int32_t dz) const
+    {
+        assert(std::abs(dx) <= Chunk::chunk_size && std::abs(dy) <= Chunk::chunk_size && std::abs(dz) <= Chunk::chunk_size);
+
+        int32_t x = m_in_pos.x + dx;
+        int32_t y = m_in_pos.y + dy;
+        int32_t z = m_in_pos.z + dz;
+
+        constexpr int32_t size_log2 = Chunk::chunk_size_log2;
+        constexpr int32_t mask      = Chunk::chunk_size - 1;
+
+        uint32_t slot = ((x >> size_log2) + 1) + ((z >> size_log2) + 1) * 3 + ((y >> size_log2) + 1) * 9;
+
+        return m_views[slot].get((x & mask) + (z & mask) * Chunk::chunk_size + (y & mask) * Chunk::chunk_surface_area);
+    }
+
+    // moves by any distance, steps that stay in the vertical chunk only change the position
+    void move(int32_t dx, int32_t dy, int32_t dz);
+    inline void move(glm::ivec3 d) { move(d.x, d.y, d.z); }
+
+    // has to be called after the vertical chunks around the cursor were written
+    void refresh();
+
+    // the chunk the cursor is in, nullptr if it isn't found
+    inline const Chunk* chunk() const { return m_columns[4]; }
+    // position in tiles of chunk(), with y counted from the bottom of the column
+    inline glm::ivec3 pos() const
+    {
+        return {m_in_pos.x, m_vertical_chunk * Chunk::chunk_size + m_in_pos.y, m_in_pos.z};
+    }
+
+private:
+    // the chunk at the offset in chunks from the base
+    const Chunk* find_chunk(glm::ivec2 offset) const;
+    void load_columns();
+    // the 9 views of the layer of vertical chunks at y - 1 from the cursor
+    void refresh_layer(int32_t y);
+
+private:
+    const World* m_world = nullptr;
+
+    // the last chunk the cursor was in that was found, and its position if the cursor has a world
+    const Chunk* m_base = nullptr;
+    glm::ivec2 m_base_pos = {};
+    // of the chunk the cursor is in, in chunks from the base
+    glm::ivec2 m_offset = {};
+
+    int32_t m_vertical_chunk = 0;
+    // in the vertical chunk
+    glm::ivec3 m_in_pos = {};
+
+    // the 3x3 columns around the cursor indexed by x + z * 3, and the vertical chunks around it by x + z * 3 + y * 9
+    const Chunk* m_columns[9] = {};
+    TileView m_views[27];
+};
@@ -1,7 +1,65 @@
 #include "chunk.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
+
+namespace
+{
+// shared read only arrays handed out for uniform vertical chunks
+const Tile* uniform_tile_array(Tile t)
+{
+    static const auto arrays = [] {
+        auto arrays = std::make_unique<Tile[]>(tile_type_count * Chunk::chunk_volume);
+
+        for (uint32_t i = 0; i < tile_type_count; ++i)
+            memset(arrays.get() + i * Chunk::chunk_volume, i, Chunk::chunk_volume);
+
+        return arrays;
+    }();
+
+    assert((uint32_t)t < tile_type_count);
+
+    return arrays.get() + (uint32_t)t * Chunk::chunk_volume;
+}
+
+const Chunk::Occupancy empty_occupancy = {};
+const Chunk::Occupancy full_occupancy  = [] {
+    Chunk::Occupancy occupancy;
+    occupancy.fill(Chunk::full_column);
+    return occupancy;
+}();
+
+void build_occupancy(const Tile* tiles, Chunk::Occupancy& out)
+{
+    out.fill(0);
+
+    for (uint32_t y = 0; y < Chunk::chunk_size; ++y)
+    {
+        const Tile* layer = tiles + y * Chunk::chunk_surface_area;
+
+        for (uint32_t i = 0; i < Chunk::chunk_surface_area; ++i)
+            out[i] |= (Chunk::ColumnMask)is_solid(layer[i]) << y;
+    }
+}
+
+std::atomic<size_t> copies_on_write = 0;
+
+// only the thread changing a chunk hands its storage to snapshots, so a storage it holds alone can't become shared
+// while it is written. the fence orders the reads of the snapshots that released it before those writes
+template <typename T>
+bool is_shared(const std::shared_ptr<T>& ptr)
+{
+    if (ptr.use_count() > 1) return true;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return false;
+}
+
+} // namespace
 
 Tile Chunk::get_block(uint32_t x, uint32_t y, uint32_t z)const
 {
@@ -11,7 +69,13 @@ Tile Chunk::get_block(uint32_t x, uint32_t y, uint32_t z)const
 
     assert(tile_index < chunk_volume && vertical_chunk < vertical_chunk_count);
 
-    return m_vertical_chunks[vertical_chunk] ? m_vertical_chunks[vertical_chunk].get()[tile_index] : Tile::air;
+    auto* storage = get_storage(vertical_chunk);
+
+    if (storage == nullptr) return Tile::air;
+    if (storage->tiles) return storage->tiles.get()[tile_index];
+    if (storage->paletted) return storage->paletted->get(tile_index);
+
+    return storage->uniform;
 }
 
 void Chunk::set_block(Tile t, uint32_t x, uint32_t y, uint32_t z)
@@ -20,50 +84,761 @@ void Chunk::set_block(Tile t, uint32_t x, uint32_t y, uint32_t z)
 
     uint32_t vertical_chunk = y / chunk_size;
 
-    assert(tile_index < chunk_volume && vertical_chunk < vertical_chunk_count);
+    assert(tile_index < chunk_volume && is_vertical_chunk_loaded(vertical_chunk));
+
+    // also keeps snapshots from forcing a copy for writes that change nothing
+    if (get_block(x, y, z) == t) return;
+
+    auto& storage = get_writable_storage(vertical_chunk);
 
-    if (m_vertical_chunks[vertical_chunk] == nullptr) m_vertical_chunks[vertical_chunk] = std::unique_ptr<Tile, Free>((Tile*)calloc(chunk_volume / 8, 8));
+    if (storage.tiles)
+    {
+        storage.tiles.get()[tile_index] = t;
+    }
+    else
+    {
+        if (storage.paletted == nullptr)
+        {
+            // first write that breaks uniformity gives the vertical chunk its own storage
+            storage.paletted  = std::make_unique<PalettedTiles>(chunk_volume, storage.uniform);
+            storage.occupancy = std::make_unique<Occupancy>(is_solid(storage.uniform) ? full_occupancy : empty_occupancy);
+            storage.uniform   = Tile::air;
+        }
+
+        storage.paletted->set(tile_index, t);
+    }
 
-    m_vertical_chunks[vertical_chunk].get()[tile_index] = t;
+    if (storage.occupancy_stale) return;
+
+    ColumnMask& column = (*storage.occupancy)[x + z * chunk_size];
+    ColumnMask bit     = ColumnMask(1) << (y % chunk_size);
+
+    column = is_solid(t) ? column | bit : column & ~bit;
+
+    if (m_heightmap_stale) return;
+
+    uint16_t& height = m_heightmap[x + z * chunk_size];
+
+    if (is_solid(t))
+        height = std::max<uint16_t>(height, y + 1);
+    else if (y + 1 == height)
+        height = scan_height(x + z * chunk_size, vertical_chunk);
 }
 
 Tile* Chunk::get_tile_array(uint32_t index)
 {
-    return index >= 0 && index < vertical_chunk_count ? m_vertical_chunks[index].get() : nullptr;
+    if (is_vertical_chunk_empty(index)) return nullptr;
+
+    auto& storage = get_writable_storage(index);
+
+    // the caller may write any tile
+    storage.occupancy_stale = true;
+    m_heightmap_stale       = true;
+
+    if (storage.paletted)
+    {
+        storage.tiles = allocate_tile_array();
+        storage.paletted->unpack(storage.tiles.get());
+        storage.paletted = nullptr;
+    }
+    else if (storage.tiles == nullptr)
+    {
+        storage.tiles = allocate_tile_array();
+        memset(storage.tiles.get(), (int)storage.uniform, chunk_volume);
+        storage.uniform = Tile::air;
+    }
+
+    return storage.tiles.get();
 }
 
 const Tile* Chunk::get_tile_array(uint32_t index) const
 {
-    return index >= 0 && index < vertical_chunk_count ? m_vertical_chunks[index].get() : nullptr;
+    auto* storage = get_storage(index);
+
+    if (storage == nullptr) return nullptr;
+    if (storage->tiles == nullptr && storage->paletted == nullptr && storage->uniform != Tile::air) return uniform_tile_array(storage->uniform);
+
+    return storage->tiles.get();
+}
+
+const Tile* Chunk::read_tile_array(uint32_t index, Tile* scratch) const
+{
+    return read_tile_array(get_storage(index), scratch);
+}
+
+const Tile* Chunk::read_tile_array(const TileStorage* storage, Tile* scratch)
+{
+    if (storage == nullptr) return nullptr;
+
+    if (storage->tiles) return storage->tiles.get();
+
+    if (storage->paletted)
+    {
+        storage->paletted->unpack(scratch);
+        return scratch;
+    }
+
+    return storage->uniform != Tile::air ? uniform_tile_array(storage->uniform) : nullptr;
+}
+
+TileView Chunk::view_tiles(uint32_t index) const
+{
+    auto* storage = get_storage(index);
+
+    if (storage == nullptr) return view_uniform(Tile::air);
+    if (storage->tiles) return TileView{.flat = storage->tiles.get()};
+    if (storage->paletted) return TileView{.paletted = storage->paletted.get()};
+
+    return view_uniform(storage->uniform);
+}
+
+TileView Chunk::view_uniform(Tile t)
+{
+    return TileView{.flat = uniform_tile_array(t)};
+}
+
+bool Chunk::is_vertical_chunk_empty(uint32_t index) const
+{
+    return get_uniform_tile(index) == Tile::air;
 }
 
-const Tile* Chunk::get_tile_array_of_neighbor(uint32_t vertical_chunk, TileFacing dir)const
+std::optional<Tile> Chunk::get_uniform_tile(uint32_t index) const
+{
+    return get_uniform_tile(get_storage(index));
+}
+
+std::optional<Tile> Chunk::get_uniform_tile(const TileStorage* storage)
+{
+    if (storage == nullptr) return Tile::air;
+    if (storage->tiles || storage->paletted) return std::nullopt;
+
+    return storage->uniform;
+}
+
+void Chunk::set_vertical_chunk(TileArray v_chunk, uint32_t vertical_chunk)
+{
+    assert(is_vertical_chunk_loaded(vertical_chunk));
+
+    // a new storage, the old one may be held by a snapshot
+    auto& storage = allocate_vertical_chunk(vertical_chunk).storage;
+
+    storage                  = std::make_shared<TileStorage>();
+    storage->tiles           = std::move(v_chunk);
+    storage->occupancy_stale = true;
+    m_heightmap_stale        = true;
+}
+
+void Chunk::set_vertical_chunk_uniform(Tile t, uint32_t vertical_chunk)
+{
+    assert(is_vertical_chunk_loaded(vertical_chunk));
+
+    m_heightmap_stale = true;
+
+    if (m_vertical_chunks[vertical_chunk] == nullptr && t == Tile::air) return;
+
+    auto& storage = allocate_vertical_chunk(vertical_chunk).storage;
+
+    storage          = std::make_shared<TileStorage>();
+    storage->uniform = t;
+
+    release_if_default(vertical_chunk);
+}
+
+const Chunk::TileStorage* Chunk::get_storage(uint32_t vertical_chunk) const
+{
+    if (vertical_chunk >= vertical_chunk_count || m_vertical_chunks[vertical_chunk] == nullptr) return nullptr;
+
+    return m_vertical_chunks[vertical_chunk]->storage.get();
+}
+
+Chunk::TileStorage& Chunk::get_writable_storage(uint32_t vertical_chunk)
+{
+    auto& storage = allocate_vertical_chunk(vertical_chunk).storage;
+
+    if (storage == nullptr)
+    {
+        storage = std::make_shared<TileStorage>();
+    }
+    else if (is_shared(storage))
+    {
+        auto copy = std::make_shared<TileStorage>();
+
+        if (storage->tiles)
+        {
+            copy->tiles = allocate_tile_array();
+            memcpy(copy->tiles.get(), storage->tiles.get(), chunk_volume * sizeof(Tile));
+        }
+
+        if (storage->paletted) copy->paletted = std::make_unique<PalettedTiles>(*storage->paletted);
+        if (storage->occupancy) copy->occupancy = std::make_unique<Occupancy>(*storage->occupancy);
+
+        copy->uniform         = storage->uniform;
+        copy->occupancy_stale = storage->occupancy_stale;
+
+        // the snapshots keep the old one
+        storage = std::move(copy);
+        copies_on_write++;
+    }
+
+    return *storage;
+}
+
+size_t Chunk::copy_on_write_count()
+{
+    return copies_on_write;
+}
+
+Chunk::VerticalChunk& Chunk::allocate_vertical_chunk(uint32_t vertical_chunk)
+{
+    auto& vchunk = m_vertical_chunks[vertical_chunk];
+    if (vchunk == nullptr) vchunk = std::make_unique<VerticalChunk>();
+
+    return *vchunk;
+}
+
+void Chunk::release_if_default(uint32_t vertical_chunk)
+{
+    auto& vchunk = m_vertical_chunks[vertical_chunk];
+
+    if (vchunk == nullptr) return;
+    if (get_uniform_tile(vchunk->storage.get()) == Tile::air) vchunk = nullptr;
+}
+
+Chunk::VerticalLight& Chunk::allocate_vertical_light(uint32_t vertical_chunk)
+{
+    auto& light = m_light[vertical_chunk];
+    if (light == nullptr) light = std::make_unique<VerticalLight>();
+
+    return *light;
+}
+
+void Chunk::release_light_if_default(uint32_t vertical_chunk)
+{
+    auto& light = m_light[vertical_chunk];
+
+    if (light == nullptr || light->light[0] || light->light[1]) return;
+    if (light->uniform_light[0] != max_light || light->uniform_light[1] != 0) return;
+
+    light = nullptr;
+}
+
+void Chunk::set_loaded_range(uint32_t beg, uint32_t end)
+{
+    assert(beg <= end && end <= vertical_chunk_count);
+
+    for (uint32_t v = 0; v < vertical_chunk_count; ++v)
+    {
+        if (v < beg || v >= end)
+        {
+            m_vertical_chunks[v] = nullptr;
+            m_light[v]           = nullptr;
+        }
+    }
+
+    m_loaded_beg      = beg;
+    m_loaded_end      = end;
+    m_heightmap_stale = true;
+}
+
+void Chunk::merge_below(std::unique_ptr<Chunk> below)
+{
+    assert(below->m_loaded_end == m_loaded_beg);
+
+    for (uint32_t v = below->m_loaded_beg; v < below->m_loaded_end; ++v)
+    {
+        m_vertical_chunks[v] = std::move(below->m_vertical_chunks[v]);
+
+        auto& light = allocate_vertical_light(v);
+
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            light.light[channel]         = nullptr;
+            light.uniform_light[channel] = 0;
+        }
+    }
+
+    m_loaded_beg      = below->m_loaded_beg;
+    m_heightmap_stale = true;
+
+    update_occupancy();
+}
+
+const Chunk* Chunk::get_neighbor(uint32_t& vertical_chunk, TileFacing dir) const
 {
     switch (dir)
     {
     case TileFacing::yp:
-        return get_tile_array(vertical_chunk + 1);
-        break;
+        vertical_chunk++;
+        return this;
     case TileFacing::yn:
-        return get_tile_array(vertical_chunk - 1);
-        break;
+        vertical_chunk--;
+        return this;
     case TileFacing::xp:
-        return m_neighbor.xp ? m_neighbor.xp->get_tile_array(vertical_chunk) : nullptr;
-        break;
+        return m_neighbor.xp;
     case TileFacing::xn:
-        return m_neighbor.xn ? m_neighbor.xn->get_tile_array(vertical_chunk) : nullptr;
-        break;
+        return m_neighbor.xn;
     case TileFacing::zp:
-        return m_neighbor.zp ? m_neighbor.zp->get_tile_array(vertical_chunk) : nullptr;
-        break;
+        return m_neighbor.zp;
     case TileFacing::zn:
-        return m_neighbor.zn ? m_neighbor.zn->get_tile_array(vertical_chunk) : nullptr;
-        break;
+        return m_neighbor.zn;
     }
 
     return nullptr;
 }
 
+const Tile* Chunk::read_tile_array_of_neighbor(uint32_t vertical_chunk, TileFacing dir, Tile* scratch) const
+{
+    auto* neighbor = get_neighbor(vertical_chunk, dir);
+
+    return neighbor ? neighbor->read_tile_array(vertical_chunk, scratch) : nullptr;
+}
+
+std::optional<Tile> Chunk::get_uniform_tile_of_neighbor(uint32_t vertical_chunk, TileFacing dir) const
+{
+    auto* neighbor = get_neighbor(vertical_chunk, dir);
+
+    return neighbor ? neighbor->get_uniform_tile(vertical_chunk) : Tile::air;
+}
+
+const Chunk::Occupancy& Chunk::get_occupancy(uint32_t index) const
+{
+    if (index >= vertical_chunk_count) return empty_occupancy;
+    if (!is_vertical_chunk_loaded(index)) return full_occupancy;
+
+    auto* storage = get_storage(index);
+    if (storage == nullptr) return empty_occupancy;
+
+    assert(!storage->occupancy_stale);
+
+    if (storage->occupancy) return *storage->occupancy;
+
+    return is_solid(storage->uniform) ? full_occupancy : empty_occupancy;
+}
+
+const Chunk::Occupancy& Chunk::get_occupancy_of_neighbor(uint32_t vertical_chunk, TileFacing dir) const
+{
+    auto* neighbor = get_neighbor(vertical_chunk, dir);
+
+    return neighbor ? neighbor->get_occupancy(vertical_chunk) : empty_occupancy;
+}
+
+void Chunk::update_occupancy()
+{
+    for (auto& vchunk : m_vertical_chunks)
+    {
+        if (vchunk == nullptr || vchunk->storage == nullptr || !vchunk->storage->occupancy_stale) continue;
+
+        // snapshots can't be taken of stale storage, nothing else holds it
+        auto& storage = *vchunk->storage;
+
+        storage.occupancy_stale = false;
+        m_heightmap_stale       = true;
+
+        if (storage.tiles == nullptr && storage.paletted == nullptr)
+        {
+            storage.occupancy = nullptr;
+            continue;
+        }
+
+        if (storage.occupancy == nullptr) storage.occupancy = std::make_unique<Occupancy>();
+
+        if (storage.tiles)
+        {
+            build_occupancy(storage.tiles.get(), *storage.occupancy);
+        }
+        else
+        {
+            thread_local Tile scratch[chunk_volume];
+
+            storage.paletted->unpack(scratch);
+            build_occupancy(scratch, *storage.occupancy);
+        }
+    }
+
+    if (!m_heightmap_stale) return;
+
+    m_heightmap_stale = false;
+
+    // vertical chunks above the highest allocated one are empty
+    int32_t top = m_loaded_end - 1;
+    while (top >= (int32_t)m_loaded_beg && m_vertical_chunks[top] == nullptr)
+        top--;
+
+    for (uint32_t i = 0; i < chunk_surface_area; ++i)
+        m_heightmap[i] = scan_height(i, top);
+}
+
+uint16_t Chunk::scan_height(uint32_t column, int32_t top_vertical_chunk) const
+{
+    for (int32_t v = top_vertical_chunk; v >= (int32_t)m_loaded_beg; --v)
+    {
+        if (m_vertical_chunks[v] == nullptr) continue;
+
+        if (ColumnMask bits = get_occupancy(v)[column])
+            return v * chunk_size + chunk_size - std::countl_zero(bits);
+    }
+
+    return 0;
+}
+
+void Chunk::compress()
+{
+    update_occupancy();
+
+    for (uint32_t v = 0; v < vertical_chunk_count; ++v)
+        compress_vertical_chunk(v);
+}
+
+void Chunk::compress_vertical_chunk(uint32_t vertical_chunk)
+{
+    if (m_vertical_chunks[vertical_chunk] == nullptr) return;
+
+    auto& storage_ptr = m_vertical_chunks[vertical_chunk]->storage;
+    if (storage_ptr == nullptr || is_shared(storage_ptr)) return;
+
+    auto& storage = *storage_ptr;
+
+    assert(!storage.occupancy_stale);
+
+    if (storage.paletted)
+    {
+        storage.paletted->shrink_to_fit();
+    }
+    else if (storage.tiles)
+    {
+        storage.paletted = PalettedTiles::from_tiles(storage.tiles.get(), chunk_volume);
+        storage.tiles    = nullptr;
+    }
+
+    if (storage.paletted && storage.paletted->palette_size() == 1)
+    {
+        storage.uniform   = storage.paletted->get(0);
+        storage.paletted  = nullptr;
+        storage.occupancy = nullptr;
+    }
+
+    release_if_default(vertical_chunk);
+}
+
+uint8_t Chunk::get_light(LightChannel channel, uint32_t x, uint32_t y, uint32_t z) const
+{
+    uint32_t tile_index = x + z * chunk_size + (y % chunk_size) * chunk_surface_area;
+
+    uint32_t vertical_chunk = y / chunk_size;
+
+    if (!is_vertical_chunk_loaded(vertical_chunk)) return 0;
+    if (m_light[vertical_chunk] == nullptr) return channel == LightChannel::sky ? max_light : 0;
+
+    auto& vlight = *m_light[vertical_chunk];
+    auto& light  = vlight.light[(int)channel];
+
+    if (light == nullptr) return vlight.uniform_light[(int)channel];
+
+    return (light.get()[tile_index / 2] >> (tile_index % 2 * 4)) & 0xf;
+}
+
+void Chunk::set_light(LightChannel channel, uint8_t level, uint32_t x, uint32_t y, uint32_t z)
+{
+    uint32_t tile_index = x + z * chunk_size + (y % chunk_size) * chunk_surface_area;
+
+    assert(level <= max_light && is_vertical_chunk_loaded(y / chunk_size));
+
+    if (get_uniform_light(channel, y / chunk_size) == level) return;
+
+    uint8_t& pair  = get_light_array(channel, y / chunk_size)[tile_index / 2];
+    uint32_t shift = tile_index % 2 * 4;
+
+    pair = (pair & ~(0xf << shift)) | (level << shift);
+}
+
+void Chunk::set_vertical_chunk_light_uniform(LightChannel channel, uint8_t level, uint32_t vertical_chunk)
+{
+    if (get_uniform_light(channel, vertical_chunk) == level) return;
+
+    auto& vlight = allocate_vertical_light(vertical_chunk);
+
+    vlight.light[(int)channel]         = nullptr;
+    vlight.uniform_light[(int)channel] = level;
+
+    release_light_if_default(vertical_chunk);
+}
+
+std::optional<uint8_t> Chunk::get_uniform_light(LightChannel channel, uint32_t vertical_chunk) const
+{
+    if (!is_vertical_chunk_loaded(vertical_chunk)) return 0;
+    if (m_light[vertical_chunk] == nullptr) return channel == LightChannel::sky ? max_light : 0;
+
+    auto& vlight = *m_light[vertical_chunk];
+
+    if (vlight.light[(int)channel]) return std::nullopt;
+
+    return vlight.uniform_light[(int)channel];
+}
+
+uint8_t* Chunk::get_light_array(LightChannel channel, uint32_t vertical_chunk)
+{
+    assert(is_vertical_chunk_loaded(vertical_chunk));
+
+    auto& vlight = allocate_vertical_light(vertical_chunk);
+    auto& light  = vlight.light[(int)channel];
+
+    if (light == nullptr)
+    {
+        light = allocate_light_array();
+        memset(light.get(), vlight.uniform_light[(int)channel] * 0x11, light_array_bytes);
+    }
+
+    return light.get();
+}
+
+void Chunk::compress_light()
+{
+    for (uint32_t v = 0; v < vertical_chunk_count; ++v)
+    {
+        if (m_light[v] == nullptr) continue;
+
+        auto& vlight = *m_light[v];
+
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            auto& light = vlight.light[channel];
+            if (light == nullptr) continue;
+
+            uint8_t first = light.get()[0];
+            if ((first & 0xf) != first >> 4) continue;
+
+            bool single_level = true;
+            for (int32_t i = 1; i < light_array_bytes && single_level; ++i)
+                single_level = light.get()[i] == first;
+
+            if (!single_level) continue;
+
+            light                         = nullptr;
+            vlight.uniform_light[channel] = first & 0xf;
+        }
+
+        release_light_if_default(v);
+    }
+}
+
+ChunkMemoryUsage Chunk::memory_usage() const
+{
+    ChunkMemoryUsage usage;
+
+    for (auto& vlight : m_light)
+    {
+        if (vlight == nullptr) continue;
+
+        usage.resident_bytes += sizeof(VerticalLight);
+
+        for (auto& light : vlight->light)
+            if (light) usage.resident_bytes += light_array_bytes;
+    }
+
+    for (auto& vchunk_ptr : m_vertical_chunks)
+    {
+        if (vchunk_ptr == nullptr) continue;
+
+        auto& vchunk = *vchunk_ptr;
+
+        usage.resident_bytes += sizeof(VerticalChunk);
+
+        auto* storage = vchunk.storage.get();
+        if (storage == nullptr) continue;
+
+        usage.resident_bytes += sizeof(TileStorage);
+
+        if (storage->tiles)
+        {
+            usage.resident_bytes += chunk_volume * sizeof(Tile);
+        }
+        else if (storage->paletted)
+        {
+            usage.resident_bytes += storage->paletted->memory_usage();
+            usage.paletted_chunks++;
+
+            uint32_t bits = storage->paletted->bits_per_tile();
+            usage.bits_histogram[bits == 1 ? 0 : bits == 2 ? 1 : bits == 4 ? 2 : 3]++;
+        }
+        else if (storage->uniform != Tile::air)
+        {
+            usage.uniform_chunks++;
+        }
+        else
+        {
+            continue;
+        }
+
+        if (storage->occupancy) usage.resident_bytes += sizeof(Occupancy);
+
+        usage.vertical_chunks++;
+        usage.flat_bytes += chunk_volume * sizeof(Tile);
+    }
+
+    return usage;
+}
+
+namespace
+{
+enum class StoredVerticalChunk : uint8_t
+{
+    uniform,
+    paletted,
+};
+
+// version 1 stored the 8 vertical chunks of world y 0 to 256, version 2 added the loaded range and version 3 the chunk
+// size. chunks stored with another chunk size can't be read
+constexpr uint8_t chunk_format_version = 3;
+constexpr int32_t v1_vertical_chunk_count = 8;
+} // namespace
+
+void Chunk::serialize(std::vector<uint8_t>& out) const
+{
+    assert(m_loaded_end == vertical_chunk_count);
+
+    // the vertical chunks above the highest allocated one are air and left out
+    uint32_t end = m_loaded_end;
+    while (end > m_loaded_beg && m_vertical_chunks[end - 1] == nullptr)
+        end--;
+
+    out.push_back(chunk_format_version);
+    out.push_back((uint8_t)chunk_size_log2);
+    out.push_back((uint8_t)m_loaded_beg);
+    out.push_back((uint8_t)end);
+
+    for (uint32_t v = m_loaded_beg; v < end; ++v)
+    {
+        auto* storage = get_storage(v);
+
+        if (storage && storage->tiles)
+        {
+            out.push_back((uint8_t)StoredVerticalChunk::paletted);
+            PalettedTiles::from_tiles(storage->tiles.get(), chunk_volume)->serialize(out);
+        }
+        else if (storage && storage->paletted)
+        {
+            out.push_back((uint8_t)StoredVerticalChunk::paletted);
+            storage->paletted->serialize(out);
+        }
+        else
+        {
+            out.push_back((uint8_t)StoredVerticalChunk::uniform);
+            out.push_back((uint8_t)(storage ? storage->uniform : Tile::air));
+        }
+    }
+}
+
+std::unique_ptr<Chunk> Chunk::deserialize(const uint8_t* data, size_t size)
+{
+    const uint8_t* end = data + size;
+
+    if (size < 1) return nullptr;
+
+    uint32_t stored_beg, stored_end;
+
+    switch (*data++)
+    {
+    case 1:
+        if (chunk_size != 32) return nullptr;
+        stored_beg = -min_vertical_chunk;
+        stored_end = stored_beg + v1_vertical_chunk_count;
+        break;
+    case 2:
+        if (chunk_size != 32 || end - data < 2) return nullptr;
+        stored_beg = *data++;
+        stored_end = *data++;
+        if (stored_beg > stored_end || stored_end > vertical_chunk_count) return nullptr;
+        break;
+    case chunk_format_version:
+        if (end - data < 3 || *data++ != chunk_size_log2) return nullptr;
+        stored_beg = *data++;
+        stored_end = *data++;
+        if (stored_beg > stored_end || stored_end > vertical_chunk_count) return nullptr;
+        break;
+    default:
+        return nullptr;
+    }
+
+    auto chunk = std::make_unique<Chunk>();
+    chunk->m_loaded_beg = stored_beg;
+
+    for (uint32_t v = stored_beg; v < stored_end; ++v)
+    {
+        if (data == end) return nullptr;
+
+        switch ((StoredVerticalChunk)*data++)
+        {
+        case StoredVerticalChunk::uniform:
+            if (data == end || *data >= tile_type_count) return nullptr;
+            if ((Tile)*data != Tile::air) chunk->get_writable_storage(v).uniform = (Tile)*data;
+            data++;
+            break;
+        case StoredVerticalChunk::paletted: {
+            auto& storage    = chunk->get_writable_storage(v);
+            storage.paletted = PalettedTiles::deserialize(data, end, chunk_volume);
+            if (storage.paletted == nullptr) return nullptr;
+            storage.occupancy_stale = true;
+            break;
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    chunk->m_heightmap_stale = true;
+    chunk->update_occupancy();
+    chunk->m_unsaved = false;
+
+    return chunk;
+}
+
+ChunkMemoryUsage& ChunkMemoryUsage::operator+=(const ChunkMemoryUsage& o)
+{
+    vertical_chunks += o.vertical_chunks;
+    paletted_chunks += o.paletted_chunks;
+    uniform_chunks += o.uniform_chunks;
+    resident_bytes += o.resident_bytes;
+    flat_bytes += o.flat_bytes;
+
+    for (int i = 0; i < 4; ++i)
+        bits_histogram[i] += o.bits_histogram[i];
+
+    return *this;
+}
+
+TileArray Chunk::allocate_tile_array()
+{
+    return TileArray(static_cast<Tile*>(tile_array_pool().allocate()));
+}
+
+BlockPool& Chunk::tile_array_pool()
+{
+    // never destroyed since worker threads may still hand arrays back during static destruction
+    static auto* pool = new BlockPool(chunk_volume * sizeof(Tile));
+    return *pool;
+}
+
+void TileArrayFree::operator()(Tile* tiles) const
+{
+    Chunk::tile_array_pool().free(tiles);
+}
+
+LightArray Chunk::allocate_light_array()
+{
+    return LightArray(static_cast<uint8_t*>(light_array_pool().allocate()));
+}
+
+BlockPool& Chunk::light_array_pool()
+{
+    static auto* pool = new BlockPool(light_array_bytes);
+    return *pool;
+}
+
+void LightArrayFree::operator()(uint8_t* light) const
+{
+    Chunk::light_array_pool().free(light);
+}
+
 Chunk::Chunk()
 {
 }
@@ -3,6 +3,9 @@
 #include <array>
 #include <inttypes.h>
 #include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
 #include <glm/vec2.hpp>
 
@@ -11,37 +14,208 @@
 #include <vke/util.hpp>
 
 // #include "../util/malloc_unique.hpp"
+#include "../../util/block_pool.hpp"
+#include "chunk_dims.hpp"
+#include "tile_palette.hpp"
 #include "tiles.hpp"
 
+// returns flat tile arrays to Chunk::tile_array_pool()
+struct TileArrayFree
+{
+    void operator()(Tile* tiles) const;
+};
+
+using TileArray = std::unique_ptr<Tile, TileArrayFree>;
+
+// returns light arrays to Chunk::light_array_pool()
+struct LightArrayFree
+{
+    void operator()(uint8_t* light) const;
+};
+
+using LightArray = std::unique_ptr<uint8_t, LightArrayFree>;
+
+enum class LightChannel
+{
+    sky,
+    block,
+};
+
+struct ChunkMemoryUsage
+{
+    size_t vertical_chunks   = 0;  // non empty vertical chunks
+    size_t paletted_chunks   = 0;
+    size_t uniform_chunks    = 0;  // vertical chunks filled with a single non air tile, these take no storage
+    size_t resident_bytes    = 0;  // bytes held by allocated vertical chunks, their tiles, occupancy masks and light
+    size_t flat_bytes        = 0;  // bytes the same vertical chunks take as flat tile arrays
+    size_t bits_histogram[4] = {}; // paletted vertical chunks using 1/2/4/8 bits per tile
+
+    ChunkMemoryUsage& operator+=(const ChunkMemoryUsage& o);
+};
+
+// reads the tiles of a vertical chunk without going through its chunk, indexed like a flat tile array. it stays valid
+// until the vertical chunk is written
+struct TileView
+{
+    const Tile* flat              = nullptr;
+    const PalettedTiles* paletted = nullptr;
+
+    inline Tile get(uint32_t index) const { return flat ? flat[index] : paletted->get(index); }
+};
+
+class ChunkSnapshot;
+
 class Chunk
 {
+    friend class ChunkSnapshot;
+
 public:
-    static constexpr int32_t chunk_size           = 32;
+    static constexpr int32_t chunk_size_log2      = CHUNK_SIZE_LOG2;
+    static constexpr int32_t chunk_size           = CHUNK_SIZE;
     static constexpr int32_t chunk_surface_area   = chunk_size * chunk_size;
     static constexpr int32_t chunk_volume         = chunk_size * chunk_size * chunk_size;
-    static constexpr int32_t vertical_chunk_count = 8;
+    static constexpr int32_t vertical_chunk_count = VERTICAL_CHUNK_COUNT;
+    static constexpr int32_t height               = chunk_size * vertical_chunk_count;
+    static_assert(chunk_size_log2 >= 4 && chunk_size_log2 <= 6);
+
+    // the world starts at this y whatever the chunk size. chunks count y from the bottom of the column so it is never
+    // negative, World converts between the two
+    static constexpr int32_t min_y              = -512;
+    static constexpr int32_t min_vertical_chunk = min_y / chunk_size;
 
-    static inline glm::ivec3 chunk_pos_real_pos(glm::ivec3 vec) { return vec << 5; }
-    static inline glm::ivec3 real_pos_to_chunk_pos(glm::ivec3 vec) { return vec >> 5; }
-    static inline glm::ivec3 real_pos_to_in_chunk_pos(glm::ivec3 vec) { return vec & 31; }
+    // one bit per vertical chunk
+    using VerticalChunkMask = uint64_t;
+    static constexpr VerticalChunkMask all_vertical_chunks = ~VerticalChunkMask(0) >> (64 - vertical_chunk_count);
+    static_assert(vertical_chunk_count <= 64);
+
+    // one bit per tile of a column of a vertical chunk
+    using ColumnMask = std::conditional_t<chunk_size == 16, uint16_t, std::conditional_t<chunk_size == 32, uint32_t, uint64_t>>;
+    static constexpr ColumnMask full_column = ~ColumnMask(0);
+
+    // one mask per column of a vertical chunk, indexed by x + z * chunk_size. bit y is set if the tile is solid
+    using Occupancy = std::array<ColumnMask, chunk_surface_area>;
+
+    // one past the highest solid tile of every column, indexed by x + z * chunk_size. 0 for columns without solid tiles
+    using Heightmap = std::array<uint16_t, chunk_surface_area>;
+
+    static inline glm::ivec3 chunk_pos_real_pos(glm::ivec3 vec) { return vec << chunk_size_log2; }
+    static inline glm::ivec3 real_pos_to_chunk_pos(glm::ivec3 vec) { return vec >> chunk_size_log2; }
+    static inline glm::ivec2 real_pos_to_chunk_pos(glm::ivec2 vec) { return vec >> chunk_size_log2; }
+    static inline glm::ivec3 real_pos_to_in_chunk_pos(glm::ivec3 vec) { return vec & (chunk_size - 1); }
+    static inline int32_t real_y_to_column_y(int32_t y) { return y - min_y; }
+    static inline int32_t column_y_to_real_y(int32_t y) { return y + min_y; }
 
     Chunk();
     ~Chunk();
 
+    // flat vertical chunk arrays are chunk_volume sized blocks of this pool. the contents are uninitialized
+    static TileArray allocate_tile_array();
+    static BlockPool& tile_array_pool();
+
+    static constexpr uint8_t max_light         = 15;
+    static constexpr int32_t light_array_bytes = chunk_volume / 2;
+
+    // light arrays hold 4 bits per tile, the tile with the lower index in the low bits
+    static LightArray allocate_light_array();
+    static BlockPool& light_array_pool();
+
     glm::ivec2 pos()const {return glm::vec2(m_pos_x,m_pos_z);}
 
     Tile get_block(uint32_t x, uint32_t y, uint32_t z) const;
     void set_block(Tile t, uint32_t x, uint32_t y, uint32_t z);
 
+    // unpacks a paletted vertical chunk into flat storage. nullptr if the vertical chunk is empty. the occupancy of the
+    // vertical chunk is out of date until update_occupancy is called since the tiles may be written through the pointer
     Tile* get_tile_array(uint32_t vertical_chunk);
+    // nullptr if the vertical chunk is empty or isn't stored flat, use read_tile_array for a view of any storage.
+    // uniform vertical chunks return a shared read only array
     const Tile* get_tile_array(uint32_t vertical_chunk) const;
 
+    // returns the tiles of the vertical chunk as a flat array, unpacking into scratch (chunk_volume tiles) if it is paletted
+    const Tile* read_tile_array(uint32_t vertical_chunk, Tile* scratch) const;
+    const Tile* read_tile_array_of_neighbor(uint32_t vertical_chunk, TileFacing dir, Tile* scratch) const;
+
+    // any storage without unpacking it, air for vertical chunks that are empty, not loaded or out of range
+    TileView view_tiles(uint32_t vertical_chunk) const;
+    static TileView view_uniform(Tile t);
+
+    // the vertical chunks from loaded_beg up to loaded_end hold generated or stored tiles. chunks in a World are loaded
+    // up to the top, deeper vertical chunks are added by merge_below once they are needed. tiles of vertical chunks that
+    // aren't loaded read as air, their occupancy as solid and their light as dark, so nothing is meshed or lit against
+    // tiles that aren't known yet
+    inline uint32_t loaded_beg() const { return m_loaded_beg; }
+    inline uint32_t loaded_end() const { return m_loaded_end; }
+    inline bool is_vertical_chunk_loaded(uint32_t vertical_chunk) const
+    {
+        return vertical_chunk >= m_loaded_beg && vertical_chunk < m_loaded_end;
+    }
+    // the chunk is empty and the vertical chunks outside the range are dropped
+    void set_loaded_range(uint32_t beg, uint32_t end);
+    // moves the vertical chunks of below, whose loaded range has to end where the one of this chunk begins, into this
+    // chunk. they are dark until LightEngine::add_vertical_chunks lights them
+    void merge_below(std::unique_ptr<Chunk> below);
+
+    // also true for vertical chunks that aren't loaded
+    bool is_vertical_chunk_empty(uint32_t vertical_chunk) const;
+
+    // the tile filling the whole vertical chunk if it has no storage (air for empty ones)
+    std::optional<Tile> get_uniform_tile(uint32_t vertical_chunk) const;
+    std::optional<Tile> get_uniform_tile_of_neighbor(uint32_t vertical_chunk, TileFacing dir) const;
+
+    // kept up to date by set_block. vertical chunks without storage, ones that aren't loaded and out of range ones share
+    // constant masks
+    const Occupancy& get_occupancy(uint32_t vertical_chunk) const;
+    // empty masks if the neighbor isn't loaded
+    const Occupancy& get_occupancy_of_neighbor(uint32_t vertical_chunk, TileFacing dir) const;
+    // rebuilds the occupancy of vertical chunks whose tiles were handed out by get_tile_array, and the heightmap if any
+    // vertical chunk was replaced
+    void update_occupancy();
+
+    // tile storage that had to be copied because a ChunkSnapshot held it when it was written, over all chunks
+    static size_t copy_on_write_count();
+
+    // kept up to date by set_block, removing the top tile of a column rescans it through the occupancy
+    inline const Heightmap& get_heightmap() const
+    {
+        assert(!m_heightmap_stale);
+        return m_heightmap;
+    }
+    inline uint32_t get_height(uint32_t x, uint32_t z) const { return get_heightmap()[x + z * chunk_size]; }
+    // no solid tile at or above y in the column
+    inline bool is_exposed_to_sky(uint32_t x, uint32_t y, uint32_t z) const { return y >= get_height(x, z); }
+
+    // light levels of the tiles, chunks start out dark until LightEngine lights them. vertical chunks with a single
+    // level in a channel take no storage for it
+    uint8_t get_light(LightChannel channel, uint32_t x, uint32_t y, uint32_t z) const;
+    void set_light(LightChannel channel, uint8_t level, uint32_t x, uint32_t y, uint32_t z);
+    void set_vertical_chunk_light_uniform(LightChannel channel, uint8_t level, uint32_t vertical_chunk);
+    // the level of every tile in the vertical chunk if the channel has no light array
+    std::optional<uint8_t> get_uniform_light(LightChannel channel, uint32_t vertical_chunk) const;
+    // light array of the vertical chunk for bulk writes, created from the uniform level if there is none
+    uint8_t* get_light_array(LightChannel channel, uint32_t vertical_chunk);
+    // drops light arrays holding a single level
+    void compress_light();
+
+    // converts flat vertical chunks into paletted storage. vertical chunks made of a single tile lose their storage.
+    // ones a snapshot holds are left as they are
+    void compress();
+    // the same for one vertical chunk, its occupancy has to be up to date
+    void compress_vertical_chunk(uint32_t vertical_chunk);
+
+    ChunkMemoryUsage memory_usage() const;
+
+    // appends the tiles of all vertical chunks to out, flat ones are stored paletted
+    void serialize(std::vector<uint8_t>& out) const;
+    // nullptr if the data is truncated or invalid. the position and neighbors are left for World to set
+    static std::unique_ptr<Chunk> deserialize(const uint8_t* data, size_t size);
+
     inline int32_t x() const { return m_pos_x; }
     inline int32_t z() const { return m_pos_z; }
 
-    inline void set_vertical_chunk(std::unique_ptr<Tile, Free> v_chunk, uint32_t vertical_chunk) { m_vertical_chunks[vertical_chunk] = std::move(v_chunk); }
-
-    const Tile* get_tile_array_of_neighbor(uint32_t vertical_chunk, TileFacing dir) const;
+    // the occupancy is built on the next update_occupancy
+    void set_vertical_chunk(TileArray v_chunk, uint32_t vertical_chunk);
+    // fills the vertical chunk with t without allocating, storage is created on the first set_block that changes a tile
+    void set_vertical_chunk_uniform(Tile t, uint32_t vertical_chunk);
 
     struct
     {
@@ -54,6 +228,70 @@ public:
 
     int32_t m_pos_x, m_pos_z;
 
+    // World tick at which the chunk was last within render distance, used to pick chunks to evict
+    uint32_t m_last_visible = 0;
+    // changed since it was generated or loaded, evicted chunks are only written to disk if set
+    bool m_unsaved = true;
+
 private:
-    std::array<std::unique_ptr<Tile, Free>, vertical_chunk_count> m_vertical_chunks;
+    const Chunk* get_neighbor(uint32_t& vertical_chunk, TileFacing dir) const;
+    // height of the column counting only vertical chunks up to top_vertical_chunk
+    uint16_t scan_height(uint32_t column, int32_t top_vertical_chunk) const;
+
+    // the tiles of a vertical chunk, stored flat, paletted or not at all if it is filled with the uniform tile. stored
+    // ones also keep their occupancy. snapshots share it with the chunk, once one does it isn't written anymore and
+    // the chunk writes to a copy instead
+    struct TileStorage
+    {
+        TileArray tiles;
+        std::unique_ptr<PalettedTiles> paletted;
+        std::unique_ptr<Occupancy> occupancy;
+        Tile uniform         = Tile::air;
+        bool occupancy_stale = false;
+    };
+
+    struct VerticalChunk
+    {
+        // nullptr for air
+        std::shared_ptr<TileStorage> storage;
+    };
+
+    // light is kept apart from the vertical chunks. the light engine allocates and drops it on its worker while
+    // snapshots read the vertical chunks on the render thread, so it must never create or free a vertical chunk
+    struct VerticalLight
+    {
+        // indexed by LightChannel
+        LightArray light[2];
+        uint8_t uniform_light[2] = {max_light, 0};
+    };
+
+    // nullptr if the vertical chunk is air or out of range
+    const TileStorage* get_storage(uint32_t vertical_chunk) const;
+    // tile storage of the vertical chunk for writes, allocated if there is none and copied if a snapshot holds it
+    TileStorage& get_writable_storage(uint32_t vertical_chunk);
+
+    static const Tile* read_tile_array(const TileStorage* storage, Tile* scratch);
+    static std::optional<Tile> get_uniform_tile(const TileStorage* storage);
+
+    // the vertical chunk at the index, allocated if there is none
+    VerticalChunk& allocate_vertical_chunk(uint32_t vertical_chunk);
+    // drops the tile storage if it is uniform air, and the vertical chunk along with it, the state of loaded ones that
+    // don't exist
+    void release_if_default(uint32_t vertical_chunk);
+
+    VerticalLight& allocate_vertical_light(uint32_t vertical_chunk);
+    // drops the light of the vertical chunk if it is full sky light without block light, the state of loaded ones that
+    // have none
+    void release_light_if_default(uint32_t vertical_chunk);
+
+    // loaded vertical chunks are only allocated if they aren't air and their light only if it isn't full sky light, so
+    // the empty space above the terrain costs two pointers per vertical chunk
+    std::array<std::unique_ptr<VerticalChunk>, vertical_chunk_count> m_vertical_chunks;
+    std::array<std::unique_ptr<VerticalLight>, vertical_chunk_count> m_light;
+    uint32_t m_loaded_beg = 0;
+    uint32_t m_loaded_end = vertical_chunk_count;
+
+    // stale while any occupancy is
+    Heightmap m_heightmap = {};
+    bool m_heightmap_stale = false;
 };
@@ -0,0 +1,19 @@
+#ifndef CHUNK_DIMS_HPP
+#define CHUNK_DIMS_HPP
+
+// chunk dimensions, shared by Chunk and the chunk shaders. they are set at build time with -DCHUNK_SIZE_LOG2 and
+// -DVERTICAL_CHUNK_COUNT, which the build passes to the c++ and glsl sources alike
+
+// 4, 5 or 6 for 16, 32 or 64 tiles along each edge of a vertical chunk
+#ifndef CHUNK_SIZE_LOG2
+#define CHUNK_SIZE_LOG2 5
+#endif
+
+// vertical chunks per column, at most 64
+#ifndef VERTICAL_CHUNK_COUNT
+#define VERTICAL_CHUNK_COUNT 64
+#endif
+
+#define CHUNK_SIZE (1 << CHUNK_SIZE_LOG2)
+
+#endif
@@ -0,0 +1,213 @@
+#include "chunk_map.hpp"
+
+#include <cassert>
+
+#include "chunk.hpp"
+
+namespace
+{
+constexpr size_t initial_shard_capacity = 64;
+} // namespace
+
+ChunkMap::Table::Table(size_t capacity)
+    : mask(capacity - 1), slots(std::make_unique<Slot[]>(capacity))
+{
+    assert((capacity & mask) == 0);
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        slots[i].key.store(empty_key, std::memory_order_relaxed);
+        slots[i].chunk.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ChunkMap::ChunkMap()
+    : m_shards(std::make_unique<Shard[]>(shard_count))
+{
+    for (size_t i = 0; i < shard_count; ++i)
+        m_shards[i].table = new Table(initial_shard_capacity);
+}
+
+ChunkMap::~ChunkMap()
+{
+    for (size_t i = 0; i < shard_count; ++i)
+    {
+        auto* table = m_shards[i].table.load();
+
+        for (size_t s = 0; s <= table->mask; ++s)
+        {
+            uint64_t key = table->slots[s].key.load(std::memory_order_relaxed);
+            if (key != empty_key && key != tombstone_key) delete table->slots[s].chunk.load(std::memory_order_relaxed);
+        }
+
+        delete table;
+    }
+}
+
+Chunk* ChunkMap::lookup(uint64_t key, bool& found) const
+{
+    uint64_t h  = hash(key);
+    auto& shard = shard_of(h);
+
+    // readers are counted so a rehash knows when the tables it replaced can be freed
+    shard.readers.fetch_add(1);
+    auto* table = shard.table.load();
+
+    Chunk* chunk = nullptr;
+    found        = false;
+
+    for (size_t i = h & table->mask;; i = (i + 1) & table->mask)
+    {
+        auto& slot   = table->slots[i];
+        uint64_t cur = slot.key.load(std::memory_order_acquire);
+
+        if (cur == empty_key) break;
+        if (cur != key) continue;
+
+        chunk = slot.chunk.load(std::memory_order_acquire);
+
+        // the slot may have been erased and reused for another position while the chunk was read
+        if (slot.key.load(std::memory_order_acquire) != key)
+        {
+            i = (h & table->mask) - 1;
+            continue;
+        }
+
+        found = true;
+        break;
+    }
+
+    shard.readers.fetch_sub(1, std::memory_order_release);
+
+    return chunk;
+}
+
+Chunk* ChunkMap::get(glm::ivec2 pos) const
+{
+    bool found;
+    return lookup(pack(pos), found);
+}
+
+bool ChunkMap::contains(glm::ivec2 pos) const
+{
+    bool found;
+    lookup(pack(pos), found);
+    return found;
+}
+
+ChunkMap::Slot* ChunkMap::find_slot(Table* table, uint64_t key, uint64_t h) const
+{
+    for (size_t i = h & table->mask;; i = (i + 1) & table->mask)
+    {
+        uint64_t cur = table->slots[i].key.load(std::memory_order_relaxed);
+
+        if (cur == key) return &table->slots[i];
+        if (cur == empty_key) return nullptr;
+    }
+}
+
+std::unique_ptr<Chunk> ChunkMap::insert(glm::ivec2 pos, std::unique_ptr<Chunk> chunk)
+{
+    uint64_t key = pack(pos);
+    uint64_t h   = hash(key);
+    auto& shard  = shard_of(h);
+
+    assert(key != empty_key && key != tombstone_key);
+
+    auto guard  = std::lock_guard(shard.lock);
+    auto* table = shard.table.load(std::memory_order_relaxed);
+
+    if (auto* slot = find_slot(table, key, h))
+    {
+        auto* old = slot->chunk.exchange(chunk.release(), std::memory_order_acq_rel);
+        return std::unique_ptr<Chunk>(old);
+    }
+
+    // keep the load under 1/2 so probes for missing positions stay short, counting tombstones since they lengthen probes
+    // just the same
+    if ((shard.size + shard.tombstones + 1) * 2 > table->mask + 1)
+    {
+        size_t capacity = table->mask + 1;
+        while ((shard.size + 1) * 4 > capacity)
+            capacity *= 2;
+
+        rehash(shard, capacity);
+        table = shard.table.load(std::memory_order_relaxed);
+    }
+
+    for (size_t i = h & table->mask;; i = (i + 1) & table->mask)
+    {
+        auto& slot   = table->slots[i];
+        uint64_t cur = slot.key.load(std::memory_order_relaxed);
+
+        if (cur != empty_key && cur != tombstone_key) continue;
+
+        if (cur == tombstone_key) shard.tombstones--;
+        shard.size++;
+
+        // the chunk is published before the key so a reader that finds the key also sees the chunk
+        slot.chunk.store(chunk.release(), std::memory_order_release);
+        slot.key.store(key, std::memory_order_release);
+
+        return nullptr;
+    }
+}
+
+std::unique_ptr<Chunk> ChunkMap::erase(glm::ivec2 pos)
+{
+    uint64_t key = pack(pos);
+    uint64_t h   = hash(key);
+    auto& shard  = shard_of(h);
+
+    auto guard = std::lock_guard(shard.lock);
+
+    auto* slot = find_slot(shard.table.load(std::memory_order_relaxed), key, h);
+    if (slot == nullptr) return nullptr;
+
+    slot->key.store(tombstone_key, std::memory_order_release);
+    auto* chunk = slot->chunk.exchange(nullptr, std::memory_order_acq_rel);
+
+    shard.size--;
+    shard.tombstones++;
+
+    return std::unique_ptr<Chunk>(chunk);
+}
+
+void ChunkMap::rehash(Shard& shard, size_t capacity)
+{
+    auto* old_table = shard.table.load(std::memory_order_relaxed);
+    auto* new_table = new Table(capacity);
+
+    for (size_t s = 0; s <= old_table->mask; ++s)
+    {
+        uint64_t key = old_table->slots[s].key.load(std::memory_order_relaxed);
+        if (key == empty_key || key == tombstone_key) continue;
+
+        size_t i = hash(key) & new_table->mask;
+        while (new_table->slots[i].key.load(std::memory_order_relaxed) != empty_key)
+            i = (i + 1) & new_table->mask;
+
+        new_table->slots[i].chunk.store(old_table->slots[s].chunk.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        new_table->slots[i].key.store(key, std::memory_order_relaxed);
+    }
+
+    shard.table.store(new_table);
+    shard.tombstones = 0;
+    shard.retired.emplace_back(old_table);
+
+    // readers that start after the store above only see the new table
+    if (shard.readers.load() == 0) shard.retired.clear();
+}
+
+size_t ChunkMap::size() const
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i < shard_count; ++i)
+    {
+        auto guard = std::lock_guard(m_shards[i].lock);
+        size += m_shards[i].size;
+    }
+
+    return size;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <inttypes.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+class Chunk;
+
+// owning map from chunk position to chunk. open addressing with linear probing over packed coordinates, split into
+// shards that each have their own write lock. lookups take no lock and can run on any thread while another thread writes.
+// positions can be present with a null chunk, World uses these as placeholders for chunks that are being generated.
+// the map doesn't keep chunks alive for readers, erasing a chunk other threads are still using is up to the caller
+class ChunkMap
+{
+    ChunkMap(const ChunkMap&) = delete;
+
+public:
+    ChunkMap();
+    ~ChunkMap();
+
+    // nullptr if pos is missing or a placeholder
+    Chunk* get(glm::ivec2 pos) const;
+    bool contains(glm::ivec2 pos) const;
+
+    // inserts or replaces the chunk at pos, returns the replaced chunk
+    std::unique_ptr<Chunk> insert(glm::ivec2 pos, std::unique_ptr<Chunk> chunk);
+    // returns the erased chunk, or nullptr if pos was missing or a placeholder
+    std::unique_ptr<Chunk> erase(glm::ivec2 pos);
+
+    size_t size() const;
+
+    // calls func(glm::ivec2 pos, Chunk* chunk) for every position, placeholders included. the map must not be modified
+    // from func
+    template <typename Func>
+    void for_each(Func&& func) const;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> key;
+        std::atomic<Chunk*> chunk;
+    };
+
+    struct Table
+    {
+        Table(size_t capacity);
+
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex lock;
+        std::atomic<Table*> table;
+        std::atomic<uint32_t> readers = 0;
+
+        size_t size       = 0;
+        size_t tombstones = 0;
+
+        // tables replaced by a rehash, freed once no reader can be using them
+        std::vector<std::unique_ptr<Table>> retired;
+    };
+
+    static constexpr uint32_t shard_bits = 4;
+    static constexpr size_t shard_count  = 1 << shard_bits;
+
+    static constexpr uint64_t empty_key     = 0x8000000080000000ull; // INT32_MIN, INT32_MIN
+    static constexpr uint64_t tombstone_key = 0x8000000080000001ull; // INT32_MIN, INT32_MIN + 1
+
+    static inline uint64_t pack(glm::ivec2 pos) { return (uint64_t(uint32_t(pos.x)) << 32) | uint32_t(pos.y); }
+    static inline glm::ivec2 unpack(uint64_t key) { return glm::ivec2(int32_t(key >> 32), int32_t(key)); }
+
+    static inline uint64_t hash(uint64_t key)
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ull;
+        key ^= key >> 33;
+        return key;
+    }
+
+    inline Shard& shard_of(uint64_t h) const { return m_shards[h >> (64 - shard_bits)]; }
+
+    // slot holding key, nullptr if it is missing. only used under the shard lock
+    Slot* find_slot(Table* table, uint64_t key, uint64_t h) const;
+    // chunk at key if present, set found to false if it is missing
+    Chunk* lookup(uint64_t key, bool& found) const;
+    void rehash(Shard& shard, size_t capacity);
+
+    std::unique_ptr<Shard[]> m_shards;
+};
+
+template <typename Func>
+void ChunkMap::for_each(Func&& func) const
+{
+    for (size_t i = 0; i < shard_count; ++i)
+    {
+        auto& shard = m_shards[i];
+        auto guard  = std::lock_guard(shard.lock);
+        auto* table = shard.table.load(std::memory_order_relaxed);
+
+        for (size_t s = 0; s <= table->mask; ++s)
+        {
+            uint64_t key = table->slots[s].key.load(std::memory_order_relaxed);
+            if (key == empty_key || key == tombstone_key) continue;
+
+            func(unpack(key), table->slots[s].chunk.load(std::memory_order_relaxed));
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#include "chunk_snapshot.hpp"
+
+#include <atomic>
+
+namespace
+{
+std::atomic<uint64_t> next_epoch = 1;
+} // namespace
+
+ChunkSnapshot::ChunkSnapshot(const Chunk* chunk, uint32_t vertical_chunk)
+    : m_pos(chunk->x(), (int32_t)vertical_chunk + Chunk::min_vertical_chunk, chunk->z()), m_epoch(next_epoch++)
+{
+    assert(vertical_chunk < Chunk::vertical_chunk_count);
+
+    auto share = [](const Chunk* chunk, uint32_t vertical_chunk) -> std::shared_ptr<const Chunk::TileStorage> {
+        if (vertical_chunk >= Chunk::vertical_chunk_count || chunk->m_vertical_chunks[vertical_chunk] == nullptr) return nullptr;
+
+        return chunk->m_vertical_chunks[vertical_chunk]->storage;
+    };
+
+    // the occupancy points into the shared storage or to the constant masks of Chunk
+    m_storage   = share(chunk, vertical_chunk);
+    m_occupancy = &chunk->get_occupancy(vertical_chunk);
+
+    for (int dir = 0; dir < 6; ++dir)
+    {
+        uint32_t neighbor_vertical = vertical_chunk;
+        auto* neighbor             = chunk->get_neighbor(neighbor_vertical, (TileFacing)dir);
+
+        if (neighbor) m_neighbors[dir] = share(neighbor, neighbor_vertical);
+        m_neighbor_occupancy[dir] = &chunk->get_occupancy_of_neighbor(vertical_chunk, (TileFacing)dir);
+    }
+}
+
+bool ChunkSnapshot::is_empty() const
+{
+    return Chunk::get_uniform_tile(m_storage.get()) == Tile::air;
+}
+
+const Tile* ChunkSnapshot::read_tile_array(Tile* scratch) const
+{
+    return Chunk::read_tile_array(m_storage.get(), scratch);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <memory>
+
+#include <glm/vec3.hpp>
+
+#include "chunk.hpp"
+
+// read only view of the tiles of a vertical chunk and the occupancy of its six neighbors as they were when it was taken.
+// it holds references to their tile storage, which chunks copy before writing once a snapshot shares it, so it stays
+// consistent and can be read on any thread while the world keeps changing. snapshots have to be taken on the thread
+// that changes the chunks, they may be released on any thread. light isn't part of it
+class ChunkSnapshot
+{
+public:
+    ChunkSnapshot() = default;
+    ChunkSnapshot(const Chunk* chunk, uint32_t vertical_chunk);
+
+    // position of the vertical chunk in chunks, y counted in world chunk y
+    inline glm::ivec3 pos() const { return m_pos; }
+    // grows with every snapshot taken, one with a higher epoch saw every change an older one saw
+    inline uint64_t epoch() const { return m_epoch; }
+
+    // same as the methods of Chunk for the vertical chunk
+    bool is_empty() const;
+    const Tile* read_tile_array(Tile* scratch) const;
+    inline const Chunk::Occupancy& get_occupancy() const { return *m_occupancy; }
+    inline const Chunk::Occupancy& get_occupancy_of_neighbor(TileFacing dir) const
+    {
+        return *m_neighbor_occupancy[(int)dir];
+    }
+
+private:
+    glm::ivec3 m_pos = {};
+    uint64_t m_epoch = 0;
+
+    std::shared_ptr<const Chunk::TileStorage> m_storage;
+    const Chunk::Occupancy* m_occupancy = nullptr;
+
+    // keep the storage of the neighbors alive, indexed by TileFacing
+    std::shared_ptr<const Chunk::TileStorage> m_neighbors[6];
+    const Chunk::Occupancy* m_neighbor_occupancy[6] = {};
+};
@@ -0,0 +1,118 @@
+#include "climate_map.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+ClimateMap::ClimateMap(AmplifiedNoise biome, AmplifiedNoise amp, size_t max_regions)
+    : m_biome(biome), m_amp(amp), m_max_regions(max_regions)
+{
+}
+
+ChunkClimate ClimateMap::chunk_climate(glm::ivec2 chunk_pos)
+{
+    glm::ivec2 real_pos   = chunk_pos * Chunk::chunk_size;
+    glm::ivec2 region_pos = real_pos >> region_size_log2;
+    glm::ivec2 in_region  = real_pos - (region_pos << region_size_log2);
+
+    std::shared_ptr<const Region> region = this->region(region_pos);
+
+    ChunkClimate climate;
+
+    for (int32_t z = 0; z < Chunk::chunk_size; ++z)
+    {
+        int32_t gz = (in_region.y + z) / grid_spacing;
+        float tz   = static_cast<float>((in_region.y + z) % grid_spacing) / grid_spacing;
+
+        const float* row0 = region->data() + gz * region_points;
+        const float* row1 = row0 + region_points;
+
+        for (int32_t x = 0; x < Chunk::chunk_size; ++x)
+        {
+            int32_t gx = (in_region.x + x) / grid_spacing;
+            float tx   = static_cast<float>((in_region.x + x) % grid_spacing) / grid_spacing;
+
+            float a = row0[gx] + (row0[gx + 1] - row0[gx]) * tx;
+            float b = row1[gx] + (row1[gx + 1] - row1[gx]) * tx;
+
+            climate.biomes[z * Chunk::chunk_size + x] = biome_of(a + (b - a) * tz);
+        }
+    }
+
+    bool uniform = std::all_of(climate.biomes.begin(), climate.biomes.end(), [&](Biome b) { return b == climate.biomes[0]; });
+    if (uniform) climate.uniform_biome = climate.biomes[0];
+
+    return climate;
+}
+
+ClimateMapStats ClimateMap::stats() const
+{
+    std::lock_guard lock(m_mutex);
+
+    return {
+        .region_hits    = m_region_hits,
+        .region_misses  = m_region_misses,
+        .cached_regions = m_regions.size(),
+    };
+}
+
+double ClimateMap::aridity(double real_x, double real_z) const
+{
+    return m_biome.noise(real_x, real_z) - std::abs(m_amp.noise(real_x, real_z));
+}
+
+std::shared_ptr<const ClimateMap::Region> ClimateMap::region(glm::ivec2 region_pos)
+{
+    {
+        std::lock_guard lock(m_mutex);
+
+        if (auto it = m_regions.find(region_pos); it != m_regions.end())
+        {
+            it->second.last_use = ++m_use_counter;
+            m_region_hits++;
+            return it->second.region;
+        }
+    }
+
+    // sampled without the lock so the other workers keep going, if two sample the same region the first one is kept
+    std::shared_ptr<const Region> region = sample_region(region_pos);
+
+    std::lock_guard lock(m_mutex);
+
+    auto [it, inserted] = m_regions.try_emplace(region_pos, CachedRegion{region, 0});
+    it->second.last_use = ++m_use_counter;
+    m_region_misses++;
+
+    // the regions still in use by a worker stay alive until it is done with them
+    while (m_regions.size() > m_max_regions)
+    {
+        auto oldest = std::min_element(m_regions.begin(), m_regions.end(),
+            [](const auto& a, const auto& b) { return a.second.last_use < b.second.last_use; });
+        m_regions.erase(oldest);
+    }
+
+    return it->second.region;
+}
+
+std::shared_ptr<const ClimateMap::Region> ClimateMap::sample_region(glm::ivec2 region_pos) const
+{
+    auto region = std::make_shared<Region>(region_points * region_points);
+
+    glm::dvec2 origin = region_pos * region_size;
+
+    std::array<double, region_points> xs, zs, biome, amp;
+    for (int32_t x = 0; x < region_points; ++x)
+        xs[x] = origin.x + x * grid_spacing;
+
+    for (int32_t z = 0; z < region_points; ++z)
+    {
+        zs.fill(origin.y + z * grid_spacing);
+
+        m_biome.noise(xs.data(), zs.data(), biome.data(), region_points);
+        m_amp.noise(xs.data(), zs.data(), amp.data(), region_points);
+
+        for (int32_t x = 0; x < region_points; ++x)
+            (*region)[z * region_points + x] = biome[x] - std::abs(amp[x]);
+    }
+
+    return region;
+}
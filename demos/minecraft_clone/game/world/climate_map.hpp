@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/vec2.hpp>
+
+#include "../../util/noise.hpp"
+#include "chunk.hpp"
+
+enum class Biome : uint8_t
+{
+    plains,
+    desert,
+};
+
+// the biome of every column of a chunk, z major
+struct ChunkClimate
+{
+    std::array<Biome, Chunk::chunk_surface_area> biomes;
+    // set when all columns share a biome, so stages can decide once for the whole chunk
+    std::optional<Biome> uniform_biome;
+
+    Biome get(uint32_t x, uint32_t z) const { return biomes[z * Chunk::chunk_size + x]; }
+};
+
+struct ClimateMapStats
+{
+    size_t region_hits;
+    size_t region_misses;
+    size_t cached_regions;
+};
+
+// the climate noise of WorldGen varies over hundreds of tiles, so it is sampled on a coarse grid over regions of the
+// world and bilinearly interpolated per column. the regions are kept in a cache shared by the workers of a WorldGen,
+// the least recently used ones are dropped once it is full
+class ClimateMap
+{
+    ClimateMap(const ClimateMap&) = delete;
+
+public:
+    static constexpr int32_t region_size_log2 = 9;
+    static constexpr int32_t region_size      = 1 << region_size_log2;
+    static constexpr int32_t grid_spacing     = 8;
+    static constexpr int32_t region_points    = region_size / grid_spacing + 1;
+
+    static_assert(region_size % Chunk::chunk_size == 0, "chunks have to lie in a single region");
+
+    // biome is the noise that makes deserts, amp the amplitude of the terrain, which keeps deserts out of mountains
+    ClimateMap(AmplifiedNoise biome, AmplifiedNoise amp, size_t max_regions = 64);
+
+    ChunkClimate chunk_climate(glm::ivec2 chunk_pos);
+    ClimateMapStats stats() const;
+
+    // the value the biome is decided on, exactly at a real x and z
+    double aridity(double real_x, double real_z) const;
+    static Biome biome_of(double aridity) { return aridity > 1.32 ? Biome::desert : Biome::plains; }
+
+private:
+    // aridity at the grid points of a region, x major within rows of z
+    using Region = std::vector<float>;
+
+    struct CachedRegion
+    {
+        std::shared_ptr<const Region> region;
+        uint64_t last_use;
+    };
+
+    std::shared_ptr<const Region> region(glm::ivec2 region_pos);
+    std::shared_ptr<const Region> sample_region(glm::ivec2 region_pos) const;
+
+    const AmplifiedNoise m_biome;
+    const AmplifiedNoise m_amp;
+    const size_t m_max_regions;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<glm::ivec2, CachedRegion> m_regions;
+    uint64_t m_use_counter = 0;
+
+    std::atomic<size_t> m_region_hits   = 0;
+    std::atomic<size_t> m_region_misses = 0;
+};
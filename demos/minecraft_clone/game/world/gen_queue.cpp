@@ -0,0 +1,127 @@
+#include "gen_queue.hpp"
+
+#include <algorithm>
+
+#include <glm/geometric.hpp>
+
+float GenFocus::priority(glm::ivec2 chunk_pos) const
+{
+    glm::vec2 offset = glm::vec2(chunk_pos) + 0.5f - pos;
+    float distance   = glm::length(offset);
+
+    if (distance < 1.5f || dir == glm::vec2(0)) return distance;
+
+    float cos = glm::dot(offset / distance, dir);
+
+    return distance * (1.5f - 0.5f * cos);
+}
+
+bool GenQueue::goes_after(const Entry& a, const Entry& b)
+{
+    return a.priority != b.priority ? a.priority > b.priority : a.order > b.order;
+}
+
+void GenQueue::push_locked(const ChunkGenRequest& request)
+{
+    float priority = m_has_focus ? m_focus.priority(request.pos) : 0.f;
+
+    m_heap.push_back(Entry{.priority = priority, .order = m_order++, .request = request});
+    std::push_heap(m_heap.begin(), m_heap.end(), goes_after);
+}
+
+void GenQueue::push(const ChunkGenRequest& request)
+{
+    {
+        auto guard = std::lock_guard(m_lock);
+        push_locked(request);
+    }
+
+    m_pushed++;
+    if (m_on_push) m_on_push();
+}
+
+void GenQueue::push(std::vector<ChunkGenRequest> requests)
+{
+    if (requests.size())
+    {
+        auto guard = std::lock_guard(m_lock);
+
+        for (auto& request : requests)
+            push_locked(request);
+    }
+
+    m_pushed += requests.size();
+    if (m_on_push && requests.size()) m_on_push();
+}
+
+std::vector<ChunkGenRequest> GenQueue::set_focus(const GenFocus& focus)
+{
+    std::vector<ChunkGenRequest> cancelled;
+
+    auto guard = std::lock_guard(m_lock);
+
+    m_focus     = focus;
+    m_has_focus = true;
+
+    float cancel_distance2 = focus.cancel_distance * focus.cancel_distance;
+
+    std::erase_if(m_heap, [&](const Entry& entry) {
+        glm::vec2 offset = glm::vec2(entry.request.pos) + 0.5f - focus.pos;
+
+        bool too_far = glm::dot(offset, offset) > cancel_distance2;
+        if (too_far) cancelled.push_back(entry.request);
+
+        return too_far;
+    });
+
+    for (auto& entry : m_heap)
+        entry.priority = focus.priority(entry.request.pos);
+
+    std::make_heap(m_heap.begin(), m_heap.end(), goes_after);
+
+    m_cancelled += cancelled.size();
+
+    return cancelled;
+}
+
+void GenQueue::close()
+{
+    auto guard = std::lock_guard(m_lock);
+    m_closed   = true;
+}
+
+uint32_t GenQueue::fetch_available(std::vector<ChunkGenRequest>& pushed_vec, uint32_t max_fetch)
+{
+    auto guard = std::lock_guard(m_lock);
+
+    if (m_closed) return 0;
+
+    uint32_t fetch_count = std::min<size_t>(max_fetch, m_heap.size());
+
+    for (uint32_t i = 0; i < fetch_count; ++i)
+    {
+        std::pop_heap(m_heap.begin(), m_heap.end(), goes_after);
+
+        pushed_vec.push_back(m_heap.back().request);
+        m_heap.pop_back();
+    }
+
+    return fetch_count;
+}
+
+size_t GenQueue::size() const
+{
+    auto guard = std::lock_guard(m_lock);
+    return m_closed ? 0 : m_heap.size();
+}
+
+GenQueueStats GenQueue::stats() const
+{
+    auto guard = std::lock_guard(m_lock);
+
+    return GenQueueStats{
+        .pushed    = m_pushed.load(),
+        .cancelled = m_cancelled.load(),
+        .queued    = m_heap.size(),
+    };
+}
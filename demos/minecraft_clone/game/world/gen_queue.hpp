@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include "chunk.hpp"
+
+// the vertical chunks from beg up to end of the column at pos. whole columns, the ones ending at the top, also reach down
+// to the bottom of their terrain surface so it is never cut off and come back lit. the others are meant to be merged
+// below a loaded chunk with Chunk::merge_below
+struct ChunkGenRequest
+{
+    glm::ivec2 pos;
+    uint32_t beg = Chunk::real_y_to_column_y(0) / Chunk::chunk_size;
+    uint32_t end = Chunk::vertical_chunk_count;
+};
+
+// where the player is and looks, in chunks
+struct GenFocus
+{
+    glm::vec2 pos = {};
+    // horizontal and normalized, zero when the direction doesn't matter
+    glm::vec2 dir = {};
+    // requests further than this from pos are dropped
+    float cancel_distance = std::numeric_limits<float>::infinity();
+
+    // lower goes first. the distance to the center of the chunk, up to twice that behind the player. the chunks around
+    // the player come first whatever the direction
+    float priority(glm::ivec2 chunk_pos) const;
+};
+
+struct GenQueueStats
+{
+    size_t pushed;
+    size_t cancelled;
+    size_t queued;
+};
+
+// the requests waiting for WorldGen, the ones closest to the focus go first. without a focus they go in
+// the order they were pushed. the focus is meant to be moved along with the player, the queue is reordered then and
+// the requests that got too far are dropped
+class GenQueue
+{
+public:
+    // nothing is fetched from then on
+    void close();
+
+    // called after every push, outside of the lock
+    void set_on_push(std::function<void()> on_push) { m_on_push = std::move(on_push); }
+
+    void push(const ChunkGenRequest& request);
+    void push(std::vector<ChunkGenRequest> requests);
+
+    // reorders the queued requests for the new focus, returns the ones that were dropped
+    std::vector<ChunkGenRequest> set_focus(const GenFocus& focus);
+
+    // appends up to max_fetch requests to the back of the vec, returns how many were appended
+    uint32_t fetch_available(std::vector<ChunkGenRequest>& pushed_vec, uint32_t max_fetch);
+
+    size_t size() const;
+
+    GenQueueStats stats() const;
+
+private:
+    struct Entry
+    {
+        float priority;
+        uint64_t order;
+        ChunkGenRequest request;
+    };
+
+    // heap order, the entry at the front goes first
+    static bool goes_after(const Entry& a, const Entry& b);
+
+    void push_locked(const ChunkGenRequest& request);
+
+    mutable std::mutex m_lock;
+    std::function<void()> m_on_push;
+
+    std::vector<Entry> m_heap;
+    GenFocus m_focus;
+    bool m_has_focus = false;
+    bool m_closed    = false;
+    uint64_t m_order = 0;
+
+    std::atomic<size_t> m_pushed    = 0;
+    std::atomic<size_t> m_cancelled = 0;
+};
@@ -0,0 +1,527 @@
+#include "light_engine.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+constexpr int32_t last       = Chunk::chunk_size - 1;
+constexpr int32_t world_top  = Chunk::height - 1;
+constexpr LightChannel sky   = LightChannel::sky;
+constexpr LightChannel block = LightChannel::block;
+
+inline bool is_solid_at(const Chunk* chunk, uint32_t x, uint32_t y, uint32_t z)
+{
+    return (chunk->get_occupancy(y / Chunk::chunk_size)[x + z * Chunk::chunk_size] >> (y % Chunk::chunk_size)) & 1;
+}
+
+inline void set_nibble(uint8_t* light, uint32_t tile_index, uint8_t level)
+{
+    uint8_t& pair  = light[tile_index / 2];
+    uint32_t shift = tile_index % 2 * 4;
+
+    pair = (pair & ~(0xf << shift)) | (level << shift);
+}
+
+// the level a neighbor in dir gets from a tile of the given level
+inline uint8_t spread_level(LightChannel channel, TileFacing dir, uint8_t level)
+{
+    return channel == sky && dir == TileFacing::yn && level == Chunk::max_light ? level : level - 1;
+}
+
+} // namespace
+
+LightEngine::LightEngine()
+{
+    m_worker = std::jthread([this] { worker_func(); });
+}
+
+LightEngine::~LightEngine()
+{
+    {
+        std::lock_guard lock(m_lock);
+        m_stopping = true;
+    }
+
+    m_cv.notify_all();
+}
+
+bool LightEngine::step(const Node& node, TileFacing dir, Node& next)
+{
+    next = node;
+
+    switch (dir)
+    {
+    case TileFacing::xp:
+        if (node.x == last)
+        {
+            next.chunk = node.chunk->m_neighbor.xp;
+            next.x     = 0;
+        }
+        else
+        {
+            next.x++;
+        }
+        break;
+    case TileFacing::xn:
+        if (node.x == 0)
+        {
+            next.chunk = node.chunk->m_neighbor.xn;
+            next.x     = last;
+        }
+        else
+        {
+            next.x--;
+        }
+        break;
+    case TileFacing::zp:
+        if (node.z == last)
+        {
+            next.chunk = node.chunk->m_neighbor.zp;
+            next.z     = 0;
+        }
+        else
+        {
+            next.z++;
+        }
+        break;
+    case TileFacing::zn:
+        if (node.z == 0)
+        {
+            next.chunk = node.chunk->m_neighbor.zn;
+            next.z     = last;
+        }
+        else
+        {
+            next.z--;
+        }
+        break;
+    case TileFacing::yp:
+        if (node.y == world_top) return false;
+        next.y++;
+        break;
+    case TileFacing::yn:
+        if (node.y == 0) return false;
+        next.y--;
+        break;
+    }
+
+    return next.chunk != nullptr;
+}
+
+void LightEngine::NodeQueue::erase_chunk(const Chunk* chunk)
+{
+    auto end = std::remove_if(m_nodes.begin() + m_head, m_nodes.end(), [chunk](const Node& node) { return node.chunk == chunk; });
+    m_nodes.erase(end, m_nodes.end());
+}
+
+size_t LightEngine::Queues::size() const
+{
+    return removals[0].size() + removals[1].size() + additions[0].size() + additions[1].size();
+}
+
+size_t LightEngine::Queues::process(size_t budget)
+{
+    size_t processed = 0;
+    Node node, next;
+
+    for (int c = 0; c < 2; ++c)
+    {
+        auto channel = (LightChannel)c;
+
+        while (processed < budget && removals[c].pop(node))
+        {
+            processed++;
+
+            for (int dir = 0; dir < 6; ++dir)
+            {
+                if (!step(node, (TileFacing)dir, next)) continue;
+
+                uint8_t level = next.chunk->get_light(channel, next.x, next.y, next.z);
+                if (level == 0) continue;
+
+                // light the removed tile could have given is cleared too, brighter light is spread back into the gap
+                bool sunlight_below = channel == sky && dir == (int)TileFacing::yn && node.level == Chunk::max_light;
+
+                if (level < node.level || (sunlight_below && level == Chunk::max_light))
+                {
+                    next.chunk->set_light(channel, 0, next.x, next.y, next.z);
+                    next.level = level;
+                    removals[c].push(next);
+
+                    uint8_t emission = tile_light_emission[(uint32_t)next.chunk->get_block(next.x, next.y, next.z)];
+
+                    if (channel == block && emission)
+                    {
+                        next.chunk->set_light(channel, emission, next.x, next.y, next.z);
+                        additions[c].push(next);
+                    }
+                }
+                else
+                {
+                    additions[c].push(next);
+                }
+            }
+        }
+    }
+
+    for (int c = 0; c < 2; ++c)
+    {
+        auto channel = (LightChannel)c;
+
+        while (processed < budget && additions[c].pop(node))
+        {
+            processed++;
+
+            uint8_t level = node.chunk->get_light(channel, node.x, node.y, node.z);
+            if (level <= 1) continue;
+
+            for (int dir = 0; dir < 6; ++dir)
+            {
+                if (!step(node, (TileFacing)dir, next) || is_solid_at(next.chunk, next.x, next.y, next.z)) continue;
+
+                uint8_t next_level = spread_level(channel, (TileFacing)dir, level);
+                if (next.chunk->get_light(channel, next.x, next.y, next.z) >= next_level) continue;
+
+                next.chunk->set_light(channel, next_level, next.x, next.y, next.z);
+                additions[c].push(next);
+            }
+        }
+    }
+
+    return processed;
+}
+
+void LightEngine::light_chunk(Chunk* chunk)
+{
+    const auto& heights = chunk->get_heightmap();
+
+    auto [min_height, max_height] = std::minmax_element(heights.begin(), heights.end());
+
+    Queues queues;
+
+    // tiles above the top of their column see the sky
+    for (uint32_t v = chunk->loaded_beg(); v < Chunk::vertical_chunk_count; ++v)
+    {
+        int32_t bottom = v * Chunk::chunk_size;
+
+        chunk->set_vertical_chunk_light_uniform(block, 0, v);
+        chunk->set_vertical_chunk_light_uniform(sky, bottom >= *max_height ? Chunk::max_light : 0, v);
+
+        if (bottom >= *max_height || bottom + Chunk::chunk_size <= *min_height) continue;
+
+        uint8_t* light = chunk->get_light_array(sky, v);
+
+        for (int32_t i = 0; i < Chunk::chunk_surface_area; ++i)
+        {
+            for (int32_t y = std::max<int32_t>(heights[i] - bottom, 0); y < Chunk::chunk_size; ++y)
+                set_nibble(light, i + y * Chunk::chunk_surface_area, Chunk::max_light);
+        }
+    }
+
+    // sky light spreads sideways from the open part of a column into the columns next to it that are higher
+    for (uint32_t z = 0; z < Chunk::chunk_size; ++z)
+    {
+        for (uint32_t x = 0; x < Chunk::chunk_size; ++x)
+        {
+            uint32_t highest_neighbor = 0;
+
+            if (x > 0) highest_neighbor = std::max<uint32_t>(highest_neighbor, chunk->get_height(x - 1, z));
+            if (x < last) highest_neighbor = std::max<uint32_t>(highest_neighbor, chunk->get_height(x + 1, z));
+            if (z > 0) highest_neighbor = std::max<uint32_t>(highest_neighbor, chunk->get_height(x, z - 1));
+            if (z < last) highest_neighbor = std::max<uint32_t>(highest_neighbor, chunk->get_height(x, z + 1));
+
+            // columns without solid tiles are open down to the bottom of the loaded vertical chunks
+            uint32_t open_from = std::max(chunk->get_height(x, z), chunk->loaded_beg() * Chunk::chunk_size);
+
+            for (uint32_t y = open_from; y < highest_neighbor; ++y)
+                queues.additions[(int)sky].push(Node{chunk, (uint8_t)x, (uint8_t)z, (uint16_t)y});
+        }
+    }
+
+    seed_emitters(chunk, chunk->loaded_beg(), Chunk::vertical_chunk_count, queues);
+
+    queues.process(SIZE_MAX);
+
+    chunk->compress_light();
+}
+
+void LightEngine::seed_emitters(Chunk* chunk, uint32_t beg, uint32_t end, Queues& queues)
+{
+    thread_local Tile scratch[Chunk::chunk_volume];
+
+    for (uint32_t v = beg; v < end; ++v)
+    {
+        if (auto uniform = chunk->get_uniform_tile(v); uniform && tile_light_emission[(uint32_t)*uniform] == 0) continue;
+
+        const Tile* tiles = chunk->read_tile_array(v, scratch);
+
+        for (int32_t i = 0; i < Chunk::chunk_volume; ++i)
+        {
+            if (uint8_t emission = tile_light_emission[(uint32_t)tiles[i]])
+            {
+                uint32_t x = i % Chunk::chunk_size, z = i / Chunk::chunk_size % Chunk::chunk_size;
+                uint32_t y = v * Chunk::chunk_size + i / Chunk::chunk_surface_area;
+
+                chunk->set_light(block, emission, x, y, z);
+                queues.additions[(int)block].push(Node{chunk, (uint8_t)x, (uint8_t)z, (uint16_t)y});
+            }
+        }
+    }
+}
+
+void LightEngine::add_chunk(Chunk* chunk)
+{
+    wait();
+
+    m_added.push_back(AddedRange{chunk, chunk->loaded_beg(), Chunk::vertical_chunk_count});
+}
+
+void LightEngine::add_vertical_chunks(Chunk* chunk, uint32_t beg, uint32_t end)
+{
+    wait();
+
+    m_added.push_back(AddedRange{chunk, beg, end});
+}
+
+void LightEngine::remove_chunk(const Chunk* chunk)
+{
+    wait();
+
+    std::erase_if(m_added, [chunk](const AddedRange& added) { return added.chunk == chunk; });
+
+    for (int c = 0; c < 2; ++c)
+    {
+        m_queues.removals[c].erase_chunk(chunk);
+        m_queues.additions[c].erase_chunk(chunk);
+    }
+
+    m_pending_nodes = m_queues.size();
+}
+
+void LightEngine::block_changed(Chunk* chunk, glm::ivec3 in_pos)
+{
+    wait();
+
+    Node node{chunk, (uint8_t)in_pos.x, (uint8_t)in_pos.z, (uint16_t)in_pos.y};
+    Node next;
+
+    // light flows back in from around an opened tile
+    if (!relight_tile(node))
+    {
+        for (int c = 0; c < 2; ++c)
+            for (int dir = 0; dir < 6; ++dir)
+                if (step(node, (TileFacing)dir, next)) m_queues.additions[c].push(next);
+    }
+
+    m_pending_nodes = m_queues.size();
+}
+
+void LightEngine::box_changed(Chunk* chunk, glm::ivec3 in_min, glm::ivec3 in_max)
+{
+    wait();
+
+    Node node{chunk};
+    Node next;
+
+    auto inside = [&](const Node& n) {
+        return n.chunk == chunk && n.x >= in_min.x && n.x <= in_max.x && n.y >= in_min.y && n.y <= in_max.y &&
+               n.z >= in_min.z && n.z <= in_max.z;
+    };
+
+    for (int32_t y = in_min.y; y <= in_max.y; ++y)
+    {
+        for (int32_t z = in_min.z; z <= in_max.z; ++z)
+        {
+            for (int32_t x = in_min.x; x <= in_max.x; ++x)
+            {
+                node.x = x;
+                node.y = y;
+                node.z = z;
+
+                bool solid = relight_tile(node);
+
+                bool on_face = x == in_min.x || x == in_max.x || y == in_min.y || y == in_max.y || z == in_min.z || z == in_max.z;
+                if (solid || !on_face) continue;
+
+                // the tiles inside the box were all cleared, light only comes back in from outside of it
+                for (int dir = 0; dir < 6; ++dir)
+                {
+                    if (!step(node, (TileFacing)dir, next) || inside(next)) continue;
+
+                    m_queues.additions[0].push(next);
+                    m_queues.additions[1].push(next);
+                }
+            }
+        }
+    }
+
+    m_pending_nodes = m_queues.size();
+}
+
+bool LightEngine::relight_tile(Node node)
+{
+    auto* chunk = node.chunk;
+
+    Tile tile  = chunk->get_block(node.x, node.y, node.z);
+    bool solid = is_solid(tile);
+
+    for (int c = 0; c < 2; ++c)
+    {
+        auto channel = (LightChannel)c;
+
+        // whatever lit the tile before is cleared from it and everything it lit
+        if (uint8_t level = chunk->get_light(channel, node.x, node.y, node.z))
+        {
+            chunk->set_light(channel, 0, node.x, node.y, node.z);
+            node.level = level;
+            m_queues.removals[c].push(node);
+        }
+
+        uint8_t source = channel == block ? tile_light_emission[(uint32_t)tile] : !solid && node.y == world_top ? Chunk::max_light : 0;
+
+        if (source)
+        {
+            chunk->set_light(channel, source, node.x, node.y, node.z);
+            m_queues.additions[c].push(node);
+        }
+    }
+
+    return solid;
+}
+
+void LightEngine::seed(const AddedRange& added)
+{
+    auto* chunk = added.chunk;
+
+    struct Side
+    {
+        Chunk* neighbor;
+        TileFacing dir;
+    };
+
+    Side sides[] = {
+        {chunk->m_neighbor.xp, TileFacing::xp},
+        {chunk->m_neighbor.xn, TileFacing::xn},
+        {chunk->m_neighbor.zp, TileFacing::zp},
+        {chunk->m_neighbor.zn, TileFacing::zn},
+    };
+
+    for (auto [neighbor, dir] : sides)
+    {
+        if (neighbor == nullptr) continue;
+
+        for (int c = 0; c < 2; ++c)
+        {
+            auto channel = (LightChannel)c;
+
+            for (uint32_t v = added.beg; v < added.end; ++v)
+            {
+                if (!neighbor->is_vertical_chunk_loaded(v)) continue;
+
+                auto uniform          = chunk->get_uniform_light(channel, v);
+                auto neighbor_uniform = neighbor->get_uniform_light(channel, v);
+
+                // no light can cross between vertical chunks that are uniformly lit the same
+                if (uniform && neighbor_uniform && std::abs(*uniform - *neighbor_uniform) <= 1) continue;
+
+                for (uint32_t y = v * Chunk::chunk_size; y < (v + 1) * Chunk::chunk_size; ++y)
+                {
+                    for (uint8_t i = 0; i < Chunk::chunk_size; ++i)
+                    {
+                        Node node{chunk, i, i, (uint16_t)y}, next;
+
+                        if (dir == TileFacing::xp || dir == TileFacing::xn) node.x = dir == TileFacing::xp ? last : 0;
+                        if (dir == TileFacing::zp || dir == TileFacing::zn) node.z = dir == TileFacing::zp ? last : 0;
+
+                        step(node, dir, next);
+
+                        uint8_t level          = chunk->get_light(channel, node.x, node.y, node.z);
+                        uint8_t neighbor_level = neighbor->get_light(channel, next.x, next.y, next.z);
+
+                        if (level > neighbor_level + 1 && !is_solid_at(neighbor, next.x, next.y, next.z))
+                            m_queues.additions[c].push(node);
+                        else if (neighbor_level > level + 1 && !is_solid_at(chunk, node.x, node.y, node.z))
+                            m_queues.additions[c].push(next);
+                    }
+                }
+            }
+        }
+    }
+
+    // whole chunks were lit on their own, vertical chunks merged below a chunk start out dark. light comes down from
+    // the bottom layer of the vertical chunk above them
+    if (added.end == Chunk::vertical_chunk_count) return;
+
+    seed_emitters(chunk, added.beg, added.end, m_queues);
+
+    uint16_t y = added.end * Chunk::chunk_size;
+
+    for (int c = 0; c < 2; ++c)
+    {
+        for (uint8_t z = 0; z < Chunk::chunk_size; ++z)
+            for (uint8_t x = 0; x < Chunk::chunk_size; ++x)
+                if (chunk->get_light((LightChannel)c, x, y, z) > 1) m_queues.additions[c].push(Node{chunk, x, z, y});
+    }
+}
+
+void LightEngine::start(size_t budget)
+{
+    wait();
+
+    if (m_added.empty() && m_queues.size() == 0) return;
+
+    {
+        std::lock_guard lock(m_lock);
+        m_budget = budget;
+        m_busy   = true;
+    }
+
+    m_cv.notify_all();
+}
+
+void LightEngine::wait()
+{
+    std::unique_lock lock(m_lock);
+    m_cv.wait(lock, [this] { return !m_busy; });
+}
+
+LightEngineStats LightEngine::stats() const
+{
+    return LightEngineStats{
+        .processed_nodes = m_processed_nodes.load(),
+        .pending_nodes   = m_pending_nodes.load(),
+    };
+}
+
+void LightEngine::worker_func()
+{
+    while (true)
+    {
+        size_t budget;
+
+        {
+            std::unique_lock lock(m_lock);
+            m_cv.wait(lock, [this] { return m_busy || m_stopping; });
+
+            if (m_stopping) return;
+
+            budget = m_budget;
+        }
+
+        for (auto& added : m_added)
+            seed(added);
+
+        m_added.clear();
+
+        m_processed_nodes += m_queues.process(budget);
+        m_pending_nodes = m_queues.size();
+
+        {
+            std::lock_guard lock(m_lock);
+            m_busy = false;
+        }
+
+        m_cv.notify_all();
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "chunk.hpp"
+
+struct LightEngineStats
+{
+    size_t processed_nodes; // since the engine was created
+    size_t pending_nodes;   // queued for the next batches
+};
+
+// flood fills sky and block light through non solid tiles. sky light keeps its level going straight down, otherwise
+// light loses one level per tile. new chunks are lit on their own by light_chunk on the thread that made them, light
+// crossing chunk borders and the updates after edits are queued here and processed on the engine's worker, at most a
+// budget of nodes per start() so large edits are spread over several frames. while the worker runs chunks may be read
+// but not changed, linked or destroyed, the methods changing the queues wait for it first
+class LightEngine
+{
+    LightEngine(const LightEngine&) = delete;
+
+public:
+    LightEngine();
+    ~LightEngine();
+
+    // lights a chunk that isn't linked to any neighbors yet from its own tiles, safe to call from any thread
+    static void light_chunk(Chunk* chunk);
+
+    // the chunk was linked to its neighbors, light flows across the shared borders in the next batches
+    void add_chunk(Chunk* chunk);
+    // the dark vertical chunks from beg up to end were merged into the chunk, they are lit from their own light
+    // sources, the vertical chunk above them and the neighbors in the next batches
+    void add_vertical_chunks(Chunk* chunk, uint32_t beg, uint32_t end);
+    // drops the queued work in the chunk, called before it is unlinked
+    void remove_chunk(const Chunk* chunk);
+    // the tile at in_pos was changed by set_block
+    void block_changed(Chunk* chunk, glm::ivec3 in_pos);
+    // any tile of the chunk in the box between in_min and in_max, both inclusive, may have changed. cheaper than
+    // block_changed for every tile since light is only pulled back in over the faces of the box
+    void box_changed(Chunk* chunk, glm::ivec3 in_min, glm::ivec3 in_max);
+
+    // processes up to budget nodes on the worker, does nothing if the queues are empty
+    void start(size_t budget);
+    void wait();
+
+    LightEngineStats stats() const;
+
+private:
+    struct Node
+    {
+        Chunk* chunk;
+        uint8_t x, z;
+        uint16_t y;
+        uint8_t level; // the level before it was cleared, only used by removals
+    };
+
+    // fifo that keeps its storage, popped nodes are dropped once they are half of it
+    class NodeQueue
+    {
+    public:
+        inline void push(const Node& node) { m_nodes.push_back(node); }
+        inline bool pop(Node& node)
+        {
+            if (m_head == m_nodes.size()) return false;
+
+            node = m_nodes[m_head++];
+
+            if (m_head == m_nodes.size())
+            {
+                m_nodes.clear();
+                m_head = 0;
+            }
+            else if (m_head > 4096 && m_head * 2 > m_nodes.size())
+            {
+                m_nodes.erase(m_nodes.begin(), m_nodes.begin() + m_head);
+                m_head = 0;
+            }
+
+            return true;
+        }
+        inline size_t size() const { return m_nodes.size() - m_head; }
+        void erase_chunk(const Chunk* chunk);
+
+    private:
+        std::vector<Node> m_nodes;
+        size_t m_head = 0;
+    };
+
+    // removals go before additions, both indexed by LightChannel
+    struct Queues
+    {
+        NodeQueue removals[2];
+        NodeQueue additions[2];
+
+        size_t size() const;
+        // returns the number of processed nodes
+        size_t process(size_t budget);
+    };
+
+    // the tile next to node in dir, false if it is outside the world or in a chunk that isn't loaded
+    static bool step(const Node& node, TileFacing dir, Node& next);
+
+    // clears the light of the changed tile at node and queues the light it spread for removal, sets and queues its own
+    // light if it is a source. returns if the tile is solid
+    bool relight_tile(Node node);
+
+    // vertical chunks that were added to a chunk and still have to be seeded
+    struct AddedRange
+    {
+        Chunk* chunk;
+        uint32_t beg, end;
+    };
+
+    // sets the level of the light sources in the vertical chunks from beg up to end and queues them
+    static void seed_emitters(Chunk* chunk, uint32_t beg, uint32_t end, Queues& queues);
+
+    void worker_func();
+    void seed(const AddedRange& added);
+
+    Queues m_queues;
+    std::vector<AddedRange> m_added;
+
+    std::mutex m_lock;
+    std::condition_variable m_cv;
+    size_t m_budget = 0;
+    bool m_busy     = false;
+    bool m_stopping = false;
+
+    std::atomic<size_t> m_processed_nodes = 0;
+    std::atomic<size_t> m_pending_nodes   = 0;
+
+    std::jthread m_worker;
+};
@@ -0,0 +1,141 @@
+#include "region_file.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+namespace
+{
+constexpr uint32_t region_magic   = 0x4752434d; // "MCRG"
+constexpr uint32_t region_version = 1;
+
+size_t round_to_sectors(size_t size)
+{
+    return (size + RegionFile::sector_size - 1) / RegionFile::sector_size * RegionFile::sector_size;
+}
+
+bool write_all(int fd, const void* data, size_t size, size_t offset)
+{
+    auto* bytes = static_cast<const uint8_t*>(data);
+
+    while (size > 0)
+    {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written <= 0) return false;
+
+        bytes += written;
+        offset += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+} // namespace
+
+RegionFile::RegionFile(const std::filesystem::path& path)
+{
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0) throw std::runtime_error(fmt::format("failed to open region file: {}", path.string()));
+
+    struct stat st;
+    fstat(m_fd, &st);
+
+    m_header = std::make_unique<Header>();
+
+    if (st.st_size == 0)
+    {
+        memset(m_header.get(), 0, sizeof(Header));
+        m_header->magic   = region_magic;
+        m_header->version = region_version;
+
+        m_file_size = header_sectors * sector_size;
+
+        if (!write_all(m_fd, m_header.get(), sizeof(Header), 0) || ftruncate(m_fd, m_file_size) != 0)
+        {
+            ::close(m_fd);
+            throw std::runtime_error(fmt::format("failed to create region file: {}", path.string()));
+        }
+    }
+    else
+    {
+        m_file_size = st.st_size;
+
+        if (pread(m_fd, m_header.get(), sizeof(Header), 0) != sizeof(Header) || m_header->magic != region_magic ||
+            m_header->version != region_version)
+        {
+            ::close(m_fd);
+            throw std::runtime_error(fmt::format("not a region file: {}", path.string()));
+        }
+    }
+
+    map(m_file_size);
+}
+
+RegionFile::~RegionFile()
+{
+    if (m_mapping) munmap(m_mapping, m_mapped_size);
+    if (m_fd >= 0) ::close(m_fd);
+}
+
+std::filesystem::path RegionFile::path_of(const std::filesystem::path& dir, glm::ivec2 region)
+{
+    return dir / fmt::format("r.{}.{}.region", region.x, region.y);
+}
+
+void RegionFile::map(size_t size)
+{
+    if (m_mapping) munmap(m_mapping, m_mapped_size);
+
+    m_mapping     = static_cast<uint8_t*>(mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0));
+    m_mapped_size = size;
+
+    if (m_mapping == MAP_FAILED)
+    {
+        m_mapping     = nullptr;
+        m_mapped_size = 0;
+        throw std::runtime_error("failed to map region file");
+    }
+}
+
+std::span<const uint8_t> RegionFile::read(uint32_t index)
+{
+    auto e = entry(index);
+
+    if (e.offset == 0 || e.offset + size_t(e.size) > m_file_size) return {};
+
+    // the file grew since it was mapped
+    if (e.offset + size_t(e.size) > m_mapped_size) map(m_file_size);
+
+    return {m_mapping + e.offset, e.size};
+}
+
+void RegionFile::write(uint32_t index, std::span<const uint8_t> data)
+{
+    auto e = entry(index);
+
+    // reuse the old sectors if the chunk still fits, otherwise append. space of moved chunks isn't reclaimed
+    uint32_t offset = e.offset;
+    if (offset == 0 || round_to_sectors(data.size()) > round_to_sectors(e.size))
+    {
+        offset      = m_file_size;
+        m_file_size = offset + round_to_sectors(data.size());
+
+        if (ftruncate(m_fd, m_file_size) != 0) throw std::runtime_error("failed to grow region file");
+    }
+
+    // data goes first so the header never points at a partially written chunk, unless it was rewritten in place
+    if (!write_all(m_fd, data.data(), data.size(), offset)) throw std::runtime_error("failed to write chunk to region file");
+
+    m_header->entries[index] = Entry{.offset = offset, .size = (uint32_t)data.size()};
+
+    if (!write_all(m_fd, &m_header->entries[index], sizeof(Entry), offsetof(Header, entries) + index * sizeof(Entry)))
+        throw std::runtime_error("failed to write region file header");
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <filesystem>
+#include <inttypes.h>
+#include <span>
+
+#include <glm/vec2.hpp>
+
+// a region file stores region_size x region_size chunk columns. it starts with a header holding the offset and size of
+// every chunk in the region followed by the chunk data, each chunk aligned to a sector. the file is memory mapped for
+// reads, writes go through pwrite and remap lazily. not thread safe
+class RegionFile
+{
+    RegionFile(const RegionFile&) = delete;
+
+public:
+    static constexpr int32_t region_size   = 32;
+    static constexpr uint32_t sector_size  = 4096;
+    static constexpr uint32_t chunk_count  = region_size * region_size;
+
+    struct Entry
+    {
+        uint32_t offset; // 0 if the chunk isn't stored
+        uint32_t size;
+    };
+
+    // opens or creates the file, throws if that fails or it isn't a region file
+    RegionFile(const std::filesystem::path& path);
+    ~RegionFile();
+
+    static inline glm::ivec2 region_of(glm::ivec2 chunk_pos) { return chunk_pos >> 5; }
+    static inline uint32_t index_of(glm::ivec2 chunk_pos) { return (chunk_pos.x & (region_size - 1)) + (chunk_pos.y & (region_size - 1)) * region_size; }
+    static std::filesystem::path path_of(const std::filesystem::path& dir, glm::ivec2 region);
+
+    inline Entry entry(uint32_t index) const { return m_header->entries[index]; }
+    inline int fd() const { return m_fd; }
+
+    // view of the stored chunk valid until the next write, empty if the chunk isn't stored
+    std::span<const uint8_t> read(uint32_t index);
+    void write(uint32_t index, std::span<const uint8_t> data);
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        Entry entries[chunk_count];
+    };
+
+    static constexpr uint32_t header_sectors = (sizeof(Header) + sector_size - 1) / sector_size;
+
+    void map(size_t size);
+
+    int m_fd = -1;
+    size_t m_file_size   = 0;
+    size_t m_mapped_size = 0;
+    uint8_t* m_mapping   = nullptr;
+
+    // copy of the header on disk, kept in sync on every write
+    std::unique_ptr<Header> m_header;
+};
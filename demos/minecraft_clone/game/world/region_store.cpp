@@ -0,0 +1,397 @@
+#include "region_store.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define MC_HAS_IO_URING 1
+#endif
+
+#include <fmt/core.h>
+
+#include "light_engine.hpp"
+#include "region_file.hpp"
+
+#ifdef MC_HAS_IO_URING
+
+// minimal io_uring over the raw syscalls, only what batched reads need
+class RegionStore::IoUring
+{
+public:
+    struct Read
+    {
+        int fd;
+        uint64_t offset;
+        uint32_t size;
+        uint8_t* buffer;
+        bool ok;
+    };
+
+    IoUring(uint32_t entries)
+    {
+        io_uring_params params = {};
+
+        m_fd = syscall(__NR_io_uring_setup, entries, &params);
+        if (m_fd < 0) throw std::runtime_error("io_uring_setup failed");
+
+        m_sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+
+        m_sq_ring = mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        m_cq_ring = single_mmap ? m_sq_ring : mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        m_sqes    = static_cast<io_uring_sqe*>(mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES));
+        m_sqe_count = params.sq_entries;
+
+        if (m_sq_ring == MAP_FAILED || m_cq_ring == MAP_FAILED || m_sqes == MAP_FAILED)
+        {
+            close(m_fd);
+            throw std::runtime_error("failed to map io_uring rings");
+        }
+
+        auto* sq = static_cast<uint8_t*>(m_sq_ring);
+        auto* cq = static_cast<uint8_t*>(m_cq_ring);
+
+        m_sq_tail  = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+        m_sq_mask  = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+        m_sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+        m_cq_head  = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+        m_cq_tail  = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+        m_cq_mask  = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+        m_cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUring()
+    {
+        munmap(m_sqes, m_sqe_count * sizeof(io_uring_sqe));
+        if (m_cq_ring != m_sq_ring) munmap(m_cq_ring, m_cq_size);
+        munmap(m_sq_ring, m_sq_size);
+        close(m_fd);
+    }
+
+    // submits all reads and waits for them, in groups of at most the ring size
+    void read_all(std::span<Read> reads)
+    {
+        for (size_t first = 0; first < reads.size(); first += m_sqe_count)
+        {
+            size_t count = std::min<size_t>(m_sqe_count, reads.size() - first);
+
+            uint32_t tail = __atomic_load_n(m_sq_tail, __ATOMIC_ACQUIRE);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto& read       = reads[first + i];
+                uint32_t index   = (tail + i) & m_sq_mask;
+                io_uring_sqe& sqe = m_sqes[index];
+
+                memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode    = IORING_OP_READ;
+                sqe.fd        = read.fd;
+                sqe.off       = read.offset;
+                sqe.addr      = reinterpret_cast<uint64_t>(read.buffer);
+                sqe.len       = read.size;
+                sqe.user_data = first + i;
+
+                m_sq_array[index] = index;
+                read.ok           = false;
+            }
+
+            __atomic_store_n(m_sq_tail, tail + count, __ATOMIC_RELEASE);
+
+            size_t completed = 0;
+
+            while (completed < count)
+            {
+                int ret = syscall(__NR_io_uring_enter, m_fd, completed == 0 ? count : 0, count - completed, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (ret < 0 && errno != EINTR) return;
+
+                uint32_t head = __atomic_load_n(m_cq_head, __ATOMIC_RELAXED);
+                uint32_t cq_tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+
+                for (; head != cq_tail; ++head, ++completed)
+                {
+                    auto& cqe = m_cqes[head & m_cq_mask];
+                    auto& read = reads[cqe.user_data];
+
+                    // short reads are left to the caller to retry
+                    read.ok = cqe.res == (int32_t)read.size;
+                }
+
+                __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+            }
+        }
+    }
+
+private:
+    int m_fd;
+
+    size_t m_sq_size, m_cq_size;
+    void* m_sq_ring;
+    void* m_cq_ring;
+    io_uring_sqe* m_sqes;
+    uint32_t m_sqe_count;
+
+    uint32_t* m_sq_tail;
+    uint32_t m_sq_mask;
+    uint32_t* m_sq_array;
+
+    uint32_t* m_cq_head;
+    uint32_t* m_cq_tail;
+    uint32_t m_cq_mask;
+    io_uring_cqe* m_cqes;
+};
+
+#else
+
+class RegionStore::IoUring
+{
+public:
+    struct Read
+    {
+        int fd;
+        uint64_t offset;
+        uint32_t size;
+        uint8_t* buffer;
+        bool ok;
+    };
+
+    IoUring(uint32_t) { throw std::runtime_error("built without io_uring"); }
+
+    void read_all(std::span<Read>) {}
+};
+
+#endif
+
+RegionStore::RegionStore(std::filesystem::path dir)
+    : m_dir(std::move(dir))
+{
+}
+
+RegionStore::~RegionStore()
+{
+    if (m_worker.joinable())
+    {
+        m_requests.push(Request{.type = Request::Type::stop});
+        m_worker.join();
+    }
+}
+
+void RegionStore::init(bool use_io_uring)
+{
+    std::filesystem::create_directories(m_dir);
+
+    if (use_io_uring)
+    {
+        try
+        {
+            m_io_uring = std::make_unique<IoUring>(max_batch_size);
+        }
+        catch (const std::exception& e)
+        {
+            fmt::print("{}, loading regions through mmap\n", e.what());
+        }
+    }
+
+    m_worker = std::jthread([this] { worker_func(); });
+}
+
+void RegionStore::load(std::vector<glm::ivec2> poses)
+{
+    std::vector<Request> requests;
+    requests.reserve(poses.size());
+
+    for (auto pos : poses)
+        requests.push_back(Request{.type = Request::Type::load, .pos = pos});
+
+    m_requests.push(std::move(requests));
+}
+
+void RegionStore::save(glm::ivec2 pos, std::unique_ptr<Chunk> chunk)
+{
+    m_requests.push(Request{.type = Request::Type::save, .pos = pos, .chunk = std::move(chunk)});
+}
+
+RegionStoreStats RegionStore::stats() const
+{
+    return RegionStoreStats{
+        .loaded_chunks  = m_loaded_chunks.load(),
+        .missing_chunks = m_missing_chunks.load(),
+        .saved_chunks   = m_saved_chunks.load(),
+        .bytes_read     = m_bytes_read.load(),
+        .bytes_written  = m_bytes_written.load(),
+    };
+}
+
+void RegionStore::worker_func()
+{
+    std::vector<Request> requests;
+    std::vector<glm::ivec2> loads;
+
+    while (true)
+    {
+        requests.clear();
+        m_requests.fetch_some_blocking(requests, max_batch_size);
+
+        close_unused_regions();
+
+        for (auto& request : requests)
+        {
+            if (request.type == Request::Type::load)
+            {
+                loads.push_back(request.pos);
+                continue;
+            }
+
+            // earlier loads go first to keep the order
+            if (loads.size()) handle_loads(loads);
+            loads.clear();
+
+            if (request.type == Request::Type::stop) return;
+
+            handle_save(request.pos, *request.chunk);
+        }
+
+        if (loads.size()) handle_loads(loads);
+        loads.clear();
+    }
+}
+
+void RegionStore::handle_loads(const std::vector<glm::ivec2>& poses)
+{
+    std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> loaded;
+    std::vector<glm::ivec2> missing;
+
+    std::vector<IoUring::Read> reads;
+    std::vector<glm::ivec2> read_poses;
+    std::vector<std::unique_ptr<uint8_t[]>> buffers;
+
+    for (auto pos : poses)
+    {
+        RegionFile* file = region(RegionFile::region_of(pos), false);
+        uint32_t index   = RegionFile::index_of(pos);
+
+        if (file == nullptr || file->entry(index).offset == 0)
+        {
+            missing.push_back(pos);
+            continue;
+        }
+
+        if (m_io_uring)
+        {
+            auto entry = file->entry(index);
+            buffers.push_back(std::make_unique<uint8_t[]>(entry.size));
+            reads.push_back(IoUring::Read{.fd = file->fd(), .offset = entry.offset, .size = entry.size, .buffer = buffers.back().get()});
+            read_poses.push_back(pos);
+            continue;
+        }
+
+        auto data = file->read(index);
+        m_bytes_read += data.size();
+
+        if (auto chunk = Chunk::deserialize(data.data(), data.size()))
+            loaded.emplace_back(pos, std::move(chunk));
+        else
+            missing.push_back(pos);
+    }
+
+    if (reads.size())
+    {
+        m_io_uring->read_all(reads);
+
+        for (size_t i = 0; i < reads.size(); ++i)
+        {
+            std::unique_ptr<Chunk> chunk;
+
+            if (reads[i].ok)
+            {
+                m_bytes_read += reads[i].size;
+                chunk = Chunk::deserialize(reads[i].buffer, reads[i].size);
+            }
+            else if (auto* file = region(RegionFile::region_of(read_poses[i]), false))
+            {
+                auto data = file->read(RegionFile::index_of(read_poses[i]));
+                m_bytes_read += data.size();
+                chunk = Chunk::deserialize(data.data(), data.size());
+            }
+
+            if (chunk)
+                loaded.emplace_back(read_poses[i], std::move(chunk));
+            else
+                missing.push_back(read_poses[i]);
+        }
+    }
+
+    // light isn't stored
+    for (auto& [pos, chunk] : loaded)
+        LightEngine::light_chunk(chunk.get());
+
+    m_loaded_chunks += loaded.size();
+    m_missing_chunks += missing.size();
+
+    if (loaded.size()) out_chunks.push(std::move(loaded));
+    if (missing.size()) missing_chunks.push(std::move(missing));
+}
+
+void RegionStore::handle_save(glm::ivec2 pos, const Chunk& chunk)
+{
+    m_serialize_buffer.clear();
+    chunk.serialize(m_serialize_buffer);
+
+    try
+    {
+        if (auto* file = region(RegionFile::region_of(pos), true))
+        {
+            file->write(RegionFile::index_of(pos), m_serialize_buffer);
+
+            m_saved_chunks++;
+            m_bytes_written += m_serialize_buffer.size();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fmt::print("failed to save chunk ({}, {}): {}\n", pos.x, pos.y, e.what());
+    }
+}
+
+RegionFile* RegionStore::region(glm::ivec2 region_pos, bool create)
+{
+    auto& region    = m_regions[region_pos];
+    region.last_use = m_use_counter++;
+
+    if (region.file) return region.file.get();
+
+    auto path = RegionFile::path_of(m_dir, region_pos);
+    if (!create && !std::filesystem::exists(path)) return nullptr;
+
+    try
+    {
+        region.file = std::make_unique<RegionFile>(path);
+    }
+    catch (const std::exception& e)
+    {
+        fmt::print("{}\n", e.what());
+    }
+
+    return region.file.get();
+}
+
+void RegionStore::close_unused_regions()
+{
+    while (m_regions.size() > max_open_regions)
+    {
+        auto oldest = m_regions.begin();
+
+        for (auto it = m_regions.begin(); it != m_regions.end(); ++it)
+            if (it->second.last_use < oldest->second.last_use) oldest = it;
+
+        m_regions.erase(oldest);
+    }
+}
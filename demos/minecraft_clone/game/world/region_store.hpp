@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/vec2.hpp>
+
+#include "../../util/concurent_queue.hpp"
+#include "chunk.hpp"
+
+class RegionFile;
+
+struct RegionStoreStats
+{
+    size_t loaded_chunks;
+    size_t missing_chunks;
+    size_t saved_chunks;
+    size_t bytes_read;
+    size_t bytes_written;
+};
+
+// loads and saves chunks in region files under a directory on its own thread. chunks are requested like they are from
+// WorldGen and stored ones come back through out_chunks, positions that aren't stored come back through missing_chunks
+// so they can be generated instead. requests are handled in order, so a load after a save of the same chunk sees it
+class RegionStore
+{
+    RegionStore(const RegionStore&) = delete;
+
+public:
+    RegionStore(std::filesystem::path dir);
+    // waits for queued saves to be written
+    ~RegionStore();
+
+    // with use_io_uring, batches of loads are read with io_uring instead of through the memory mapped files. falls back
+    // to the mappings if io_uring isn't available
+    void init(bool use_io_uring = false);
+
+    void load(std::vector<glm::ivec2> poses);
+    void save(glm::ivec2 pos, std::unique_ptr<Chunk> chunk);
+
+    RegionStoreStats stats() const;
+
+public:
+    ConcurentQueue<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> out_chunks;
+    ConcurentQueue<glm::ivec2> missing_chunks;
+
+private:
+    class IoUring;
+
+    struct Request
+    {
+        enum class Type
+        {
+            load,
+            save,
+            stop,
+        } type;
+
+        glm::ivec2 pos;
+        std::unique_ptr<Chunk> chunk;
+    };
+
+    struct OpenRegion
+    {
+        std::unique_ptr<RegionFile> file; // null if the region has no file yet
+        uint64_t last_use;
+    };
+
+    void worker_func();
+    void handle_loads(const std::vector<glm::ivec2>& poses);
+    void handle_save(glm::ivec2 pos, const Chunk& chunk);
+
+    RegionFile* region(glm::ivec2 region_pos, bool create);
+    void close_unused_regions();
+
+    static constexpr uint32_t max_batch_size   = 64;
+    static constexpr size_t max_open_regions   = 16;
+
+    const std::filesystem::path m_dir;
+
+    ConcurentQueue<Request> m_requests;
+
+    // only used by the worker
+    std::unordered_map<glm::ivec2, OpenRegion> m_regions;
+    std::unique_ptr<IoUring> m_io_uring;
+    std::vector<uint8_t> m_serialize_buffer;
+    uint64_t m_use_counter = 0;
+
+    std::atomic<size_t> m_loaded_chunks  = 0;
+    std::atomic<size_t> m_missing_chunks = 0;
+    std::atomic<size_t> m_saved_chunks   = 0;
+    std::atomic<size_t> m_bytes_read     = 0;
+    std::atomic<size_t> m_bytes_written  = 0;
+
+    std::jthread m_worker;
+};
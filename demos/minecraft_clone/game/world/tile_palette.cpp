@@ -0,0 +1,296 @@
+#include "tile_palette.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+// smallest of 1/2/4/8 bits that can index entry_count palette entries, as log2 of the bit count
+uint32_t bits_log2_for(uint32_t entry_count)
+{
+    uint32_t bits_log2 = 0;
+    while (bits_log2 < 3 && (1u << (1u << bits_log2)) < entry_count)
+        bits_log2++;
+
+    return bits_log2;
+}
+
+uint32_t word_count(uint32_t tile_count, uint32_t bits_log2)
+{
+    return (tile_count << bits_log2) / 64;
+}
+
+} // namespace
+
+PalettedTiles::PalettedTiles(uint32_t tile_count, Tile fill)
+    : m_tile_count(tile_count)
+{
+    assert(tile_count % word_bits == 0);
+
+    m_words = std::make_unique<uint64_t[]>(word_count(tile_count, m_bits_log2));
+    m_palette.push_back(fill);
+    m_ref_counts.push_back(tile_count);
+    m_live_entries = 1;
+}
+
+PalettedTiles::PalettedTiles(const PalettedTiles& o)
+    : m_palette(o.m_palette), m_ref_counts(o.m_ref_counts), m_tile_count(o.m_tile_count), m_live_entries(o.m_live_entries),
+      m_bits_log2(o.m_bits_log2), m_bits(o.m_bits), m_mask(o.m_mask)
+{
+    uint32_t words = word_count(m_tile_count, m_bits_log2);
+
+    m_words = std::make_unique<uint64_t[]>(words);
+    memcpy(m_words.get(), o.m_words.get(), words * sizeof(uint64_t));
+}
+
+std::unique_ptr<PalettedTiles> PalettedTiles::from_tiles(const Tile* tiles, uint32_t tile_count)
+{
+    std::array<uint32_t, 256> counts = {};
+    for (uint32_t i = 0; i < tile_count; ++i)
+        counts[(uint8_t)tiles[i]]++;
+
+    auto paletted = std::make_unique<PalettedTiles>(tile_count);
+    paletted->m_palette.clear();
+    paletted->m_ref_counts.clear();
+
+    std::array<uint8_t, 256> lookup;
+    for (uint32_t t = 0; t < 256; ++t)
+    {
+        if (counts[t] == 0) continue;
+
+        lookup[t] = paletted->m_palette.size();
+        paletted->m_palette.push_back((Tile)t);
+        paletted->m_ref_counts.push_back(counts[t]);
+    }
+
+    paletted->m_live_entries = paletted->m_palette.size();
+    paletted->m_bits_log2    = bits_log2_for(paletted->m_live_entries);
+    paletted->m_bits         = 1u << paletted->m_bits_log2;
+    paletted->m_mask         = (1u << paletted->m_bits) - 1;
+    paletted->m_words        = std::make_unique<uint64_t[]>(word_count(tile_count, paletted->m_bits_log2));
+
+    uint32_t tiles_per_word = word_bits >> paletted->m_bits_log2;
+
+    for (uint32_t w = 0; w < word_count(tile_count, paletted->m_bits_log2); ++w)
+    {
+        uint64_t word = 0;
+
+        for (uint32_t i = 0; i < tiles_per_word; ++i)
+            word |= uint64_t(lookup[(uint8_t)*(tiles++)]) << (i << paletted->m_bits_log2);
+
+        paletted->m_words[w] = word;
+    }
+
+    return paletted;
+}
+
+void PalettedTiles::set(uint32_t index, Tile t)
+{
+    assert(index < m_tile_count);
+
+    if (get(index) == t) return;
+
+    // may widen the indices, so the old entry is read afterwards
+    uint32_t new_entry = find_or_add_entry(t);
+    uint32_t old_entry = read_index(index);
+
+    write_index(index, new_entry);
+    m_ref_counts[new_entry]++;
+
+    if (--m_ref_counts[old_entry] == 0)
+    {
+        m_live_entries--;
+
+        // only narrow once half of the smaller palette would still be free, so edits around a boundary don't repack every time
+        if (m_bits_log2 > 0 && m_live_entries <= (1u << (m_bits >> 1)) / 2) repack(m_bits_log2 - 1);
+    }
+}
+
+uint32_t PalettedTiles::find_or_add_entry(Tile t)
+{
+    uint32_t free_entry = UINT32_MAX;
+
+    for (uint32_t i = 0; i < m_palette.size(); ++i)
+    {
+        if (m_palette[i] == t)
+        {
+            if (m_ref_counts[i] == 0) m_live_entries++;
+            return i;
+        }
+
+        if (m_ref_counts[i] == 0 && free_entry == UINT32_MAX) free_entry = i;
+    }
+
+    m_live_entries++;
+
+    if (free_entry != UINT32_MAX)
+    {
+        m_palette[free_entry] = t;
+        return free_entry;
+    }
+
+    // palette is full and every entry is in use
+    if (m_palette.size() >= (1u << m_bits)) repack(m_bits_log2 + 1);
+
+    m_palette.push_back(t);
+    m_ref_counts.push_back(0);
+
+    return m_palette.size() - 1;
+}
+
+void PalettedTiles::repack(uint32_t bits_log2)
+{
+    assert(bits_log2 <= 3);
+
+    std::array<uint8_t, 256> remap;
+    std::vector<Tile> palette;
+    std::vector<uint32_t> ref_counts;
+
+    for (uint32_t i = 0; i < m_palette.size(); ++i)
+    {
+        if (m_ref_counts[i] == 0) continue;
+
+        remap[i] = palette.size();
+        palette.push_back(m_palette[i]);
+        ref_counts.push_back(m_ref_counts[i]);
+    }
+
+    assert(palette.size() <= (1u << (1u << bits_log2)));
+
+    auto words = std::make_unique<uint64_t[]>(word_count(m_tile_count, bits_log2));
+
+    for (uint32_t i = 0; i < m_tile_count; ++i)
+    {
+        uint32_t bit = i << bits_log2;
+        words[bit / word_bits] |= uint64_t(remap[read_index(i)]) << (bit % word_bits);
+    }
+
+    m_words      = std::move(words);
+    m_palette    = std::move(palette);
+    m_ref_counts = std::move(ref_counts);
+    m_bits_log2  = bits_log2;
+    m_bits       = 1u << bits_log2;
+    m_mask       = (1u << m_bits) - 1;
+}
+
+void PalettedTiles::shrink_to_fit()
+{
+    uint32_t bits_log2 = bits_log2_for(m_live_entries);
+
+    if (bits_log2 != m_bits_log2 || m_live_entries != m_palette.size()) repack(bits_log2);
+
+    m_palette.shrink_to_fit();
+    m_ref_counts.shrink_to_fit();
+}
+
+void PalettedTiles::unpack(Tile* out) const
+{
+    // indices are decoded a byte at a time (words are little endian) through a table of the tiles each byte expands to
+    const uint8_t* bytes    = reinterpret_cast<const uint8_t*>(m_words.get());
+    uint32_t tiles_per_byte = 8 >> m_bits_log2;
+    uint32_t byte_count     = m_tile_count / tiles_per_byte;
+
+    if (tiles_per_byte == 1)
+    {
+        for (uint32_t i = 0; i < byte_count; ++i)
+            out[i] = m_palette[bytes[i]];
+
+        return;
+    }
+
+    std::array<uint64_t, 256> byte_to_tiles;
+    for (uint32_t b = 0; b < 256; ++b)
+    {
+        uint64_t tiles = 0;
+
+        for (uint32_t i = 0; i < tiles_per_byte; ++i)
+        {
+            uint32_t entry = (b >> (i * m_bits)) & m_mask;
+            tiles |= uint64_t(entry < m_palette.size() ? m_palette[entry] : Tile::air) << (i * 8);
+        }
+
+        byte_to_tiles[b] = tiles;
+    }
+
+    for (uint32_t i = 0; i < byte_count; ++i)
+    {
+        memcpy(out, &byte_to_tiles[bytes[i]], tiles_per_byte);
+        out += tiles_per_byte;
+    }
+}
+
+void PalettedTiles::serialize(std::vector<uint8_t>& out) const
+{
+    // reference counts aren't stored, they are counted again on load which also validates the indices
+    uint32_t words = word_count(m_tile_count, m_bits_log2);
+
+    out.push_back(m_bits_log2);
+    out.push_back(m_palette.size() - 1);
+    for (Tile t : m_palette)
+        out.push_back((uint8_t)t);
+
+    size_t offset = out.size();
+    out.resize(offset + words * sizeof(uint64_t));
+    memcpy(out.data() + offset, m_words.get(), words * sizeof(uint64_t));
+}
+
+std::unique_ptr<PalettedTiles> PalettedTiles::deserialize(const uint8_t*& data, const uint8_t* end, uint32_t tile_count)
+{
+    if (end - data < 2) return nullptr;
+
+    uint32_t bits_log2     = data[0];
+    uint32_t palette_count = data[1] + 1;
+
+    if (bits_log2 > 3 || palette_count > (1u << (1u << bits_log2))) return nullptr;
+
+    uint32_t words = word_count(tile_count, bits_log2);
+    if (size_t(end - data) < 2 + palette_count + words * sizeof(uint64_t)) return nullptr;
+
+    auto paletted = std::make_unique<PalettedTiles>(tile_count);
+    paletted->m_palette.clear();
+
+    for (uint32_t i = 0; i < palette_count; ++i)
+    {
+        if (data[2 + i] >= tile_type_count) return nullptr;
+        paletted->m_palette.push_back((Tile)data[2 + i]);
+    }
+
+    paletted->m_bits_log2 = bits_log2;
+    paletted->m_bits      = 1u << bits_log2;
+    paletted->m_mask      = (1u << paletted->m_bits) - 1;
+    paletted->m_words     = std::make_unique<uint64_t[]>(words);
+    memcpy(paletted->m_words.get(), data + 2 + palette_count, words * sizeof(uint64_t));
+
+    // histogram of the index bytes first, then every byte value adds to each index packed into it
+    std::array<uint32_t, 256> byte_counts = {};
+    auto* bytes = reinterpret_cast<const uint8_t*>(paletted->m_words.get());
+    for (uint32_t i = 0; i < words * sizeof(uint64_t); ++i)
+        byte_counts[bytes[i]]++;
+
+    std::array<uint32_t, 256> counts = {};
+    for (uint32_t b = 0; b < 256; ++b)
+    {
+        if (byte_counts[b] == 0) continue;
+
+        for (uint32_t i = 0; i < (8u >> bits_log2); ++i)
+            counts[(b >> (i * paletted->m_bits)) & paletted->m_mask] += byte_counts[b];
+    }
+
+    for (uint32_t i = palette_count; i < 256; ++i)
+        if (counts[i] != 0) return nullptr;
+
+    paletted->m_ref_counts.assign(counts.begin(), counts.begin() + palette_count);
+    paletted->m_live_entries = std::count_if(counts.begin(), counts.end(), [](uint32_t c) { return c != 0; });
+
+    data += 2 + palette_count + words * sizeof(uint64_t);
+
+    return paletted;
+}
+
+size_t PalettedTiles::memory_usage() const
+{
+    return sizeof(*this) + word_count(m_tile_count, m_bits_log2) * sizeof(uint64_t) +
+           m_palette.capacity() * sizeof(Tile) + m_ref_counts.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <inttypes.h>
+#include <memory>
+#include <vector>
+
+#include "tiles.hpp"
+
+// compressed storage for a vertical chunk. tiles are stored as 1/2/4/8 bit indices into a palette.
+// bit width grows when the palette is full and shrinks back once enough palette entries are unused.
+class PalettedTiles
+{
+public:
+    PalettedTiles(uint32_t tile_count, Tile fill = Tile::air);
+    PalettedTiles(const PalettedTiles& o);
+
+    static std::unique_ptr<PalettedTiles> from_tiles(const Tile* tiles, uint32_t tile_count);
+
+    inline Tile get(uint32_t index) const { return m_palette[read_index(index)]; }
+    void set(uint32_t index, Tile t);
+
+    // writes all tiles into a flat array of tile_count() tiles
+    void unpack(Tile* out) const;
+
+    // repacks with the smallest bit width that fits the used palette entries
+    void shrink_to_fit();
+
+    // appends the bit width, palette and packed indices to out
+    void serialize(std::vector<uint8_t>& out) const;
+    // reads what serialize wrote and advances data past it. nullptr if the data is truncated or invalid
+    static std::unique_ptr<PalettedTiles> deserialize(const uint8_t*& data, const uint8_t* end, uint32_t tile_count);
+
+    inline uint32_t tile_count() const { return m_tile_count; }
+    inline uint32_t bits_per_tile() const { return m_bits; }
+    inline uint32_t palette_size() const { return m_live_entries; }
+    size_t memory_usage() const;
+
+private:
+    static constexpr uint32_t word_bits = 64;
+
+    inline uint32_t read_index(uint32_t index) const
+    {
+        uint32_t bit = index << m_bits_log2;
+        return (m_words[bit / word_bits] >> (bit % word_bits)) & m_mask;
+    }
+
+    inline void write_index(uint32_t index, uint32_t palette_index)
+    {
+        uint32_t bit   = index << m_bits_log2;
+        uint64_t& word = m_words[bit / word_bits];
+
+        word = (word & ~(uint64_t(m_mask) << (bit % word_bits))) | (uint64_t(palette_index) << (bit % word_bits));
+    }
+
+    uint32_t find_or_add_entry(Tile t);
+    void repack(uint32_t bits_log2);
+
+private:
+    std::unique_ptr<uint64_t[]> m_words;
+    std::vector<Tile> m_palette;
+    std::vector<uint32_t> m_ref_counts;
+
+    uint32_t m_tile_count;
+    uint32_t m_live_entries = 0;
+    uint32_t m_bits_log2    = 0;
+    uint32_t m_bits         = 1;
+    uint32_t m_mask         = 1;
+};
@@ -12,9 +12,15 @@ enum class Tile : uint8_t
     glass,
     wood_plank,
     leaf,
-    snow
+    snow,
+    lamp
 };
 
+constexpr uint32_t tile_type_count = (uint32_t)Tile::lamp + 1;
+
+// solid tiles hide the faces of the tiles next to them
+constexpr bool is_solid(Tile t) { return t != Tile::air; }
+
 enum class TileFacing
 {
     xp,
@@ -34,4 +40,7 @@ enum class Axis
 
 typedef uint8_t TextureID;
 
-const TextureID tile_texture_table[] = {0,1,2,3,4,5,6,7,8};
\ No newline at end of file
+const TextureID tile_texture_table[] = {0,1,2,3,4,5,6,7,8,9};
+
+// block light level given off by each tile
+const uint8_t tile_light_emission[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 15};
\ No newline at end of file
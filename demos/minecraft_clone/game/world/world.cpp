@@ -1,23 +1,95 @@
 #include "world.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
 #include <fmt/core.h>
 #include <fmt/ranges.h>
 
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
 #include "../player.hpp"
 
+#include "light_engine.hpp"
+#include "region_store.hpp"
 #include "world_gen.hpp"
 
+namespace
+{
+constexpr uint64_t world_seed = 0xfada23;
+
+// calls func(glm::ivec2 cpos, glm::ivec3 in_min, glm::ivec3 in_max) with the part of the box in each chunk, the corners
+// inclusive and in tiles of the chunk with column y. the parts above and below the world are cut off
+template <class Func>
+void for_each_chunk_in_box(glm::ivec3 min, glm::ivec3 max, Func&& func)
+{
+    constexpr int32_t size = Chunk::chunk_size;
+
+    int32_t y_min = std::max(Chunk::real_y_to_column_y(min.y), 0);
+    int32_t y_max = std::min(Chunk::real_y_to_column_y(max.y), Chunk::height - 1);
+
+    if (min.x > max.x || min.z > max.z || y_min > y_max) return;
+
+    glm::ivec3 chunk_min = Chunk::real_pos_to_chunk_pos(min), chunk_max = Chunk::real_pos_to_chunk_pos(max);
+
+    for (int32_t cz = chunk_min.z; cz <= chunk_max.z; ++cz)
+    {
+        for (int32_t cx = chunk_min.x; cx <= chunk_max.x; ++cx)
+        {
+            glm::ivec3 in_min = {std::max(min.x - cx * size, 0), y_min, std::max(min.z - cz * size, 0)};
+            glm::ivec3 in_max = {std::min(max.x - cx * size, size - 1), y_max, std::min(max.z - cz * size, size - 1)};
+
+            func(glm::ivec2(cx, cz), in_min, in_max);
+        }
+    }
+}
+
+// sets the tiles of the run to tile, returns how many were different
+size_t fill_run(Tile* run, int32_t length, Tile tile)
+{
+    size_t same = 0;
+    for (int32_t i = 0; i < length; ++i)
+        same += run[i] == tile;
+
+    memset(run, (int)tile, length);
+
+    return length - same;
+}
+
+} // namespace
+
 World::World()
 {
-    m_world_gen = std::make_unique<WorldGen>(0xfada23);
+    m_world_gen = std::make_unique<WorldGen>(world_seed);
     m_world_gen->init(6);
+
+    m_region_store = std::make_unique<RegionStore>(fmt::format("saves/{:x}", world_seed));
+    m_region_store->init();
+
+    m_light_engine = std::make_unique<LightEngine>();
 }
 World::~World()
 {
+    m_world_gen    = nullptr;
+    m_light_engine = nullptr;
+
+    std::vector<glm::ivec2> poses;
+    m_chunks.for_each([&](glm::ivec2 pos, Chunk*) { poses.push_back(pos); });
+
+    for (auto pos : poses)
+        remove_chunk(pos);
+
+    // writes the chunks queued above before returning
+    m_region_store = nullptr;
 }
 
 void World::set_chunk(std::unique_ptr<Chunk> chunk, glm::ivec2 pos)
 {
+    m_light_engine->wait();
+
     chunk->m_pos_x = pos.x;
     chunk->m_pos_z = pos.y;
 
@@ -27,10 +99,10 @@ void World::set_chunk(std::unique_ptr<Chunk> chunk, glm::ivec2 pos)
     }
 
     auto neighbors = chunk->m_neighbor = {
-        .xp = const_cast<Chunk*>(get_chunk(pos + glm::ivec2(1, 0))),
-        .xn = const_cast<Chunk*>(get_chunk(pos + glm::ivec2(-1, 0))),
-        .zp = const_cast<Chunk*>(get_chunk(pos + glm::ivec2(0, 1))),
-        .zn = const_cast<Chunk*>(get_chunk(pos + glm::ivec2(0, -1))),
+        .xp = m_chunks.get(pos + glm::ivec2(1, 0)),
+        .xn = m_chunks.get(pos + glm::ivec2(-1, 0)),
+        .zp = m_chunks.get(pos + glm::ivec2(0, 1)),
+        .zn = m_chunks.get(pos + glm::ivec2(0, -1)),
     };
 
     if (neighbors.xp) neighbors.xp->m_neighbor.xn = chunk.get();
@@ -38,52 +110,494 @@ void World::set_chunk(std::unique_ptr<Chunk> chunk, glm::ivec2 pos)
     if (neighbors.zp) neighbors.zp->m_neighbor.zn = chunk.get();
     if (neighbors.zn) neighbors.zn->m_neighbor.zp = chunk.get();
 
-    m_updated_chunks.emplace(chunk.get());
+    mark_updated(chunk.get(), Chunk::all_vertical_chunks);
+    m_light_engine->add_chunk(chunk.get());
 
-    m_chunks[pos] = std::move(chunk);
+    m_chunks.insert(pos, std::move(chunk));
 }
 
 const Chunk* World::get_chunk(glm::ivec2 pos) const
 {
-    if (auto it = m_chunks.find(pos); it != m_chunks.end())
+    return m_chunks.get(pos);
+}
+
+bool World::set_block(const glm::ivec3& pos, Tile tile)
+{
+    BlockEdit edit{pos, tile};
+    return set_blocks({&edit, 1}) == 1;
+}
+
+size_t World::set_blocks(std::span<const BlockEdit> edits)
+{
+    size_t applied = 0;
+
+    // edits are usually grouped by chunk, so the last lookup is reused
+    Chunk* chunk           = nullptr;
+    glm::ivec2 chunk_pos   = {};
+    bool chunk_pos_checked = false;
+
+    m_light_engine->wait();
+
+    for (auto& edit : edits)
     {
-        return it->second.get();
+        int32_t y = Chunk::real_y_to_column_y(edit.pos.y);
+        if (y < 0 || y >= Chunk::height) continue;
+
+        glm::ivec2 cpos = Chunk::real_pos_to_chunk_pos(glm::ivec2(edit.pos.x, edit.pos.z));
+
+        if (!chunk_pos_checked || cpos != chunk_pos)
+        {
+            chunk             = m_chunks.get(cpos);
+            chunk_pos         = cpos;
+            chunk_pos_checked = true;
+        }
+
+        if (chunk == nullptr || !chunk->is_vertical_chunk_loaded(y / Chunk::chunk_size)) continue;
+
+        glm::ivec3 in_pos = glm::ivec3(edit.pos.x & (Chunk::chunk_size - 1), y, edit.pos.z & (Chunk::chunk_size - 1));
+
+        if (chunk->get_block(in_pos.x, in_pos.y, in_pos.z) != edit.tile)
+        {
+            chunk->set_block(edit.tile, in_pos.x, in_pos.y, in_pos.z);
+            chunk->m_unsaved = true;
+            mark_edited(chunk, in_pos, in_pos);
+            m_light_engine->block_changed(chunk, in_pos);
+        }
+
+        applied++;
     }
 
-    return nullptr;
+    return applied;
 }
 
-bool World::set_block(const glm::ivec3& pos, Tile tile)
+void World::mark_updated(const Chunk* chunk, Chunk::VerticalChunkMask mask)
+{
+    m_updated_chunks[chunk] |= mask;
+}
+
+void World::mark_edited(Chunk* chunk, glm::ivec3 in_min, glm::ivec3 in_max)
+{
+    constexpr int32_t last = Chunk::chunk_size - 1;
+
+    uint32_t v_min = in_min.y / Chunk::chunk_size;
+    uint32_t v_max = in_max.y / Chunk::chunk_size;
+
+    // the vertical chunks from v_min to v_max
+    Chunk::VerticalChunkMask edited = (Chunk::all_vertical_chunks >> (Chunk::vertical_chunk_count - 1 - v_max)) &
+                                      (Chunk::all_vertical_chunks << v_min);
+    Chunk::VerticalChunkMask mask   = edited;
+
+    if (in_min.y % Chunk::chunk_size == 0 && v_min > 0) mask |= edited >> 1;
+    if (in_max.y % Chunk::chunk_size == last && v_max + 1 < Chunk::vertical_chunk_count) mask |= edited << 1;
+
+    mark_updated(chunk, mask);
+
+    auto& neighbors = chunk->m_neighbor;
+
+    if (in_max.x == last && neighbors.xp) mark_updated(neighbors.xp, edited);
+    if (in_min.x == 0 && neighbors.xn) mark_updated(neighbors.xn, edited);
+    if (in_max.z == last && neighbors.zp) mark_updated(neighbors.zp, edited);
+    if (in_min.z == 0 && neighbors.zn) mark_updated(neighbors.zn, edited);
+}
+
+template <class KeepsUniform, class WriteRun>
+size_t World::edit_box(glm::ivec3 min, glm::ivec3 max, std::optional<Tile> fill, KeepsUniform&& keeps_uniform, WriteRun&& write_run)
+{
+    constexpr int32_t size = Chunk::chunk_size;
+
+    size_t changed = 0;
+
+    m_light_engine->wait();
+
+    for_each_chunk_in_box(min, max, [&](glm::ivec2 cpos, glm::ivec3 in_min, glm::ivec3 in_max) {
+        Chunk* chunk = m_chunks.get(cpos);
+        if (chunk == nullptr) return;
+
+        // the part of the box in the vertical chunk
+        auto vertical_box = [&](uint32_t v) {
+            return std::pair(glm::ivec3(in_min.x, std::max<int32_t>(in_min.y, v * size), in_min.z),
+                glm::ivec3(in_max.x, std::min<int32_t>(in_max.y, v * size + size - 1), in_max.z));
+        };
+
+        Chunk::VerticalChunkMask written = 0, replaced = 0, edited = 0;
+
+        for (uint32_t v = in_min.y / size; v <= in_max.y / size; ++v)
+        {
+            if (!chunk->is_vertical_chunk_loaded(v)) continue;
+
+            auto uniform = chunk->get_uniform_tile(v);
+            if (uniform && keeps_uniform(*uniform)) continue;
+
+            auto [box_min, box_max] = vertical_box(v);
+            size_t box_changed      = 0;
+
+            if (fill && box_min == glm::ivec3(0, v * size, 0) && box_max == glm::ivec3(size - 1, v * size + size - 1, size - 1))
+            {
+                thread_local Tile scratch[Chunk::chunk_volume];
+
+                if (const Tile* tiles = chunk->read_tile_array(v, scratch))
+                {
+                    for (int32_t i = 0; i < Chunk::chunk_volume; ++i)
+                        box_changed += tiles[i] != *fill;
+                }
+                else
+                {
+                    box_changed = *fill != Tile::air ? Chunk::chunk_volume : 0;
+                }
+
+                // the whole vertical chunk is a single tile again and keeps no storage
+                chunk->set_vertical_chunk_uniform(*fill, v);
+                replaced |= Chunk::VerticalChunkMask(1) << v;
+            }
+            else
+            {
+                Tile* tiles = chunk->get_tile_array(v);
+                if (tiles == nullptr)
+                {
+                    auto air = Chunk::allocate_tile_array();
+                    memset(air.get(), (int)Tile::air, Chunk::chunk_volume);
+
+                    chunk->set_vertical_chunk(std::move(air), v);
+                    tiles = chunk->get_tile_array(v);
+                }
+
+                for (int32_t y = box_min.y; y <= box_max.y; ++y)
+                {
+                    for (int32_t z = box_min.z; z <= box_max.z; ++z)
+                    {
+                        Tile* run      = tiles + box_min.x + z * size + (y % size) * Chunk::chunk_surface_area;
+                        glm::ivec3 pos = {cpos.x * size + box_min.x, Chunk::column_y_to_real_y(y), cpos.y * size + z};
+
+                        box_changed += write_run(run, pos, box_max.x - box_min.x + 1);
+                    }
+                }
+
+                written |= Chunk::VerticalChunkMask(1) << v;
+            }
+
+            if (box_changed) edited |= Chunk::VerticalChunkMask(1) << v;
+            changed += box_changed;
+        }
+
+        // a replaced vertical chunk leaves the heightmap stale even when none of its tiles changed
+        if ((written | replaced | edited) == 0) return;
+
+        chunk->update_occupancy();
+
+        for (auto mask = edited; mask; mask &= mask - 1)
+        {
+            auto [box_min, box_max] = vertical_box(std::countr_zero(mask));
+
+            mark_edited(chunk, box_min, box_max);
+            m_light_engine->box_changed(chunk, box_min, box_max);
+        }
+
+        // the runs were written to flat tiles
+        for (auto mask = written; mask; mask &= mask - 1)
+            chunk->compress_vertical_chunk(std::countr_zero(mask));
+
+        if (edited) chunk->m_unsaved = true;
+    });
+
+    return changed;
+}
+
+size_t World::fill_box(glm::ivec3 min, glm::ivec3 max, Tile tile)
 {
-    if (auto c = const_cast<Chunk*>(get_chunk(glm::ivec2(pos.x, pos.z) >> 5)))
+    return edit_box(
+        min, max, tile, [&](Tile uniform) { return uniform == tile; },
+        [&](Tile* run, glm::ivec3, int32_t length) { return fill_run(run, length, tile); });
+}
+
+size_t World::fill_sphere(glm::ivec3 center, int32_t radius, Tile tile)
+{
+    return edit_box(
+        center - radius, center + radius, std::nullopt, [&](Tile uniform) { return uniform == tile; },
+        [&](Tile* run, glm::ivec3 pos, int32_t length) -> size_t {
+            int32_t left = radius * radius - (pos.y - center.y) * (pos.y - center.y) - (pos.z - center.z) * (pos.z - center.z);
+            if (left < 0) return 0;
+
+            // the widest dx with dx * dx <= left
+            auto dx = (int32_t)std::sqrt((float)left);
+            while (dx * dx > left)
+                dx--;
+            while ((dx + 1) * (dx + 1) <= left)
+                dx++;
+
+            int32_t beg = std::max(center.x - dx, pos.x);
+            int32_t end = std::min(center.x + dx + 1, pos.x + length);
+
+            return beg < end ? fill_run(run + (beg - pos.x), end - beg, tile) : 0;
+        });
+}
+
+size_t World::replace_in_box(glm::ivec3 min, glm::ivec3 max, Tile from, Tile to)
+{
+    if (from == to) return 0;
+
+    return edit_box(
+        min, max, std::nullopt, [&](Tile uniform) { return uniform != from; },
+        [&](Tile* run, glm::ivec3, int32_t length) {
+            size_t changed = 0;
+            for (int32_t i = 0; i < length; ++i)
+            {
+                bool match = run[i] == from;
+                changed += match;
+                run[i] = match ? to : run[i];
+            }
+
+            return changed;
+        });
+}
+
+BlockRegion World::copy_region(glm::ivec3 min, glm::ivec3 max) const
+{
+    constexpr int32_t size = Chunk::chunk_size;
+
+    BlockRegion region;
+    region.size = glm::max(max - min + 1, glm::ivec3(0));
+    region.tiles.assign((size_t)region.size.x * region.size.y * region.size.z, Tile::air);
+
+    for_each_chunk_in_box(min, max, [&](glm::ivec2 cpos, glm::ivec3 in_min, glm::ivec3 in_max) {
+        const Chunk* chunk = m_chunks.get(cpos);
+        if (chunk == nullptr) return;
+
+        thread_local Tile scratch[Chunk::chunk_volume];
+
+        for (uint32_t v = in_min.y / size; v <= in_max.y / size; ++v)
+        {
+            const Tile* tiles = chunk->read_tile_array(v, scratch);
+            if (tiles == nullptr) continue;
+
+            int32_t y_beg = std::max<int32_t>(in_min.y, v * size), y_end = std::min<int32_t>(in_max.y, v * size + size - 1);
+
+            for (int32_t y = y_beg; y <= y_end; ++y)
+            {
+                for (int32_t z = in_min.z; z <= in_max.z; ++z)
+                {
+                    glm::ivec3 pos = {cpos.x * size + in_min.x, Chunk::column_y_to_real_y(y), cpos.y * size + z};
+
+                    memcpy(&region.tiles[region.index(pos - min)], tiles + in_min.x + z * size + (y % size) * Chunk::chunk_surface_area,
+                        in_max.x - in_min.x + 1);
+                }
+            }
+        }
+    });
+
+    return region;
+}
+
+size_t World::paste_region(const BlockRegion& region, glm::ivec3 min)
+{
+    if (region.tiles.empty()) return 0;
+
+    return edit_box(
+        min, min + region.size - 1, std::nullopt, [](Tile) { return false; },
+        [&](Tile* run, glm::ivec3 pos, int32_t length) {
+            const Tile* src = &region.tiles[region.index(pos - min)];
+
+            size_t changed = 0;
+            for (int32_t i = 0; i < length; ++i)
+                changed += run[i] != src[i];
+
+            memcpy(run, src, length);
+
+            return changed;
+        });
+}
+
+uint8_t World::get_light(LightChannel channel, glm::ivec3 pos) const
+{
+    int32_t y = Chunk::real_y_to_column_y(pos.y);
+
+    if (y < 0 || y >= Chunk::height) return y < 0 || channel == LightChannel::block ? 0 : Chunk::max_light;
+
+    m_light_engine->wait();
+
+    auto* chunk = m_chunks.get(Chunk::real_pos_to_chunk_pos(glm::ivec2(pos.x, pos.z)));
+    if (chunk == nullptr) return 0;
+
+    glm::ivec3 in_pos = Chunk::real_pos_to_in_chunk_pos(pos);
+
+    return chunk->get_light(channel, in_pos.x, y, in_pos.z);
+}
+
+std::optional<RaycastHit> World::raycast(glm::vec3 origin, glm::vec3 dir, float max_dist) const
+{
+    constexpr int32_t cell_size = Chunk::chunk_size;
+    constexpr float infinity    = std::numeric_limits<float>::infinity();
+
+    float length = glm::length(dir);
+    if (length == 0.f) return std::nullopt;
+    dir /= length;
+
+    glm::ivec3 step;
+    glm::vec3 t_delta;
+
+    for (int a = 0; a < 3; ++a)
     {
-        glm::ivec3 in_pos = pos & (Chunk::chunk_size - 1);
-        c->set_block(tile, in_pos.x, in_pos.y, in_pos.z);
-        m_updated_chunks.emplace(c);
+        step[a]    = dir[a] > 0.f ? 1 : dir[a] < 0.f ? -1 : 0;
+        t_delta[a] = step[a] ? 1.f / std::abs(dir[a]) : infinity;
+    }
+
+    // distance along the ray to the far side of the cell of the given size in the direction of travel
+    auto boundary = [&](int a, int32_t cell, int32_t size) {
+        if (step[a] == 0) return infinity;
+        return ((cell + (step[a] > 0)) * size - origin[a]) / dir[a];
+    };
+
+    glm::ivec3 pos    = glm::floor(origin);
+    glm::ivec3 normal = {};
+    glm::vec3 t_max;
+    float t = 0.f;
+
+    for (int a = 0; a < 3; ++a)
+        t_max[a] = boundary(a, pos[a], 1);
+
+    // the vertical chunk the ray is in, its occupancy is null if it is empty, unloaded or outside the world
+    const Chunk* chunk                = nullptr;
+    const Chunk::Occupancy* occupancy = nullptr;
+    glm::ivec3 cell                   = Chunk::real_pos_to_chunk_pos(pos);
+    bool cell_checked                 = false;
+
+    while (t <= max_dist)
+    {
+        if (!cell_checked || Chunk::real_pos_to_chunk_pos(pos) != cell)
+        {
+            glm::ivec3 new_cell = Chunk::real_pos_to_chunk_pos(pos);
+
+            if (!cell_checked || new_cell.x != cell.x || new_cell.z != cell.z) chunk = m_chunks.get({new_cell.x, new_cell.z});
+
+            cell         = new_cell;
+            cell_checked = true;
+
+            int32_t vertical = cell.y - Chunk::min_vertical_chunk;
+
+            bool in_world = vertical >= 0 && vertical < Chunk::vertical_chunk_count;
+            occupancy     = chunk && in_world && !chunk->is_vertical_chunk_empty(vertical) ? &chunk->get_occupancy(vertical) : nullptr;
+
+            // nothing more to hit once the ray leaves the world vertically
+            if (!in_world && (vertical < 0 ? step.y <= 0 : step.y >= 0)) break;
+        }
+
+        if (occupancy == nullptr)
+        {
+            // crosses the whole cell at once, continuing from the block the ray enters next
+            int axis     = 0;
+            float t_exit = infinity;
+
+            for (int a = 0; a < 3; ++a)
+            {
+                float t_a = boundary(a, cell[a], cell_size);
+                if (t_a < t_exit)
+                {
+                    t_exit = t_a;
+                    axis   = a;
+                }
+            }
+
+            if (t_exit > max_dist) break;
+
+            glm::vec3 p = origin + dir * t_exit;
+
+            for (int a = 0; a < 3; ++a)
+            {
+                int32_t cell_beg = cell[a] * cell_size;
+
+                if (a == axis)
+                    pos[a] = step[a] > 0 ? cell_beg + cell_size : cell_beg - 1;
+                else
+                    pos[a] = std::clamp<int32_t>(std::floor(p[a]), cell_beg, cell_beg + cell_size - 1);
+
+                t_max[a] = boundary(a, pos[a], 1);
+            }
+
+            t            = t_exit;
+            normal       = {};
+            normal[axis] = -step[axis];
+            continue;
+        }
+
+        glm::ivec3 in_pos = Chunk::real_pos_to_in_chunk_pos(pos);
+
+        if (((*occupancy)[in_pos.x + in_pos.z * Chunk::chunk_size] >> in_pos.y) & 1)
+        {
+            Tile tile = chunk->get_block(in_pos.x, Chunk::real_y_to_column_y(pos.y), in_pos.z);
+            return RaycastHit{.pos = pos, .normal = normal, .tile = tile, .distance = t};
+        }
+
+        int axis = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+
+        t = t_max[axis];
+        pos[axis] += step[axis];
+        t_max[axis] += t_delta[axis];
 
-        return true;
+        normal       = {};
+        normal[axis] = -step[axis];
     }
 
-    return false;
+    return std::nullopt;
 }
 
 void World::update(float delta_t)
 {
     std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> new_chunks;
+    m_region_store->out_chunks.fetch_available(new_chunks, 10000);
     m_world_gen->out_chunks.fetch_available(new_chunks, 10000);
 
+    std::vector<glm::ivec2> missing_chunks;
+    m_region_store->missing_chunks.fetch_available(missing_chunks, 10000);
+
+    if (missing_chunks.size())
+    {
+        std::vector<ChunkGenRequest> requests;
+        for (auto pos : missing_chunks)
+            requests.push_back(ChunkGenRequest{.pos = pos, .beg = m_bottom_vertical_chunk});
+
+        m_world_gen->in_requests.push(std::move(requests));
+    }
+
     // if(new_chunks.size()) fmt::print("generated {} chunks\n",new_chunks.size());
 
     for (auto& [pos, nchunk] : new_chunks)
     {
-        set_chunk(std::move(nchunk), pos);
+        if (nchunk->loaded_end() != Chunk::vertical_chunk_count)
+        {
+            m_extending.erase(pos);
+
+            // the chunk may have been evicted or loaded again with other vertical chunks meanwhile
+            if (auto* chunk = m_chunks.get(pos); chunk && chunk->loaded_beg() == nchunk->loaded_end())
+                extend_chunk(chunk, std::move(nchunk));
+        }
+        // the placeholder is gone if the chunk was evicted while generating
+        else if (m_chunks.contains(pos) && m_chunks.get(pos) == nullptr)
+        {
+            set_chunk(std::move(nchunk), pos);
+        }
     }
 
+    // runs while the frame is rendered, anything changing chunks before the next update waits for it
+    m_light_engine->start(light_budget);
+
     if (!m_player) return;
 
     std::vector<glm::ivec2> chunks_to_gen;
 
-    glm::ivec2 player_cpos = glm::floor(glm::vec2(m_player->pos.x, m_player->pos.z) / 32.f);
+    glm::ivec2 player_cpos = glm::floor(glm::vec2(m_player->pos.x, m_player->pos.z) / float(Chunk::chunk_size));
+
+    int32_t player_y = Chunk::real_y_to_column_y(static_cast<int32_t>(std::floor(m_player->pos.y)));
+    player_y         = std::clamp(player_y, 0, Chunk::height - 1);
+    uint32_t bottom  = std::max(player_y / Chunk::chunk_size - vertical_render_distance, 0);
+
+    bool bottom_changed     = bottom != m_bottom_vertical_chunk;
+    m_bottom_vertical_chunk = bottom;
+
+    glm::vec2 view_dir = glm::vec2(m_player->dir.x, m_player->dir.z);
+    view_dir           = glm::length(view_dir) > 0.01f ? glm::normalize(view_dir) : glm::vec2(0);
+
+    // the generation queue follows the player and is reordered when it turns away
+    bool turned = view_dir != m_focus_dir && glm::dot(view_dir, m_focus_dir) < 0.9f;
+    if (player_cpos != m_player_old_pos || turned) focus_generation(view_dir);
 
     if (player_cpos != m_player_old_pos)
     {
@@ -102,9 +616,9 @@ void World::update(float delta_t)
 
                 if (old_render_dist * old_render_dist < diff.x + diff.y)
                 {
-                    if (m_chunks.find(c_pos) == m_chunks.end())
+                    if (!m_chunks.contains(c_pos))
                     {
-                        m_chunks[c_pos] = nullptr;
+                        m_chunks.insert(c_pos, nullptr);
                         chunks_to_gen.push_back(c_pos);
                     }
                 }
@@ -116,14 +630,188 @@ void World::update(float delta_t)
             // fmt::print("generating {}\n", chunks_to_gen.size());
             // fmt::print("chunks: {}",map_vec(chunks_to_gen, [](glm::ivec2& v){return fmt::format("({},{})",v.x,v.y);}));
 
-            m_world_gen->in_chunk_poses.push(std::move(chunks_to_gen));
+            // the region store goes in order, the ones that have to be generated are ordered again by the queue
+            std::sort(chunks_to_gen.begin(), chunks_to_gen.end(),
+                [&](glm::ivec2 a, glm::ivec2 b) { return m_focus.priority(a) < m_focus.priority(b); });
+
+            m_region_store->load(std::move(chunks_to_gen));
         }
 
         m_player_old_pos = player_cpos;
+        m_tick++;
     }
+
+    if (new_chunks.size() || bottom_changed) request_vertical_chunks(player_cpos);
+
+    if (new_chunks.size() || m_tick != m_evict_tick) evict_chunks(player_cpos);
+}
+
+void World::focus_generation(glm::vec2 view_dir)
+{
+    m_focus_dir = view_dir;
+
+    m_focus = GenFocus{
+        .pos             = glm::vec2(m_player->pos.x, m_player->pos.z) / float(Chunk::chunk_size),
+        .dir             = view_dir,
+        .cancel_distance = static_cast<float>(render_distance + evict_margin),
+    };
+
+    for (auto& request : m_world_gen->in_requests.set_focus(m_focus))
+    {
+        if (request.end != Chunk::vertical_chunk_count)
+            m_extending.erase(request.pos);
+        // the placeholder goes with the request, the chunk is requested again once the player gets back to it
+        else if (m_chunks.contains(request.pos) && m_chunks.get(request.pos) == nullptr)
+            m_chunks.erase(request.pos);
+    }
+}
+
+void World::request_vertical_chunks(glm::ivec2 player_cpos)
+{
+    std::vector<ChunkGenRequest> requests;
+
+    int visible_dist2 = render_distance * render_distance;
+
+    m_chunks.for_each([&](glm::ivec2 pos, Chunk* chunk) {
+        if (chunk == nullptr || chunk->loaded_beg() <= m_bottom_vertical_chunk || m_extending.contains(pos)) return;
+
+        auto diff = pos - player_cpos;
+        if (diff.x * diff.x + diff.y * diff.y > visible_dist2) return;
+
+        requests.push_back(ChunkGenRequest{.pos = pos, .beg = m_bottom_vertical_chunk, .end = chunk->loaded_beg()});
+        m_extending.insert(pos);
+    });
+
+    if (requests.size()) m_world_gen->in_requests.push(std::move(requests));
+}
+
+void World::extend_chunk(Chunk* chunk, std::unique_ptr<Chunk> below)
+{
+    m_light_engine->wait();
+
+    uint32_t beg = below->loaded_beg();
+    uint32_t end = below->loaded_end();
+
+    chunk->merge_below(std::move(below));
+
+    auto range = [](uint32_t beg, uint32_t end) {
+        return (Chunk::all_vertical_chunks >> (Chunk::vertical_chunk_count - (end - beg))) << beg;
+    };
+
+    // the bottom faces of the vertical chunk above them were hidden while there was nothing loaded below it, so were
+    // the faces of the neighbors across the new vertical chunks
+    mark_updated(chunk, range(beg, end + 1));
+
+    for (auto* neighbor : {chunk->m_neighbor.xp, chunk->m_neighbor.xn, chunk->m_neighbor.zp, chunk->m_neighbor.zn})
+        if (neighbor) mark_updated(neighbor, range(beg, end));
+
+    m_light_engine->add_vertical_chunks(chunk, beg, end);
+}
+
+void World::evict_chunks(glm::ivec2 player_cpos)
+{
+    m_evict_tick = m_tick;
+
+    int visible_dist2 = render_distance * render_distance;
+    int keep_dist2    = (render_distance + evict_margin) * (render_distance + evict_margin);
+
+    struct Candidate
+    {
+        glm::ivec2 pos;
+        uint32_t last_visible;
+        int dist2;
+    };
+
+    std::vector<glm::ivec2> far_chunks;
+    std::vector<Candidate> candidates;
+    size_t memory = 0;
+
+    // light arrays are allocated while it runs
+    m_light_engine->wait();
+
+    m_chunks.for_each([&](glm::ivec2 pos, Chunk* chunk) {
+        auto diff = pos - player_cpos;
+        int dist2 = diff.x * diff.x + diff.y * diff.y;
+
+        if (dist2 > keep_dist2)
+        {
+            far_chunks.push_back(pos);
+            return;
+        }
+
+        if (chunk == nullptr) return;
+
+        memory += sizeof(Chunk) + chunk->memory_usage().resident_bytes;
+
+        if (dist2 <= visible_dist2)
+            chunk->m_last_visible = m_tick;
+        else
+            candidates.push_back(Candidate{pos, chunk->m_last_visible, dist2});
+    });
+
+    for (auto pos : far_chunks)
+        remove_chunk(pos);
+
+    if (memory_budget == 0 || memory <= memory_budget) return;
+
+    // over budget, drop chunks in the margin that have been out of sight the longest, furthest first.
+    // chunks within render distance are never evicted since they would just be generated again
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.last_visible != b.last_visible ? a.last_visible < b.last_visible : a.dist2 > b.dist2;
+    });
+
+    for (auto& candidate : candidates)
+    {
+        if (memory <= memory_budget) break;
+
+        memory -= sizeof(Chunk) + m_chunks.get(candidate.pos)->memory_usage().resident_bytes;
+        remove_chunk(candidate.pos);
+    }
+}
+
+void World::remove_chunk(glm::ivec2 pos)
+{
+    // placeholders of chunks still being generated have no neighbors or meshes
+    if (auto* chunk = m_chunks.get(pos))
+    {
+        if (m_light_engine) m_light_engine->remove_chunk(chunk);
+
+        auto& neighbors = chunk->m_neighbor;
+
+        if (neighbors.xp) neighbors.xp->m_neighbor.xn = nullptr;
+        if (neighbors.xn) neighbors.xn->m_neighbor.xp = nullptr;
+        if (neighbors.zp) neighbors.zp->m_neighbor.zn = nullptr;
+        if (neighbors.zn) neighbors.zn->m_neighbor.zp = nullptr;
+
+        m_updated_chunks.erase(chunk);
+        m_evicted_chunks.push_back(pos);
+    }
+
+    if (auto chunk = m_chunks.erase(pos); chunk && chunk->m_unsaved) m_region_store->save(pos, std::move(chunk));
+}
+
+ChunkMemoryUsage World::memory_usage() const
+{
+    ChunkMemoryUsage usage;
+
+    m_light_engine->wait();
+
+    m_chunks.for_each([&](glm::ivec2 pos, const Chunk* chunk) {
+        if (chunk) usage += chunk->memory_usage();
+    });
+
+    return usage;
+}
+
+std::vector<std::pair<const Chunk*, Chunk::VerticalChunkMask>> World::get_updated_chunks()
+{
+    std::vector<std::pair<const Chunk*, Chunk::VerticalChunkMask>> updated(m_updated_chunks.begin(), m_updated_chunks.end());
+    m_updated_chunks.clear();
+
+    return updated;
 }
 
-std::unordered_set<const Chunk*> World::get_updated_chunks()
+std::vector<glm::ivec2> World::get_evicted_chunks()
 {
-    return std::move(m_updated_chunks);
+    return std::move(m_evicted_chunks);
 }
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <optional>
+#include <span>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -9,10 +13,37 @@
 #include <glm/vec2.hpp>
 
 #include "chunk.hpp"
+#include "chunk_map.hpp"
+#include "gen_queue.hpp"
 
 class WorldGen;
+class RegionStore;
+class LightEngine;
 class Player;
 
+struct BlockEdit
+{
+    glm::ivec3 pos;
+    Tile tile;
+};
+
+// tiles of a box copied out of the world by World::copy_region
+struct BlockRegion
+{
+    glm::ivec3 size = {};
+    std::vector<Tile> tiles;
+
+    inline size_t index(glm::ivec3 pos) const { return pos.x + (pos.z + (size_t)pos.y * size.z) * size.x; }
+};
+
+struct RaycastHit
+{
+    glm::ivec3 pos;    // the solid block that was hit
+    glm::ivec3 normal; // of the face the ray entered through, zero if the ray started inside the block
+    Tile tile;
+    float distance;
+};
+
 class World
 {
 public:
@@ -20,24 +51,155 @@ public:
 
     void set_chunk(std::unique_ptr<Chunk> chunk, glm::ivec2 pos);
     const Chunk* get_chunk(glm::ivec2 pos) const;
+    // lookups are safe from any thread, while the chunk is loaded
+    inline const ChunkMap& chunks() const { return m_chunks; }
     
     bool set_block(const glm::ivec3& pos,Tile tile);
+    // applies the edits in order, edits outside of loaded chunks are skipped. returns the number of applied edits
+    size_t set_blocks(std::span<const BlockEdit> edits);
+
+    // bulk edits of the blocks in a box, min and max inclusive. they are split per vertical chunk and written in runs
+    // along x, every edited vertical chunk is marked updated and relit once. blocks outside of loaded chunks are
+    // skipped. they return the number of changed blocks
+    size_t fill_box(glm::ivec3 min, glm::ivec3 max, Tile tile);
+    // the blocks within radius of center
+    size_t fill_sphere(glm::ivec3 center, int32_t radius, Tile tile);
+    size_t replace_in_box(glm::ivec3 min, glm::ivec3 max, Tile from, Tile to);
+    // unloaded blocks are copied as air
+    BlockRegion copy_region(glm::ivec3 min, glm::ivec3 max) const;
+    // writes the region with its first block at min
+    size_t paste_region(const BlockRegion& region, glm::ivec3 min);
 
-    std::unordered_set<const Chunk*> get_updated_chunks();
+    // first solid block along the ray within max_dist. unloaded chunks and vertical chunks and everything above or below
+    // the world count as empty, whole empty vertical chunks are crossed in one step. dir doesn't need to be normalized
+    std::optional<RaycastHit> raycast(glm::vec3 origin, glm::vec3 dir, float max_dist) const;
+    // calls func(glm::ivec3 pos, Tile tile) for every solid block of loaded chunks in the box between min and max, both
+    // inclusive. blocks come grouped by vertical chunk, empty vertical chunks and columns are skipped by their occupancy
+    template <class Func>
+    void for_each_block_in_aabb(glm::ivec3 min, glm::ivec3 max, Func&& func) const;
+
+    // waits for the light engine, unloaded positions are dark
+    uint8_t get_light(LightChannel channel, glm::ivec3 pos) const;
+    inline LightEngine& light_engine() { return *m_light_engine; }
+
+    // chunks changed since the last call with the vertical chunks that need to be remeshed. edits on a vertical chunk
+    // border also mark the vertical chunk across it
+    std::vector<std::pair<const Chunk*, Chunk::VerticalChunkMask>> get_updated_chunks();
+    // positions of chunks unloaded since the last call, their meshes should be released
+    std::vector<glm::ivec2> get_evicted_chunks();
+
+    ChunkMemoryUsage memory_usage() const;
 
     void update(float delta_t);
 
     void set_player(Player* p){m_player=p;};
 
+    // chunks further than render_distance + evict_margin are unloaded. chunks between render_distance and the margin
+    // stay loaded so walking back and forth over a chunk border doesn't regenerate them, unless memory_budget is exceeded
+    int evict_margin     = 3;
+    size_t memory_budget = 256 * 1024 * 1024;
+
+    // light nodes the light engine processes in the background of each frame
+    size_t light_budget = 200'000;
+
+    // chunks within render distance are loaded down to this many vertical chunks below the player, and always down to
+    // the bottom of their terrain surface. caves further down are only generated once the player gets close to them.
+    // raising it to Chunk::vertical_chunk_count loads whole columns
+    int vertical_render_distance = 3;
+
 private:
+    void evict_chunks(glm::ivec2 player_cpos);
+    // merges the vertical chunks generated below a loaded chunk into it
+    void extend_chunk(Chunk* chunk, std::unique_ptr<Chunk> below);
+    // moves the focus of the generation queue to the player, drops what the queue cancels
+    void focus_generation(glm::vec2 view_dir);
+    // requests the missing vertical chunks down to m_bottom_vertical_chunk for chunks within render distance
+    void request_vertical_chunks(glm::ivec2 player_cpos);
+    void remove_chunk(glm::ivec2 pos);
+    void mark_updated(const Chunk* chunk, Chunk::VerticalChunkMask mask);
+    // marks the vertical chunks of the box between in_min and in_max, which may not span chunks, and the ones sharing
+    // a face with them if the box touches their border
+    void mark_edited(Chunk* chunk, glm::ivec3 in_min, glm::ivec3 in_max);
+    // write_run(Tile* run, glm::ivec3 pos, int32_t length) writes the flat tiles of a run along x starting at the block
+    // at pos and returns how many it changed. vertical chunks whose uniform tile keeps_uniform(tile) accepts are
+    // skipped without unpacking them, vertical chunks the box covers completely are set to fill if there is one
+    template <class KeepsUniform, class WriteRun>
+    size_t edit_box(glm::ivec3 min, glm::ivec3 max, std::optional<Tile> fill, KeepsUniform&& keeps_uniform, WriteRun&& write_run);
+
     int render_distance = 10;
     int old_render_dist = 10;
 
     std::unique_ptr<WorldGen> m_world_gen;
-    std::unordered_set<const Chunk*> m_updated_chunks;
-    std::unordered_map<glm::ivec2, std::unique_ptr<Chunk>> m_chunks;
+    // chunks are loaded from here first and only generated if they were never saved
+    std::unique_ptr<RegionStore> m_region_store;
+    // chunks may only be changed while it is idle, everything changing them waits for it
+    std::unique_ptr<LightEngine> m_light_engine;
+    std::unordered_map<const Chunk*, Chunk::VerticalChunkMask> m_updated_chunks;
+    ChunkMap m_chunks;
+    std::vector<glm::ivec2> m_evicted_chunks;
+    // chunks with vertical chunks being generated below them, at most one request per chunk is in flight
+    std::unordered_set<glm::ivec2> m_extending;
+    uint32_t m_bottom_vertical_chunk = Chunk::real_y_to_column_y(0) / Chunk::chunk_size;
+    // what the generation queue was last focused on
+    GenFocus m_focus;
+    glm::vec2 m_focus_dir = {};
+
+    uint32_t m_tick       = 0; // counts player chunk changes
+    uint32_t m_evict_tick = 0;
 
     Player* m_player;
     glm::ivec2 m_player_old_pos = {0xFFF,0xFFF}; 
 
-};
\ No newline at end of file
+};
+
+template <class Func>
+void World::for_each_block_in_aabb(glm::ivec3 min, glm::ivec3 max, Func&& func) const
+{
+    constexpr int32_t size = Chunk::chunk_size;
+
+    // column y from here on
+    min.y = std::max(Chunk::real_y_to_column_y(min.y), 0);
+    max.y = std::min(Chunk::real_y_to_column_y(max.y), Chunk::height - 1);
+
+    if (min.x > max.x || min.y > max.y || min.z > max.z) return;
+
+    constexpr int32_t size_log2 = Chunk::chunk_size_log2;
+
+    for (int32_t cz = min.z >> size_log2; cz <= max.z >> size_log2; ++cz)
+    {
+        for (int32_t cx = min.x >> size_log2; cx <= max.x >> size_log2; ++cx)
+        {
+            const Chunk* chunk = m_chunks.get({cx, cz});
+            if (chunk == nullptr) continue;
+
+            glm::ivec3 base = {cx * size, 0, cz * size};
+
+            int32_t x_beg = std::max(min.x - base.x, 0), x_end = std::min(max.x - base.x, size - 1);
+            int32_t z_beg = std::max(min.z - base.z, 0), z_end = std::min(max.z - base.z, size - 1);
+
+            for (int32_t v = min.y >> size_log2; v <= max.y >> size_log2; ++v)
+            {
+                if (chunk->is_vertical_chunk_empty(v)) continue;
+
+                const auto& occupancy = chunk->get_occupancy(v);
+
+                int32_t y_beg = std::max(min.y - v * size, 0), y_end = std::min(max.y - v * size, size - 1);
+
+                Chunk::ColumnMask y_mask = (Chunk::full_column >> (size - 1 - y_end)) & (Chunk::full_column << y_beg);
+
+                for (int32_t z = z_beg; z <= z_end; ++z)
+                {
+                    for (int32_t x = x_beg; x <= x_end; ++x)
+                    {
+                        for (Chunk::ColumnMask column = occupancy[x + z * size] & y_mask; column; column &= column - 1)
+                        {
+                            int32_t y = v * size + std::countr_zero(column);
+
+                            func(glm::ivec3(base.x + x, Chunk::column_y_to_real_y(y), base.z + z), chunk->get_block(x, y, z));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -1,17 +1,27 @@
 #include "world_gen.hpp"
 
+#include <array>
 #include <random>
 
 #include "../../util/noise.hpp"
+#include "../../util/noise_graph.hpp"
+#include "../../util/noise_lattice.hpp"
+#include "climate_map.hpp"
+#include "light_engine.hpp"
 
 #include <PerlinNoise.hpp>
 
-WorldGen::WorldGen(uint64_t seed) : m_seed(seed) { gen_func_init(); }
+WorldGen::WorldGen(uint64_t seed) : m_seed(seed)
+{
+    stage_funcs_init();
+    in_requests.set_on_push([this] { schedule(); });
+}
 
 namespace
 {
 
-void iterate_over_layers_in_vchunk(Tile* vchunk, uint32_t y_beg, uint32_t y_end, auto&& func)
+// func(row, y, z) for each row of chunk_size tiles along x
+void iterate_over_rows_in_vchunk(Tile* vchunk, uint32_t y_beg, uint32_t y_end, auto&& func)
 {
     assert(y_beg <= Chunk::chunk_size && y_end <= Chunk::chunk_size);
 
@@ -19,20 +29,26 @@ void iterate_over_layers_in_vchunk(Tile* vchunk, uint32_t y_beg, uint32_t y_end,
     {
         for (uint32_t z = 0; z < Chunk::chunk_size; ++z)
         {
-            uint32_t yz_offset = y * Chunk::chunk_surface_area + z * Chunk::chunk_size;
-            for (uint32_t x = 0; x < Chunk::chunk_size; ++x)
-            {
-                func(vchunk[yz_offset + x], x, y, z);
-            }
+            func(vchunk + y * Chunk::chunk_surface_area + z * Chunk::chunk_size, y, z);
         }
     }
 }
 
+void iterate_over_layers_in_vchunk(Tile* vchunk, uint32_t y_beg, uint32_t y_end, auto&& func)
+{
+    iterate_over_rows_in_vchunk(vchunk, y_beg, y_end, [&func](Tile* row, uint32_t y, uint32_t z) {
+        for (uint32_t x = 0; x < Chunk::chunk_size; ++x)
+        {
+            func(row[x], x, y, z);
+        }
+    });
+}
+
 auto fill_air = [](Tile& t, uint32_t, uint32_t, uint32_t) { t = Tile::air; };
 
-void iterate_over_layers(Chunk* chunk, uint32_t y_beg, uint32_t y_end, auto&& func)
+void iterate_over_rows(Chunk* chunk, uint32_t y_beg, uint32_t y_end, auto&& func)
 {
-    assert(chunk && y_beg <= Chunk::chunk_size * Chunk::vertical_chunk_count && y_end <= Chunk::chunk_size * Chunk::vertical_chunk_count);
+    assert(chunk && y_beg <= Chunk::height && y_end <= Chunk::height);
 
     for (int y = y_beg / Chunk::chunk_size; y < y_end / Chunk::chunk_size + (y_end % Chunk::chunk_size != 0); ++y)
     {
@@ -42,21 +58,130 @@ void iterate_over_layers(Chunk* chunk, uint32_t y_beg, uint32_t y_end, auto&& fu
         Tile* vchunk = chunk->get_tile_array(y);
         if (vchunk == nullptr)
         {
-            chunk->set_vertical_chunk(malloc_unique<Tile>(Chunk::chunk_volume), y);
+            chunk->set_vertical_chunk(Chunk::allocate_tile_array(), y);
             vchunk = chunk->get_tile_array(y);
 
             iterate_over_layers_in_vchunk(vchunk, 0, vy_beg, fill_air);
             iterate_over_layers_in_vchunk(vchunk, vy_end, Chunk::chunk_size, fill_air);
         }
 
-        iterate_over_layers_in_vchunk(vchunk, vy_beg, vy_end,
-            [&func, cy = y * Chunk::chunk_size](Tile& t, uint32_t x, uint32_t y, uint32_t z) { func(t, x, y + cy, z); });
+        iterate_over_rows_in_vchunk(vchunk, vy_beg, vy_end,
+            [&func, cy = y * Chunk::chunk_size](Tile* row, uint32_t y, uint32_t z) { func(row, y + cy, z); });
+    }
+}
+
+void iterate_over_layers(Chunk* chunk, uint32_t y_beg, uint32_t y_end, auto&& func)
+{
+    iterate_over_rows(chunk, y_beg, y_end, [&func](Tile* row, uint32_t y, uint32_t z) {
+        for (uint32_t x = 0; x < Chunk::chunk_size; ++x)
+        {
+            func(row[x], x, y, z);
+        }
+    });
+}
+
+// whole vertical chunks in the range become uniform and take no memory until something changes them
+void fill_layers(Chunk* chunk, uint32_t y_beg, uint32_t y_end, Tile t)
+{
+    uint32_t full_beg = (y_beg + Chunk::chunk_size - 1) / Chunk::chunk_size;
+    uint32_t full_end = y_end / Chunk::chunk_size;
+
+    if (full_beg >= full_end)
+    {
+        iterate_over_layers(chunk, y_beg, y_end, [t](Tile& tile, uint32_t, uint32_t, uint32_t) { tile = t; });
+        return;
     }
+
+    for (uint32_t y = full_beg; y < full_end; ++y)
+        chunk->set_vertical_chunk_uniform(t, y);
+
+    auto fill = [t](Tile& tile, uint32_t, uint32_t, uint32_t) { tile = t; };
+
+    if (y_beg < full_beg * Chunk::chunk_size) iterate_over_layers(chunk, y_beg, full_beg * Chunk::chunk_size, fill);
+    if (full_end * Chunk::chunk_size < y_end) iterate_over_layers(chunk, full_end * Chunk::chunk_size, y_end, fill);
 }
 
+// edge in tiles of the cells the cave noise is bounded over, cells the caves can't cross are left as they are or
+// carved out whole without sampling their tiles
+constexpr int32_t cave_cell = 4;
+
+enum class CellFate : uint8_t
+{
+    mixed,
+    solid,
+    carved,
+};
+
+// the noise that only depends on x and z, sampled once per column of the chunk, z major
+struct ColumnNoise
+{
+    using Field = std::array<double, Chunk::chunk_surface_area>;
+
+    Field base;
+    Field amp;
+    Field snow;
+};
+
+// samples noise at every column of the chunk at real x and z, a row at a time
+void sample_field(const AmplifiedNoise& noise, double c_real_pos_x, double c_real_pos_z, ColumnNoise::Field& field)
+{
+    std::array<double, Chunk::chunk_size> row_x, row_z;
+
+    for (int x = 0; x < Chunk::chunk_size; ++x)
+        row_x[x] = c_real_pos_x + x;
+
+    for (int z = 0; z < Chunk::chunk_size; ++z)
+    {
+        row_z.fill(c_real_pos_z + z);
+        noise.noise(row_x.data(), row_z.data(), field.data() + z * Chunk::chunk_size, Chunk::chunk_size);
+    }
+}
+
+// the 3d noise of the tiles of the column at c_pos from column y beg up to end
+std::pair<glm::ivec3, glm::ivec3> lattice_box(glm::ivec2 c_pos, uint32_t beg, uint32_t end)
+{
+    return {glm::ivec3(c_pos.x * Chunk::chunk_size, Chunk::column_y_to_real_y(beg), c_pos.y * Chunk::chunk_size),
+        glm::ivec3(Chunk::chunk_size, end - beg, Chunk::chunk_size)};
+}
+
+// decorations are placed by a hash of their column, so a column decorates the same whichever neighbour asked for it
+uint64_t column_hash(uint64_t seed, int32_t x, int32_t z)
+{
+    uint64_t h = seed ^ (uint64_t(uint32_t(x)) * 0x9e3779b97f4a7c15ull) ^ (uint64_t(uint32_t(z)) * 0xc2b2ae3d27d4eb4full);
+
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+
+    return h ^ (h >> 31);
+}
+
+// one column in this many gets a tree if it is grass
+constexpr uint64_t tree_rarity = 160;
+// how far the leaves of a tree reach from its trunk, less than a chunk so a tree only writes into the 8 neighbours
+constexpr int32_t tree_reach = 2;
+static_assert(tree_reach < Chunk::chunk_size);
+
 } // namespace
 
-void WorldGen::gen_func_init()
+// what the terrain, surface and carve stages of a column pass on to the next one
+struct ChunkGenState
+{
+    ChunkGenRequest request;
+    std::unique_ptr<Chunk> chunk;
+
+    ColumnNoise columns;
+    ChunkClimate climate;
+
+    // the layers the surface of the terrain lies in and the loaded tiles, in column y
+    uint32_t layer_beg = 0;
+    uint32_t layer_end = 0;
+    uint32_t y_beg     = 0;
+    uint32_t y_end     = 0;
+
+    uint32_t clamp_y(uint32_t y) const { return std::clamp(y, y_beg, y_end); }
+};
+
+void WorldGen::stage_funcs_init()
 {
     double base_height = 60.7;
 
@@ -68,101 +193,168 @@ void WorldGen::gen_func_init()
 
     auto seeder = std::mt19937(m_seed);
 
-    m_gen_func =
-        [              =,
-            p          = AmplifiedNoise(0.006445, 70.3, seeder()),
-            p1         = AmplifiedNoise(0.063000, 17.3, seeder()),
-            p2         = AmplifiedNoise(0.001739, 02.7, seeder()),
-            psnow      = AmplifiedNoise(0.092272, 16.3, seeder()),
-            pbiome     = AmplifiedNoise(0.003378, 03.2, seeder()),
-            cave_noise = AmplifiedNoise(0.023100, 01.0, seeder())
+    auto p          = AmplifiedNoise(0.006445, 70.3, seeder());
+    auto p1         = AmplifiedNoise(0.063000, 17.3, seeder());
+    auto p2         = AmplifiedNoise(0.001739, 02.7, seeder());
+    auto psnow      = AmplifiedNoise(0.092272, 16.3, seeder());
+    auto pbiome     = AmplifiedNoise(0.003378, 03.2, seeder());
+    auto cave_noise = AmplifiedNoise(0.023100, 01.0, seeder());
+
+    // psnow changes every few tiles, it stays sampled per column
+    m_climate = std::make_unique<ClimateMap>(pbiome, p2);
+
+    namespace ng = noise_graph;
+
+    // the terrain as noise graphs. the warp is sampled on its own, on a lattice when warp_lattice asks for one, and
+    // reaches the height through the inputs along with the amplitude of the column
+    constexpr uint32_t amp_input = 0, warp_x_input = 1, warp_z_input = 2;
 
-            //
-    ](glm::ivec2 c_pos) {
-        auto chunk = std::make_unique<Chunk>();
+    auto amp    = ng::input(amp_input);
+    auto warp_x = ng::noise(p1, ng::coord_z, ng::coord_x, ng::coord_y);
+    auto warp_z = ng::noise(p1, ng::coord_x, ng::coord_y, ng::coord_z);
+    auto height = ng::warp(ng::noise(p, ng::coord_x, ng::coord_z), ng::input(warp_x_input) * amp * 0.9, 0,
+                      ng::input(warp_z_input) * amp * 1.1) *
+                      amp +
+                  base_height;
+    auto solid  = height > ng::coord_y;
+    auto caves  = ng::noise(cave_noise, ng::coord_x, ng::coord_y, ng::coord_z);
+
+    // the terrain of the column, stone below its surface layers and the warped height within them
+    m_stage_funcs[0] = [=, this, climate = m_climate.get()](ChunkGenState& state) {
+        const ChunkGenRequest& request = state.request;
+
+        state.chunk  = std::make_unique<Chunk>();
+        Chunk* chunk = state.chunk.get();
+
+        glm::ivec2 c_pos = request.pos;
 
         double c_real_pos_x = c_pos.x * Chunk::chunk_size;
         double c_real_pos_z = c_pos.y * Chunk::chunk_size;
 
-        // std::array<float, Chunk::chunk_surface_area> base_heights;
+        // the 2d noise first, the passes below only evaluate the 3d noise per tile
+        ColumnNoise& columns = state.columns;
+
+        sample_field(p, c_real_pos_x, c_real_pos_z, columns.base);
+        sample_field(p2, c_real_pos_x, c_real_pos_z, columns.amp);
+        sample_field(psnow, c_real_pos_x, c_real_pos_z, columns.snow);
+
+        state.climate = climate->chunk_climate(c_pos);
 
         float min_base_height = 1'000'000;
         float max_base_height = 0;
 
         for (int z = 0; z < Chunk::chunk_size; ++z)
         {
-            double real_z = c_real_pos_z + z;
-
             for (int x = 0; x < Chunk::chunk_size; ++x)
             {
                 float center_proximity = std::max(std::abs(z - (Chunk::chunk_size / 2)), std::abs(x - (Chunk::chunk_size / 2))) * 0.3f;
 
-                double real_x = c_real_pos_x + x;
-
-                float height = p.noise(real_x, real_z) * p2.noise(real_x, real_z) + base_height;
+                uint32_t column = z * Chunk::chunk_size + x;
 
-                // base_heights[z * Chunk::chunk_size + x] = height;
+                float height = columns.base[column] * columns.amp[column] + base_height;
 
                 min_base_height = std::min(height - center_proximity, min_base_height);
                 max_base_height = std::max(height + center_proximity, max_base_height);
             }
         }
 
-        float layer_bias = std::clamp<float>(std::abs(p2.noise(c_real_pos_x, c_real_pos_z)) + 3.4f, 3.f, 45.f);
+        // the amplitude at the corner of the chunk
+        float layer_bias = std::clamp<float>(std::abs(columns.amp[0]) + 3.4f, 3.f, 45.f);
 
-        volatile uint32_t layer_beg = std::clamp<int>(static_cast<int>(min_base_height - layer_bias), 0, Chunk::chunk_size * Chunk::vertical_chunk_count);
-        volatile uint32_t layer_end = std::clamp<int>(static_cast<int>(max_base_height + layer_bias), 1, Chunk::chunk_size * Chunk::vertical_chunk_count);
+        // y is counted from the bottom of the column from here on, the noise is sampled at the real y
+        volatile uint32_t layer_beg = std::clamp<int>(Chunk::real_y_to_column_y(static_cast<int>(min_base_height - layer_bias)), 0, Chunk::height);
+        volatile uint32_t layer_end = std::clamp<int>(Chunk::real_y_to_column_y(static_cast<int>(max_base_height + layer_bias)), 1, Chunk::height);
 
-        iterate_over_layers(chunk.get(), 0, layer_beg, [&](Tile& t, uint32_t x, uint32_t y, uint32_t z) {
-            t = Tile::stone;
-        });
+        state.layer_beg = layer_beg;
+        state.layer_end = layer_end;
+
+        bool whole_column = request.end == Chunk::vertical_chunk_count;
+
+        uint32_t v_beg = whole_column ? std::min<uint32_t>(request.beg, layer_beg / Chunk::chunk_size) : request.beg;
+        chunk->set_loaded_range(v_beg, request.end);
+
+        state.y_beg = v_beg * Chunk::chunk_size;
+        state.y_end = request.end * Chunk::chunk_size;
+
+        fill_layers(chunk, state.y_beg, state.clamp_y(layer_beg), Tile::stone);
+
+        // the 3d noise is evaluated a row of chunk_size samples at a time, which the batched kernels run in parallel
+        std::array<double, Chunk::chunk_size> row_x, row_y, row_z, row_a, row_b;
+        std::array<int32_t, Chunk::chunk_size> tile_x;
+
+        for (int x = 0; x < Chunk::chunk_size; ++x)
+        {
+            row_x[x]  = c_real_pos_x + x;
+            tile_x[x] = x;
+        }
+
+        uint32_t warp_beg = state.clamp_y(layer_beg);
+        auto [warp_origin, warp_size] = lattice_box(c_pos, warp_beg, state.clamp_y(layer_end));
+
+        NoiseLattice warp_x_lattice(ng::sampler(warp_x), warp_lattice, warp_origin, warp_size);
+        NoiseLattice warp_z_lattice(ng::sampler(warp_z), warp_lattice, warp_origin, warp_size);
 
-        iterate_over_layers(chunk.get(), layer_beg, layer_end, [&](Tile& t, uint32_t x, uint32_t y, uint32_t z) {
-            double real_x = c_real_pos_x + x;
-            double real_z = c_real_pos_z + z;
+        iterate_over_rows(chunk, warp_beg, state.clamp_y(layer_end), [&](Tile* row, uint32_t cy, uint32_t z) {
+            row_y.fill(Chunk::column_y_to_real_y(cy));
+            row_z.fill(c_real_pos_z + z);
 
-            double b_amp = p2.noise(real_x, real_z);
+            warp_x_lattice.sample(cy - warp_beg, z, tile_x.data(), Chunk::chunk_size, row_a.data());
+            warp_z_lattice.sample(cy - warp_beg, z, tile_x.data(), Chunk::chunk_size, row_b.data());
 
-            double height = p.noise(
-                                real_x + p1.noise(real_z, real_x, y) * b_amp * 0.9,
-                                real_z + p1.noise(real_x, y, real_z) * b_amp * 1.1) *
-                                b_amp +
-                            base_height;
+            const double* inputs[] = {columns.amp.data() + z * Chunk::chunk_size, row_a.data(), row_b.data()};
 
-            t = height > y ? Tile::stone : Tile::air;
+            ng::evaluate(solid, ng::Batch{row_x.data(), row_y.data(), row_z.data(), inputs}, row_a.data(), Chunk::chunk_size);
+
+            for (int x = 0; x < Chunk::chunk_size; ++x)
+                row[x] = row_a[x] != 0 ? Tile::stone : Tile::air;
         });
 
+        // the layers only hold stone and air so far, the top solid tile of a column is where its surface starts
+        chunk->update_occupancy();
+    };
+
+    // grass, sand or snow on top of every column and dirt or sand under it
+    m_stage_funcs[1] = [](ChunkGenState& state) {
+        Chunk* chunk = state.chunk.get();
+
         for (int z = 0; z < Chunk::chunk_size; ++z)
         {
-            double real_z = c_real_pos_z + z;
-
             for (int x = 0; x < Chunk::chunk_size; ++x)
             {
-                double real_x = c_real_pos_x + x;
+                int y = (int)chunk->get_height(x, z) - 1;
+                if (y <= (int)state.layer_beg) continue;
 
-                for (int y = layer_end - 1; y > layer_beg; --y)
-                {
-                    double snow_height = psnow.noise(real_x, real_z) + 90;
+                uint32_t column = z * Chunk::chunk_size + x;
+
+                double snow_height = state.columns.snow[column] + 90;
 
-                    bool is_desert = pbiome.noise(real_x, real_z) - std::abs(p2.noise(real_x, real_z)) > 1.32;
+                bool is_desert = state.climate.get(x, z) == Biome::desert;
 
-                    Tile t = chunk->get_block(x, y, z);
-                    if (t == Tile::stone)
+                chunk->set_block(Chunk::column_y_to_real_y(y) < snow_height ? (is_desert ? Tile::sand : Tile::grass) : Tile::snow, x, y, z);
+                for (int y1 = std::max(y - 3, 0); y1 < y; ++y1)
+                {
+                    if (chunk->get_block(x, y1, z) == Tile::stone)
                     {
-                        chunk->set_block(y < snow_height ? (is_desert ? Tile::sand : Tile::grass) : Tile::snow, x, y, z);
-                        for (int y1 = std::max(y - 3, 0); y1 < y; ++y1)
-                        {
-                            if (chunk->get_block(x, y1, z) == Tile::stone)
-                            {
-                                chunk->set_block((is_desert ? Tile::sand : Tile::dirt), x, y1, z);
-                            }
-                        }
-
-                        break;
+                        chunk->set_block((is_desert ? Tile::sand : Tile::dirt), x, y1, z);
                     }
                 }
             }
         }
+    };
+
+    // the caves, through the surface and the stone below it
+    m_stage_funcs[2] = [=, this](ChunkGenState& state) {
+        Chunk* chunk     = state.chunk.get();
+        glm::ivec2 c_pos = state.request.pos;
+
+        double c_real_pos_x = c_pos.x * Chunk::chunk_size;
+        double c_real_pos_z = c_pos.y * Chunk::chunk_size;
+
+        uint32_t y_beg     = state.y_beg;
+        uint32_t layer_end = state.clamp_y(state.layer_end);
+
+        std::array<double, Chunk::chunk_size> row_b;
+        std::array<int32_t, Chunk::chunk_size> tile_x;
 
         double cave_peek_y = 35.3;
         double bias        = 13.3;
@@ -171,58 +363,546 @@ void WorldGen::gen_func_init()
 
         double clamp_max = bias2 / (bias + 1);
 
-        iterate_over_layers(chunk.get(), 1, layer_end, [&](Tile& t, uint32_t x, uint32_t y, uint32_t z) {
-            if (t != Tile::air)
+        auto [cave_origin, cave_size] = lattice_box(c_pos, y_beg, layer_end);
+
+        NoiseLattice caves_lattice(ng::sampler(caves), cave_lattice, cave_origin, cave_size);
+
+        auto threshold_at = [&](int32_t y) {
+            double dist_to_cave_peek = std::abs(y - cave_peek_y);
+
+            dist_to_cave_peek = std::min(dist_to_cave_peek, clamp_max);
+
+            // simpler (dist_to_cave_peek / bias - dist_to_cave_peek) / bias
+            return 0.3 - (dist_to_cave_peek / (bias2 - dist_to_cave_peek * bias));
+        };
+
+        // the fates of the cells in the band of cave_cell layers the rows are in, interpolated noise isn't bounded
+        constexpr int32_t cells = Chunk::chunk_size / cave_cell;
+
+        std::array<CellFate, cells * cells> fates;
+        fates.fill(CellFate::mixed);
+
+        bool use_bounds    = cave_bounds && caves_lattice.full_resolution();
+        uint32_t fate_band = UINT32_MAX;
+
+        auto update_fates = [&](uint32_t band) {
+            uint32_t band_beg = y_beg + band * cave_cell;
+            uint32_t band_end = std::min<uint32_t>(band_beg + cave_cell, layer_end);
+
+            double min_threshold = threshold_at(Chunk::column_y_to_real_y(band_beg));
+            double max_threshold = min_threshold;
+
+            for (uint32_t cy = band_beg + 1; cy < band_end; ++cy)
+            {
+                min_threshold = std::min(min_threshold, threshold_at(Chunk::column_y_to_real_y(cy)));
+                max_threshold = std::max(max_threshold, threshold_at(Chunk::column_y_to_real_y(cy)));
+            }
+
+            for (int32_t z = 0; z < cells; ++z)
+            {
+                for (int32_t x = 0; x < cells; ++x)
+                {
+                    double lo[3] = {c_real_pos_x + x * cave_cell, (double)Chunk::column_y_to_real_y(band_beg), c_real_pos_z + z * cave_cell};
+                    double hi[3] = {lo[0] + cave_cell - 1, (double)Chunk::column_y_to_real_y(band_end - 1), lo[2] + cave_cell - 1};
+
+                    NoiseBounds bounds = cave_noise.bounds(lo, hi);
+
+                    CellFate& fate = fates[z * cells + x];
+
+                    if (bounds.min > max_threshold)
+                        fate = CellFate::solid;
+                    else if (bounds.max <= min_threshold)
+                        fate = CellFate::carved;
+                    else
+                        fate = CellFate::mixed;
+                }
+            }
+        };
+
+        iterate_over_rows(chunk, y_beg, layer_end, [&](Tile* row, uint32_t cy, uint32_t z) {
+            if (use_bounds && (cy - y_beg) / cave_cell != fate_band)
             {
-                double real_x = c_real_pos_x + x;
-                double real_z = c_real_pos_z + z;
+                fate_band = (cy - y_beg) / cave_cell;
+                update_fates(fate_band);
+            }
+
+            const CellFate* row_fates = fates.data() + (z / cave_cell) * cells;
+
+            // only the solid tiles of mixed cells are sampled
+            uint32_t count = 0;
+            for (int x = 0; x < Chunk::chunk_size; ++x)
+            {
+                if (row[x] == Tile::air) continue;
 
-                double dist_to_cave_peek = std::abs(y - cave_peek_y);
+                CellFate fate = row_fates[x / cave_cell];
 
-                dist_to_cave_peek = std::min(dist_to_cave_peek, clamp_max);
+                if (fate == CellFate::carved)
+                    row[x] = Tile::air;
+                else if (fate == CellFate::mixed)
+                    tile_x[count++] = x;
+            }
+
+            if (count == 0) return;
+
+            caves_lattice.sample(cy - y_beg, z, tile_x.data(), count, row_b.data());
 
-                // simpler (dist_to_cave_peek / bias - dist_to_cave_peek) / bias
-                t = cave_noise.noise(real_x, y, real_z) > 0.3 - (dist_to_cave_peek / (bias2 - dist_to_cave_peek * bias)) ? t : Tile::air;
+            double threshold = threshold_at(Chunk::column_y_to_real_y(cy));
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                Tile& t = row[tile_x[i]];
+                t       = row_b[i] > threshold ? t : Tile::air;
             }
         });
 
-        return chunk;
+        chunk->update_occupancy();
     };
 }
 
+std::vector<WorldGen::BlockWrite> WorldGen::decorate(glm::ivec2 pos, const Chunk* const (&around)[9]) const
+{
+    std::vector<BlockWrite> writes;
+
+    const Chunk* chunk = around[4];
+    glm::ivec2 origin  = pos * Chunk::chunk_size;
+
+    // the carved tile at real x and z and column y, which may be in a neighbour
+    auto tile_at = [&](glm::ivec3 tile_pos) {
+        if (tile_pos.y < 0 || tile_pos.y >= Chunk::height) return Tile::air;
+
+        glm::ivec2 offset = Chunk::real_pos_to_chunk_pos(glm::ivec2(tile_pos.x, tile_pos.z)) - pos + 1;
+        glm::ivec3 in_chunk = Chunk::real_pos_to_in_chunk_pos(tile_pos);
+
+        return around[offset.y * 3 + offset.x]->get_block(in_chunk.x, tile_pos.y, in_chunk.z);
+    };
+
+    for (int32_t z = 0; z < Chunk::chunk_size; ++z)
+    {
+        for (int32_t x = 0; x < Chunk::chunk_size; ++x)
+        {
+            uint64_t hash = column_hash(m_seed, origin.x + x, origin.y + z);
+            if (hash % tree_rarity != 0) continue;
+
+            int32_t ground = static_cast<int32_t>(chunk->get_height(x, z)) - 1;
+            if (ground < 0 || chunk->get_block(x, ground, z) != Tile::grass) continue;
+
+            int32_t trunk = 4 + static_cast<int32_t>((hash >> 32) % 3);
+            if (ground + trunk + 2 >= Chunk::height) continue;
+
+            glm::ivec3 base(origin.x + x, ground, origin.y + z);
+
+            // trees only grow where their trunk and leaves have room, in this column or its neighbours
+            size_t first = writes.size();
+            bool room    = true;
+
+            auto place = [&](glm::ivec3 tile_pos, Tile t) {
+                room = room && tile_at(tile_pos) == Tile::air;
+                writes.push_back(BlockWrite{.pos = tile_pos, .tile = t});
+            };
+
+            for (int32_t y = 1; y <= trunk; ++y)
+                place(base + glm::ivec3(0, y, 0), Tile::wood_plank);
+
+            // two wide layers around the top of the trunk and two narrow ones above, without their corners but the third
+            for (int32_t dy = -1; dy <= 2; ++dy)
+            {
+                int32_t radius = dy <= 0 ? tree_reach : 1;
+
+                for (int32_t dz = -radius; dz <= radius; ++dz)
+                {
+                    for (int32_t dx = -radius; dx <= radius; ++dx)
+                    {
+                        bool corner = std::abs(dx) == radius && std::abs(dz) == radius;
+
+                        if (dx == 0 && dz == 0 && dy <= 0) continue;
+                        if (corner && dy != 1) continue;
+
+                        place(base + glm::ivec3(dx, trunk + dy, dz), Tile::leaf);
+                    }
+                }
+            }
+
+            if (!room) writes.resize(first);
+        }
+    }
+
+    return writes;
+}
+
 WorldGen::~WorldGen()
 {
     m_running = false;
-    in_chunk_poses.notify_all();
+    in_requests.close();
     out_chunks.notify_all();
+
+    // tasks already submitted return right away, the stage functions have to outlive them
+    auto guard = std::unique_lock(m_schedule_lock);
+    m_idle_cv.wait(guard, [this] { return m_active_tasks == 0; });
+}
+
+void WorldGen::init(int worker_count, TaskPool& pool)
+{
+    {
+        auto guard     = std::lock_guard(m_schedule_lock);
+        m_pool         = &pool;
+        m_worker_count = std::max(worker_count, 1);
+        m_running      = true;
+    }
+
+    schedule();
+}
+
+WorldGenStats WorldGen::stats() const
+{
+    auto guard = std::lock_guard(m_schedule_lock);
+
+    WorldGenStats stats = m_stats;
+    stats.protos        = m_protos.size();
+
+    return stats;
+}
+
+void WorldGen::schedule()
+{
+    auto guard = std::lock_guard(m_schedule_lock);
+    schedule_locked();
 }
 
-void WorldGen::init(int worker_count)
+void WorldGen::schedule_locked()
 {
-    m_running = true;
+    if (!m_running) return;
 
-    for (int i = 0; i < worker_count; ++i)
+    admit_locked();
+
+    for (; m_active_tasks < m_worker_count && m_ready.size(); m_ready.pop_front())
     {
-        m_workers.emplace_back([this] { worker_func(); });
+        m_active_tasks++;
+        m_pool->submit(TaskQoS::background, [this, step = m_ready.front()] { run_step(step); });
     }
 }
 
-void WorldGen::worker_func()
+void WorldGen::admit_locked()
 {
-    while (m_running)
+    // a few columns per worker keep them busy while the queue still decides what goes next
+    size_t max_in_flight = m_worker_count * 2 + 2;
+
+    std::vector<ChunkGenRequest> requests;
+
+    while (m_jobs.size() + m_direct_steps < max_in_flight && in_requests.fetch_available(requests, 1))
     {
-        std::vector<glm::ivec2> chunks_to_generate;
-        std::vector<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> generated_chunks;
+        ChunkGenRequest request = requests.back();
+        requests.pop_back();
+
+        if (request.end != Chunk::vertical_chunk_count)
+        {
+            m_direct_steps++;
+            m_ready.push_back(Step{.kind = StepKind::direct, .request = request});
+            continue;
+        }
+
+        // a column requested again while it generates is handed out once
+        if (!m_jobs.try_emplace(request.pos, request).second) continue;
+
+        // the columns the decorations around it need carved
+        int32_t reach = decorations ? 2 : 0;
 
-        in_chunk_poses.fetch_some_blocking(chunks_to_generate, m_max_batch_size);
-        if (!m_running) return;
+        for (int32_t z = -reach; z <= reach; ++z)
+            for (int32_t x = -reach; x <= reach; ++x)
+                proto_locked(request.pos + glm::ivec2(x, z)).refs++;
 
-        for (auto& chunk_to_gen : chunks_to_generate)
+        advance_job_locked(request.pos);
+    }
+}
+
+WorldGen::ProtoChunk& WorldGen::proto_locked(glm::ivec2 pos)
+{
+    ProtoChunk& proto = m_protos[pos];
+    proto.last_use    = ++m_use_counter;
+
+    return proto;
+}
+
+bool WorldGen::advance_tiles_locked(glm::ivec2 pos, uint32_t beg)
+{
+    ProtoChunk& proto = proto_locked(pos);
+
+    if (proto.stage == GenStage::carved && proto.beg <= beg) return true;
+    if (proto.busy) return false;
+
+    // generated for a neighbour that didn't need it as deep, it starts over once nothing reads it
+    if (proto.stage != GenStage::none && proto.beg > beg)
+    {
+        if (proto.readers) return false;
+
+        proto.state = nullptr;
+        proto.chunk = nullptr;
+        proto.stage = GenStage::none;
+    }
+
+    if (proto.stage == GenStage::none) proto.beg = beg;
+
+    proto.busy = true;
+    m_ready.push_back(Step{.kind = StepKind::stage, .request = ChunkGenRequest{.pos = pos, .beg = proto.beg}});
+
+    return false;
+}
+
+void WorldGen::advance_job_locked(glm::ivec2 pos)
+{
+    const ChunkGenRequest& job = m_jobs.at(pos);
+
+    int32_t reach  = decorations ? 1 : 0;
+    bool decorated = true;
+
+    for (int32_t z = -reach; z <= reach; ++z)
+    {
+        for (int32_t x = -reach; x <= reach; ++x)
         {
-            generated_chunks.emplace_back(chunk_to_gen, m_gen_func(chunk_to_gen));
+            glm::ivec2 center = pos + glm::ivec2(x, z);
+            ProtoChunk& proto = proto_locked(center);
+
+            if (!decorations || proto.features) continue;
+
+            decorated = false;
+            if (proto.busy) continue;
+
+            // the decoration reads the tiles of the neighbours, the ones it writes into wait for it in their finish step
+            bool carved = true;
+            for (int32_t dz = -1; dz <= 1; ++dz)
+                for (int32_t dx = -1; dx <= 1; ++dx)
+                    carved = advance_tiles_locked(center + glm::ivec2(dx, dz), job.beg) && carved;
+
+            if (!carved || proto.busy) continue;
+
+            for (int32_t dz = -1; dz <= 1; ++dz)
+                for (int32_t dx = -1; dx <= 1; ++dx)
+                    m_protos.at(center + glm::ivec2(dx, dz)).readers++;
+
+            proto.busy = true;
+            m_ready.push_back(Step{.kind = StepKind::decorate, .request = ChunkGenRequest{.pos = center}});
         }
+    }
+
+    if (!decorated || !advance_tiles_locked(pos, job.beg)) return;
+
+    ProtoChunk& proto = m_protos.at(pos);
+    if (proto.busy) return;
+
+    proto.busy = true;
+    m_ready.push_back(Step{.kind = StepKind::finish, .request = job});
+}
+
+void WorldGen::advance_jobs_around_locked(glm::ivec2 pos, int32_t reach)
+{
+    for (int32_t z = -reach; z <= reach; ++z)
+    {
+        for (int32_t x = -reach; x <= reach; ++x)
+        {
+            glm::ivec2 job_pos = pos + glm::ivec2(x, z);
+            if (m_jobs.contains(job_pos)) advance_job_locked(job_pos);
+        }
+    }
+}
+
+void WorldGen::evict_protos_locked()
+{
+    while (m_protos.size() > max_proto_chunks)
+    {
+        auto oldest = m_protos.end();
+
+        for (auto it = m_protos.begin(); it != m_protos.end(); ++it)
+        {
+            const ProtoChunk& proto = it->second;
+            if (proto.refs || proto.readers || proto.busy) continue;
+
+            if (oldest == m_protos.end() || proto.last_use < oldest->second.last_use) oldest = it;
+        }
+
+        // everything left is needed by a job
+        if (oldest == m_protos.end()) return;
 
-        if (generated_chunks.size())
-            out_chunks.push(std::move(generated_chunks));
+        m_protos.erase(oldest);
     }
 }
+
+void WorldGen::run_step(const Step& step)
+{
+    // steps submitted before the destructor only let it know they are done
+    if (m_running)
+    {
+        switch (step.kind)
+        {
+        case StepKind::direct:
+            run_direct(step.request);
+            break;
+        case StepKind::stage:
+            run_stage(step.request.pos);
+            break;
+        case StepKind::decorate:
+            run_decorate(step.request.pos);
+            break;
+        case StepKind::finish:
+            run_finish(step.request);
+            break;
+        }
+    }
+
+    // the steps it made ready go back through the pool, so more urgent tasks can run in between
+    auto guard = std::lock_guard(m_schedule_lock);
+
+    m_active_tasks--;
+    schedule_locked();
+
+    if (m_active_tasks == 0) m_idle_cv.notify_all();
+}
+
+void WorldGen::run_direct(const ChunkGenRequest& request)
+{
+    auto state = std::make_unique<ChunkGenState>();
+    state->request = request;
+
+    for (auto& stage_func : m_stage_funcs)
+        stage_func(*state);
+
+    // merged below a loaded chunk, the light engine lights them there
+    if (compress_chunks) state->chunk->compress();
+
+    out_chunks.push(std::make_pair(request.pos, std::move(state->chunk)));
+
+    auto guard = std::lock_guard(m_schedule_lock);
+    m_direct_steps--;
+    m_stats.direct++;
+}
+
+void WorldGen::run_stage(glm::ivec2 pos)
+{
+    ProtoChunk* proto;
+    uint32_t beg;
+
+    {
+        auto guard = std::lock_guard(m_schedule_lock);
+        proto      = &m_protos.at(pos);
+        beg        = proto->beg;
+    }
+
+    // the proto is busy, nothing else touches it until it is marked done below
+    if (proto->stage == GenStage::none)
+    {
+        proto->state          = std::make_unique<ChunkGenState>();
+        proto->state->request = ChunkGenRequest{.pos = pos, .beg = beg};
+    }
+
+    m_stage_funcs[static_cast<size_t>(proto->stage)](*proto->state);
+
+    bool carved = proto->stage == GenStage::surface;
+    if (carved)
+    {
+        proto->chunk = std::move(proto->state->chunk);
+        proto->state = nullptr;
+
+        // carved columns wait for their neighbours, paletted they take a fraction of the memory
+        if (compress_chunks) proto->chunk->compress();
+    }
+
+    auto guard = std::lock_guard(m_schedule_lock);
+
+    proto->stage = static_cast<GenStage>(static_cast<uint8_t>(proto->stage) + 1);
+    proto->busy  = false;
+    m_stats.stages++;
+
+    // the jobs whose decorations or finish step need the column
+    advance_jobs_around_locked(pos, decorations ? 2 : 0);
+}
+
+void WorldGen::run_decorate(glm::ivec2 pos)
+{
+    const Chunk* around[9];
+
+    {
+        auto guard = std::lock_guard(m_schedule_lock);
+
+        for (int32_t z = -1; z <= 1; ++z)
+            for (int32_t x = -1; x <= 1; ++x)
+                around[(z + 1) * 3 + x + 1] = m_protos.at(pos + glm::ivec2(x, z)).chunk.get();
+    }
+
+    auto features = decorate(pos, around);
+
+    auto guard = std::lock_guard(m_schedule_lock);
+
+    for (int32_t z = -1; z <= 1; ++z)
+        for (int32_t x = -1; x <= 1; ++x)
+            m_protos.at(pos + glm::ivec2(x, z)).readers--;
+
+    ProtoChunk& proto = m_protos.at(pos);
+    proto.features    = std::move(features);
+    proto.busy        = false;
+    m_stats.decorated++;
+
+    // a job may wait for the last reader of a neighbour to leave before it can generate it again deeper, that job is up
+    // to 2 columns from the neighbour
+    advance_jobs_around_locked(pos, 3);
+}
+
+void WorldGen::run_finish(const ChunkGenRequest& request)
+{
+    std::unique_ptr<Chunk> chunk;
+    const std::vector<BlockWrite>* features[9] = {};
+
+    {
+        auto guard = std::lock_guard(m_schedule_lock);
+
+        chunk = std::move(m_protos.at(request.pos).chunk);
+
+        // decorated features are never changed, only dropped along with their column once no job needs it
+        if (decorations)
+        {
+            for (int32_t z = -1; z <= 1; ++z)
+                for (int32_t x = -1; x <= 1; ++x)
+                    features[(z + 1) * 3 + x + 1] = &*m_protos.at(request.pos + glm::ivec2(x, z)).features;
+        }
+    }
+
+    // the writes of the column and its neighbours that land in it, always in the same order so the first one to reach a
+    // tile wins whatever order the decorations ran in
+    glm::ivec2 origin = request.pos * Chunk::chunk_size;
+
+    for (auto* writes : features)
+    {
+        if (writes == nullptr) continue;
+
+        for (const BlockWrite& write : *writes)
+        {
+            glm::ivec3 in_chunk = write.pos - glm::ivec3(origin.x, 0, origin.y);
+
+            if (in_chunk.x < 0 || in_chunk.x >= Chunk::chunk_size || in_chunk.z < 0 || in_chunk.z >= Chunk::chunk_size) continue;
+            if (chunk->get_block(in_chunk.x, in_chunk.y, in_chunk.z) != Tile::air) continue;
+
+            chunk->set_block(write.tile, in_chunk.x, in_chunk.y, in_chunk.z);
+        }
+    }
+
+    chunk->update_occupancy();
+    if (compress_chunks) chunk->compress();
+
+    LightEngine::light_chunk(chunk.get());
+
+    out_chunks.push(std::make_pair(request.pos, std::move(chunk)));
+
+    auto guard = std::lock_guard(m_schedule_lock);
+
+    ProtoChunk& proto = m_protos.at(request.pos);
+    proto.stage       = GenStage::none;
+    proto.busy        = false;
+
+    int32_t reach = decorations ? 2 : 0;
+
+    for (int32_t z = -reach; z <= reach; ++z)
+        for (int32_t x = -reach; x <= reach; ++x)
+            m_protos.at(request.pos + glm::ivec2(x, z)).refs--;
+
+    m_jobs.erase(request.pos);
+    m_stats.finished++;
+
+    evict_protos_locked();
+}
@@ -1,15 +1,50 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
-#include <thread>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 
+#include <glm/gtx/hash.hpp>
 #include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
 
 #include "../../util/concurent_queue.hpp"
+#include "../../util/task_pool.hpp"
 #include "chunk.hpp"
+#include "gen_queue.hpp"
 
+class ClimateMap;
+struct ChunkGenState;
+
+// the stages a column goes through on its own, decoration and the finish step that hands it out also need its
+// neighbours to be through them
+enum class GenStage : uint8_t
+{
+    none,
+    terrain,
+    surface,
+    carved,
+};
+
+struct WorldGenStats
+{
+    size_t stages;    // terrain, surface and carve steps run, columns dropped and needed again run them again
+    size_t decorated; // columns decorated
+    size_t finished;  // whole columns handed out
+    size_t direct;    // partial columns, generated in one step
+    size_t protos;    // columns held by the pipeline
+};
+
+// generates whole columns as a graph of steps: terrain, surface and carve per column, then decoration once the
+// column and its 8 neighbours are carved, and the finish step that applies the tiles the decorations around it wrote
+// and hands it out once all of them are decorated. steps run as soon as what they need is done, there is no barrier
+// across the world
 class WorldGen
 {
     WorldGen(const WorldGen&) = delete;
@@ -17,22 +52,130 @@ public:
     WorldGen(uint64_t seed);
     ~WorldGen();
 
-    void init(int worker_count = 1);
+    // generates on the workers of the pool, at most worker_count steps at once
+    void init(int worker_count = 1, TaskPool& pool = TaskPool::shared());
+
+    // shared by the workers, biomes can be looked up through it while chunks generate
+    ClimateMap& climate() { return *m_climate; }
+
+    WorldGenStats stats() const;
 
 public:
-    ConcurentQueue<glm::ivec2> in_chunk_poses;
+    // generated chunks are converted to paletted storage before they are handed out
+    bool compress_chunks = true;
+
+    // spacing in tiles of the lattices the warp of the terrain and the cave noise are sampled on and interpolated
+    // between, 1 along every axis samples every tile. set before init
+    glm::ivec3 warp_lattice = {1, 1, 1};
+    glm::ivec3 cave_lattice = {1, 1, 1};
+
+    // skips sampling the cave noise over cells it provably can't carve or has to carve whole, the result is the same
+    bool cave_bounds = true;
+
+    // trees, which reach into the neighbours of their column. without them whole columns are handed out right after
+    // they are carved and don't need their neighbours. set before init
+    bool decorations = true;
+
+    // the columns kept for the decoration of their neighbours or the ones that need them, past this many the least
+    // recently used ones nothing waits for are dropped
+    size_t max_proto_chunks = 1024;
+
+    // the closest requests to the focus of the queue are generated first
+    GenQueue in_requests;
     ConcurentQueue<std::pair<glm::ivec2, std::unique_ptr<Chunk>>> out_chunks;
 
 private:
-    void worker_func();
-    void gen_func_init();
+    // a tile written by the decoration of a column at real x and z and column y, it only replaces air
+    struct BlockWrite
+    {
+        glm::ivec3 pos;
+        Tile tile;
+    };
+
+    // a column on its way through the stages. they are kept after being handed out or when only their neighbours
+    // need them, everything about them can be generated again once they are dropped
+    struct ProtoChunk
+    {
+        // between the terrain and the carve steps
+        std::unique_ptr<ChunkGenState> state;
+        // the tiles once carved, up to the finish step
+        std::unique_ptr<Chunk> chunk;
+        GenStage stage = GenStage::none;
+        uint32_t beg   = 0;
+
+        // what its decoration wrote into it and its neighbours
+        std::optional<std::vector<BlockWrite>> features;
+
+        bool busy        = false; // a step is queued or running on it
+        uint32_t readers = 0;     // decorations of its neighbours reading its tiles
+        uint32_t refs    = 0;     // jobs it is within 2 columns of
+        uint64_t last_use = 0;
+    };
+
+    enum class StepKind : uint8_t
+    {
+        direct,   // a partial column, all stages at once
+        stage,    // the next stage of a column
+        decorate,
+        finish,
+    };
+
+    struct Step
+    {
+        StepKind kind;
+        ChunkGenRequest request;
+    };
+
+    // a task of the pool, runs a step and submits the ones it made ready
+    void run_step(const Step& step);
+    void run_direct(const ChunkGenRequest& request);
+    void run_stage(glm::ivec2 pos);
+    void run_decorate(glm::ivec2 pos);
+    void run_finish(const ChunkGenRequest& request);
+
+    // submits tasks while there are ready steps and fewer than m_worker_count are running
+    void schedule();
+    void schedule_locked();
+    void stage_funcs_init();
+
+    // the rest is called under m_schedule_lock
+    // takes requests from the queue while few enough are in flight
+    void admit_locked();
+    // queues the steps the job at pos can take next
+    void advance_job_locked(glm::ivec2 pos);
+    // the jobs within reach of pos, the ones a change to the column at pos may be holding up
+    void advance_jobs_around_locked(glm::ivec2 pos, int32_t reach);
+    // queues the next stage of the column unless it is carved from beg down already, returns whether it is
+    bool advance_tiles_locked(glm::ivec2 pos, uint32_t beg);
+    void evict_protos_locked();
+    ProtoChunk& proto_locked(glm::ivec2 pos);
+
+    // the tiles the decoration of the column places, its 8 neighbours are carved
+    std::vector<BlockWrite> decorate(glm::ivec2 pos, const Chunk* const (&around)[9]) const;
 
 private:
-    std::atomic_bool m_running;
+    std::atomic_bool m_running = false;
 
-    const uint32_t m_max_batch_size = 4;
     const uint64_t m_seed;
 
-    std::vector<std::jthread> m_workers;
-    std::function<std::unique_ptr<Chunk>(glm::ivec2)> m_gen_func;
+    std::unique_ptr<ClimateMap> m_climate;
+
+    TaskPool* m_pool        = nullptr;
+    uint32_t m_worker_count = 0;
+
+    // submitted tasks, the destructor waits for them
+    mutable std::mutex m_schedule_lock;
+    std::condition_variable m_idle_cv;
+    uint32_t m_active_tasks = 0;
+
+    // the whole columns being generated by position, and the columns they need
+    std::unordered_map<glm::ivec2, ChunkGenRequest> m_jobs;
+    std::unordered_map<glm::ivec2, ProtoChunk> m_protos;
+    std::deque<Step> m_ready;
+    uint32_t m_direct_steps = 0;
+    uint64_t m_use_counter = 0;
+    WorldGenStats m_stats  = {};
+
+    // terrain, surface and carve, each picks up the state the one before left
+    std::array<std::function<void(ChunkGenState&)>, 3> m_stage_funcs;
 };
\ No newline at end of file
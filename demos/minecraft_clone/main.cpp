@@ -1,9 +1,14 @@
 #include <fmt/format.h>
 
+#include <string_view>
+
+#include "bench/bench.hpp"
 #include "game/game.hpp"
 
-int main()
+int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string_view(argv[1]) == "bench") return run_benchmarks(argc - 2, argv + 2);
+
     Game game;
     game.run();
 }
\ No newline at end of file
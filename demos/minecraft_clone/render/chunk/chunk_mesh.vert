@@ -49,12 +49,14 @@ void main()
 
     vec4 position;
 
-    position.x = float((vertex_data >> 10) & 31);  //0b11111
-    position.y = float((vertex_data >> 05) & 31);  //0b11111
-    position.z = float((vertex_data >> 00) & 31);  //0b11111
+    const uint pos_mask = (1u << VERT_POS_BITS) - 1u;
+
+    position.x = float((vertex_data >> (2 * VERT_POS_BITS)) & pos_mask);
+    position.y = float((vertex_data >> VERT_POS_BITS) & pos_mask);
+    position.z = float((vertex_data >> 0) & pos_mask);
     position.w = 1.0;
 
-    uint corner = (vertex_data >> 15) & 7; // 0b111
+    uint corner = (vertex_data >> VERT_CORNER_SHIFT) & 7; // 0b111
 
     position.x += float((corner >> 2) & 1);
     position.y += float((corner >> 1) & 1);
@@ -63,7 +65,7 @@ void main()
 
 #ifndef SHADOW_PASS
 
-    uint plane_bits = (vertex_data >> 18) & 3; //0b11
+    uint plane_bits = (vertex_data >> VERT_PLANE_SHIFT) & 3; //0b11
 
     vec3 normal = vec3(0.0,0.0,0.0);
     normal[plane_bits] =  normal_table[corner][plane_bits];
@@ -71,7 +73,7 @@ void main()
     out_normal = normal;
 
     out_tex_pos = vec2(position[first_comp[plane_bits]],position[second_comp[plane_bits]]);
-    out_tex_id = float((vertex_data >> 20) & 31);
+    out_tex_id = float((vertex_data >> VERT_TEXTURE_SHIFT) & 31);
 
 #endif
 
@@ -79,7 +81,7 @@ void main()
     //a block face ranges in -0.5 to 0.5
     position.xyz += vec3(-0.5,-0.5,-0.5);
 
-    position.xyz += unpack_chunk_pos(draw_buffer.packed_chunk_poses[push.cpos_offset + gl_DrawID]) * 32.0;
+    position.xyz += unpack_chunk_pos(draw_buffer.packed_chunk_poses[push.cpos_offset + gl_DrawID]) * float(CHUNK_SIZE);
 
     gl_Position = push.proj_view * position;
     // gl_Position.y = -gl_Position.y;
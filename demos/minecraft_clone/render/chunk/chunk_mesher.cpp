@@ -1,5 +1,7 @@
 #include "chunk_mesher.hpp"
 
+#include "chunk_shared.hpp"
+
 #include <math.h>
 
 #include <fmt/format.h>
@@ -9,9 +11,98 @@
 
 namespace
 {
-const Tile empty_vertical_chunk[Chunk::chunk_volume] = {};
+// faces[dir][x + z * chunk_size] has bit y set if the tile has a visible face in dir
+using FaceMasks = std::array<Chunk::Occupancy, 6>;
+
+// a face is visible if its tile is solid and the facing one isn't. the masks of the neighbors cover the outer planes
+void build_face_masks(const ChunkSnapshot& snapshot, FaceMasks& faces)
+{
+    constexpr int32_t size = Chunk::chunk_size;
+
+    const auto& solid = snapshot.get_occupancy();
+
+    const Chunk::Occupancy* neighbors[6];
+    for (int dir = 0; dir < 6; ++dir)
+        neighbors[dir] = &snapshot.get_occupancy_of_neighbor((TileFacing)dir);
+
+    for (int32_t z = 0; z < size; ++z)
+    {
+        for (int32_t x = 0; x < size; ++x)
+        {
+            int32_t i = x + z * size;
+
+            Chunk::ColumnMask xp = x < size - 1 ? solid[i + 1] : (*neighbors[(int)TileFacing::xp])[i - (size - 1)];
+            Chunk::ColumnMask xn = x > 0 ? solid[i - 1] : (*neighbors[(int)TileFacing::xn])[i + (size - 1)];
+            Chunk::ColumnMask zp = z < size - 1 ? solid[i + size] : (*neighbors[(int)TileFacing::zp])[i - (size - 1) * size];
+            Chunk::ColumnMask zn = z > 0 ? solid[i - size] : (*neighbors[(int)TileFacing::zn])[i + (size - 1) * size];
+            Chunk::ColumnMask yp = (solid[i] >> 1) | ((*neighbors[(int)TileFacing::yp])[i] << (size - 1));
+            Chunk::ColumnMask yn = (solid[i] << 1) | ((*neighbors[(int)TileFacing::yn])[i] >> (size - 1));
+
+            faces[(int)TileFacing::xp][i] = solid[i] & ~xp;
+            faces[(int)TileFacing::xn][i] = solid[i] & ~xn;
+            faces[(int)TileFacing::yp][i] = solid[i] & ~yp;
+            faces[(int)TileFacing::yn][i] = solid[i] & ~yn;
+            faces[(int)TileFacing::zp][i] = solid[i] & ~zp;
+            faces[(int)TileFacing::zn][i] = solid[i] & ~zn;
+        }
+    }
+}
+
+// one bit per plane of dir that has any visible face
+Chunk::ColumnMask layers_with_faces(const Chunk::Occupancy& faces, TileFacing dir)
+{
+    Chunk::ColumnMask layers = 0;
+
+    for (int32_t i = 0; i < Chunk::chunk_surface_area; ++i)
+    {
+        switch (dir)
+        {
+        case TileFacing::xp:
+        case TileFacing::xn:
+            layers |= (Chunk::ColumnMask)(faces[i] != 0) << (i % Chunk::chunk_size);
+            break;
+        case TileFacing::yp:
+        case TileFacing::yn:
+            layers |= faces[i];
+            break;
+        case TileFacing::zp:
+        case TileFacing::zn:
+            layers |= (Chunk::ColumnMask)(faces[i] != 0) << (i / Chunk::chunk_size);
+            break;
+        }
+    }
+
+    return layers;
+}
+
+// bit x is set if the tile at x of row y of the plane has a visible face
+Chunk::ColumnMask visible_row(const Chunk::Occupancy& faces, uint32_t layer, uint32_t y, TileFacing dir)
+{
+    Chunk::ColumnMask row = 0;
 
-bool create_plane(TextureID* out_plane, const Chunk* chunk, uint32_t vertical_chunk_index, uint32_t layer, const TextureID* texture_id_lookup, TileFacing dir)
+    switch (dir)
+    {
+    case TileFacing::xp:
+    case TileFacing::xn:
+        // rows run along the columns
+        return faces[layer + y * Chunk::chunk_size];
+    case TileFacing::yp:
+    case TileFacing::yn:
+        for (uint32_t x = 0; x < Chunk::chunk_size; ++x)
+            row |= (Chunk::ColumnMask)((faces[x + y * Chunk::chunk_size] >> layer) & 1) << x;
+        return row;
+    case TileFacing::zp:
+    case TileFacing::zn:
+        for (uint32_t x = 0; x < Chunk::chunk_size; ++x)
+            row |= (Chunk::ColumnMask)((faces[x + layer * Chunk::chunk_size] >> y) & 1) << x;
+        return row;
+    }
+
+    return row;
+}
+
+// faces are the face masks of the vertical chunk in dir
+bool create_plane(TextureID* out_plane, const Tile* tiles, const Chunk::Occupancy& faces, uint32_t layer, const TextureID* texture_id_lookup, TileFacing dir)
 {
 
     int32_t x_offset;
@@ -23,7 +114,7 @@ bool create_plane(TextureID* out_plane, const Chunk* chunk, uint32_t vertical_ch
     {
         int32_t x_offset_table[] = {Chunk::chunk_surface_area, Chunk::chunk_surface_area, 1, 1, 1, 1};
         int32_t y_offset_table[] = {Chunk::chunk_size, Chunk::chunk_size, Chunk::chunk_size, Chunk::chunk_size, Chunk::chunk_surface_area, Chunk::chunk_surface_area};
-        int32_t z_offset_table[] = {1, -1, Chunk::chunk_surface_area, -Chunk::chunk_surface_area, Chunk::chunk_size, -Chunk::chunk_size};
+        int32_t z_offset_table[] = {1, 1, Chunk::chunk_surface_area, Chunk::chunk_surface_area, Chunk::chunk_size, Chunk::chunk_size};
 
         x_offset = x_offset_table[(int)dir];
         y_offset = y_offset_table[(int)dir];
@@ -32,36 +123,17 @@ bool create_plane(TextureID* out_plane, const Chunk* chunk, uint32_t vertical_ch
 
     TextureID* out_plane_it = out_plane;
 
-    const Tile* tile_it = chunk->get_tile_array(vertical_chunk_index) + layer * std::abs(z_offset);
-
-    int32_t facing_plane_layer = layer + z_offset / std::abs(z_offset);
-
-    const Tile* facing_tile_it = tile_it + z_offset;
-
-    if (facing_plane_layer < 0)
-    {
-
-        facing_tile_it = chunk->get_tile_array_of_neighbor(vertical_chunk_index, dir);
-
-        if (facing_tile_it == nullptr) facing_tile_it = empty_vertical_chunk;
-
-        facing_tile_it += std::abs(z_offset) * (Chunk::chunk_size - 1);
-    }
-    else if (facing_plane_layer >= Chunk::chunk_size)
-    {
-        facing_tile_it = chunk->get_tile_array_of_neighbor(vertical_chunk_index, dir);
-
-        if (facing_tile_it == nullptr) facing_tile_it = empty_vertical_chunk;
-    }
+    const Tile* tile_it = tiles + layer * z_offset;
 
     for (int y = 0; y < Chunk::chunk_size; ++y)
     {
+        Chunk::ColumnMask visible = visible_row(faces, layer, y, dir);
 
         for (int x = 0; x < Chunk::chunk_size; ++x)
         {
             TextureID tile_texture = texture_id_lookup[(uint32_t)tile_it[x * x_offset]];
 
-            tile_texture *= facing_tile_it[x * x_offset] == Tile::air;
+            tile_texture *= (visible >> x) & 1;
 
             texture_or |= tile_texture;
 
@@ -70,7 +142,6 @@ bool create_plane(TextureID* out_plane, const Chunk* chunk, uint32_t vertical_ch
 
         out_plane_it += Chunk::chunk_size;
         tile_it += y_offset;
-        facing_tile_it += y_offset;
     }
 
     return texture_or != 0;
@@ -85,9 +156,13 @@ struct Group
     TextureID t_id;
 };
 
+static_assert(VERT_TEXTURE_SHIFT + 5 <= 32, "quad vertices have no room for the texture");
+
 constexpr uint32_t compress_vec(glm::ivec3 vec)
 {
-    return ((vec.x & 0x1f) << 10) | ((vec.y & 0x1f) << 5) | ((vec.z & 0x1f) << 0);
+    constexpr uint32_t mask = (1u << VERT_POS_BITS) - 1;
+
+    return ((vec.x & mask) << (2 * VERT_POS_BITS)) | ((vec.y & mask) << VERT_POS_BITS) | ((vec.z & mask) << 0);
 }
 
 template <TileFacing dir>
@@ -110,28 +185,28 @@ inline void append_mesh_from_groups(Group* group_start, Group* group_end, Quad*&
         auto& quad_ = *(quad_it++);
 
         constexpr uint32_t dir_to_plane_bits_table[6] = {
-            0 << 18, // xp
-            0 << 18, // xn
-            1 << 18, // yp
-            1 << 18, // yn
-            2 << 18, // zp
-            2 << 18, // zn
+            0 << VERT_PLANE_SHIFT, // xp
+            0 << VERT_PLANE_SHIFT, // xn
+            1 << VERT_PLANE_SHIFT, // yp
+            1 << VERT_PLANE_SHIFT, // yn
+            2 << VERT_PLANE_SHIFT, // zp
+            2 << VERT_PLANE_SHIFT, // zn
         };
 
         constexpr uint32_t plane_bits = dir_to_plane_bits_table[(size_t)dir];
 
         // if(group.t_id != 1) {std::cout << "errr\n";}
 
-        uint32_t texture_id = group.t_id << 20;
+        uint32_t texture_id = group.t_id << VERT_TEXTURE_SHIFT;
 
         uint32_t quad_verts[4] = {texture_id, texture_id, texture_id, texture_id};
 
         if constexpr (dir == TileFacing::yp)
         {
-            constexpr uint32_t bottom_left_corner_bits  = (0b010 << 15) | plane_bits;
-            constexpr uint32_t bottom_right_corner_bits = (0b110 << 15) | plane_bits;
-            constexpr uint32_t top_left_corner_bits     = (0b011 << 15) | plane_bits;
-            constexpr uint32_t top_right_corner_bits    = (0b111 << 15) | plane_bits;
+            constexpr uint32_t bottom_left_corner_bits  = (0b010 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t bottom_right_corner_bits = (0b110 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_left_corner_bits     = (0b011 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_right_corner_bits    = (0b111 << VERT_CORNER_SHIFT) | plane_bits;
 
             quad_verts[0] |= bottom_left_corner_bits | compress_vec({group.start_x, plane_index, group.start_y});
             quad_verts[2] |= top_left_corner_bits | compress_vec({group.start_x, plane_index, group.end_y});
@@ -140,10 +215,10 @@ inline void append_mesh_from_groups(Group* group_start, Group* group_end, Quad*&
         }
         else if constexpr (dir == TileFacing::yn)
         {
-            constexpr uint32_t bottom_left_corner_bits  = (0b000 << 15) | plane_bits;
-            constexpr uint32_t bottom_right_corner_bits = (0b100 << 15) | plane_bits;
-            constexpr uint32_t top_left_corner_bits     = (0b001 << 15) | plane_bits;
-            constexpr uint32_t top_right_corner_bits    = (0b101 << 15) | plane_bits;
+            constexpr uint32_t bottom_left_corner_bits  = (0b000 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t bottom_right_corner_bits = (0b100 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_left_corner_bits     = (0b001 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_right_corner_bits    = (0b101 << VERT_CORNER_SHIFT) | plane_bits;
 
             quad_verts[0] |= bottom_left_corner_bits | compress_vec({group.start_x, plane_index, group.start_y});
             quad_verts[1] |= top_left_corner_bits | compress_vec({group.start_x, plane_index, group.end_y});
@@ -152,10 +227,10 @@ inline void append_mesh_from_groups(Group* group_start, Group* group_end, Quad*&
         }
         if constexpr (dir == TileFacing::zp)
         {
-            constexpr uint32_t bottom_left_corner_bits  = (0b001 << 15) | plane_bits;
-            constexpr uint32_t bottom_right_corner_bits = (0b101 << 15) | plane_bits;
-            constexpr uint32_t top_left_corner_bits     = (0b011 << 15) | plane_bits;
-            constexpr uint32_t top_right_corner_bits    = (0b111 << 15) | plane_bits;
+            constexpr uint32_t bottom_left_corner_bits  = (0b001 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t bottom_right_corner_bits = (0b101 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_left_corner_bits     = (0b011 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_right_corner_bits    = (0b111 << VERT_CORNER_SHIFT) | plane_bits;
 
             quad_verts[0] |= bottom_left_corner_bits | compress_vec({group.start_x, group.start_y, plane_index});
             quad_verts[1] |= top_left_corner_bits | compress_vec({group.start_x, group.end_y, plane_index});
@@ -164,10 +239,10 @@ inline void append_mesh_from_groups(Group* group_start, Group* group_end, Quad*&
         }
         else if constexpr (dir == TileFacing::zn)
         {
-            constexpr uint32_t bottom_left_corner_bits  = (0b000 << 15) | plane_bits;
-            constexpr uint32_t bottom_right_corner_bits = (0b100 << 15) | plane_bits;
-            constexpr uint32_t top_left_corner_bits     = (0b010 << 15) | plane_bits;
-            constexpr uint32_t top_right_corner_bits    = (0b110 << 15) | plane_bits;
+            constexpr uint32_t bottom_left_corner_bits  = (0b000 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t bottom_right_corner_bits = (0b100 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_left_corner_bits     = (0b010 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_right_corner_bits    = (0b110 << VERT_CORNER_SHIFT) | plane_bits;
 
             quad_verts[0] |= bottom_left_corner_bits | compress_vec({group.start_x, group.start_y, plane_index});
             quad_verts[2] |= top_left_corner_bits | compress_vec({group.start_x, group.end_y, plane_index});
@@ -176,10 +251,10 @@ inline void append_mesh_from_groups(Group* group_start, Group* group_end, Quad*&
         }
         if constexpr (dir == TileFacing::xp)
         {
-            constexpr uint32_t bottom_left_corner_bits  = (0b100 << 15) | plane_bits;
-            constexpr uint32_t bottom_right_corner_bits = (0b110 << 15) | plane_bits;
-            constexpr uint32_t top_left_corner_bits     = (0b101 << 15) | plane_bits;
-            constexpr uint32_t top_right_corner_bits    = (0b111 << 15) | plane_bits;
+            constexpr uint32_t bottom_left_corner_bits  = (0b100 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t bottom_right_corner_bits = (0b110 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_left_corner_bits     = (0b101 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_right_corner_bits    = (0b111 << VERT_CORNER_SHIFT) | plane_bits;
 
             quad_verts[0] |= bottom_left_corner_bits | compress_vec({plane_index, group.start_x, group.start_y});
             quad_verts[1] |= top_left_corner_bits | compress_vec({plane_index, group.start_x, group.end_y});
@@ -188,10 +263,10 @@ inline void append_mesh_from_groups(Group* group_start, Group* group_end, Quad*&
         }
         else if constexpr (dir == TileFacing::xn)
         {
-            constexpr uint32_t bottom_left_corner_bits  = (0b000 << 15) | plane_bits;
-            constexpr uint32_t bottom_right_corner_bits = (0b010 << 15) | plane_bits;
-            constexpr uint32_t top_left_corner_bits     = (0b001 << 15) | plane_bits;
-            constexpr uint32_t top_right_corner_bits    = (0b011 << 15) | plane_bits;
+            constexpr uint32_t bottom_left_corner_bits  = (0b000 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t bottom_right_corner_bits = (0b010 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_left_corner_bits     = (0b001 << VERT_CORNER_SHIFT) | plane_bits;
+            constexpr uint32_t top_right_corner_bits    = (0b011 << VERT_CORNER_SHIFT) | plane_bits;
 
             quad_verts[0] |= bottom_left_corner_bits | compress_vec({plane_index, group.start_x, group.start_y});
             quad_verts[2] |= top_left_corner_bits | compress_vec({plane_index, group.start_x, group.end_y});
@@ -322,7 +397,7 @@ void mesh_plane(const TextureID* plane, TileFacing dir, uint32_t layer, Quad*& q
 
 }; // namespace
 
-bool mesh_vertical_chunk(const Chunk* chunk, size_t vertical_index, Quad*& quad_buf_it, Quad* quad_buf_end)
+bool mesh_vertical_chunk(const ChunkSnapshot& snapshot, Quad*& quad_buf_it, Quad* quad_buf_end)
 {
     // BENCHMARK_FUNCTION();
 
@@ -330,7 +405,20 @@ bool mesh_vertical_chunk(const Chunk* chunk, size_t vertical_index, Quad*& quad_
 
     // try
     // {
-        if (chunk->get_tile_array(vertical_index) == nullptr) return false;
+        // no quads, the caller drops the mesh of tiles that were all removed
+        if (snapshot.is_empty()) return true;
+
+        // a paletted vertical chunk is unpacked into this while meshing, the neighbors are only read through their occupancy
+        thread_local Tile scratch[Chunk::chunk_volume];
+        thread_local FaceMasks faces;
+
+        const Tile* tiles = snapshot.read_tile_array(scratch);
+
+        build_face_masks(snapshot, faces);
+
+        Chunk::ColumnMask layers[6];
+        for (int dir = 0; dir < 6; ++dir)
+            layers[dir] = layers_with_faces(faces[dir], (TileFacing)dir);
 
         TextureID plane_buf[Chunk::chunk_surface_area];
 
@@ -338,10 +426,10 @@ bool mesh_vertical_chunk(const Chunk* chunk, size_t vertical_index, Quad*& quad_
         {
             for (int i = 0; i < Chunk::chunk_size; ++i)
             {
-                if (create_plane(plane_buf, chunk, vertical_index, i, tile_texture_table, (TileFacing)dir))
+                if ((layers[dir] >> i) & 1 && create_plane(plane_buf, tiles, faces[dir], i, tile_texture_table, (TileFacing)dir))
                     mesh_plane(plane_buf, (TileFacing)dir, i, quad_buf_it, quad_buf_end);
 
-                if (create_plane(plane_buf, chunk, vertical_index, i, tile_texture_table, (TileFacing)(dir + 1)))
+                if ((layers[dir + 1] >> i) & 1 && create_plane(plane_buf, tiles, faces[dir + 1], i, tile_texture_table, (TileFacing)(dir + 1)))
                     mesh_plane(plane_buf, (TileFacing)(dir + 1), i, quad_buf_it, quad_buf_end);
             }
         }
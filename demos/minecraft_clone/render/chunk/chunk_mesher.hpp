@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../../game/world/chunk.hpp"
+#include "../../game/world/chunk_snapshot.hpp"
 
 #include <vke/pipeline_builder.hpp>
 
@@ -18,4 +18,5 @@ struct Quad
     static constexpr int vert_count = 4;
 };
 
-bool mesh_vertical_chunk(const Chunk* chunk,size_t vertical_index,Quad*& quad_buf_it,Quad* quad_buf_end);
\ No newline at end of file
+// reads nothing but the snapshot, so it may run on any thread. empty vertical chunks mesh to no quads
+bool mesh_vertical_chunk(const ChunkSnapshot& snapshot, Quad*& quad_buf_it, Quad* quad_buf_end);
\ No newline at end of file
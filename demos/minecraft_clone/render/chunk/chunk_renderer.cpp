@@ -16,6 +16,9 @@
 
 #include "chunk_shared.hpp"
 
+// vertical chunk positions have to fit the 8 bits pack_chunk_gpudata keeps for them
+static_assert(Chunk::min_vertical_chunk >= -128 && Chunk::min_vertical_chunk + Chunk::vertical_chunk_count <= 128);
+
 namespace
 {
 struct Push
@@ -74,6 +77,13 @@ public:
         m_vchunks.erase(pos);
     }
 
+    // allocation is a bump pointer, so space is only reclaimed once every mesh is freed
+    void reset()
+    {
+        assert(m_vchunks.empty());
+        m_top = 0;
+    }
+
     uint32_t get_chunk_count()
     {
         return m_vchunks.size();
@@ -228,7 +238,17 @@ uint32_t ChunkRenderer::register_chunk(glm::ivec3 pos)
         return it->second.chunk_id;
     }
 
-    uint32_t id = m_chunk_id_counter++;
+    uint32_t id;
+
+    if (m_free_chunk_ids.size())
+    {
+        id = m_free_chunk_ids.back();
+        m_free_chunk_ids.pop_back();
+    }
+    else
+    {
+        id = m_chunk_id_counter++;
+    }
 
     m_chunk_meshes[pos] = ChunkMeshData{
         .chunk_id = id,
@@ -245,14 +265,6 @@ uint32_t ChunkRenderer::set_chunk_mesh(glm::ivec3 pos, MeshBuffer* mb, uint32_t
 
     uint32_t mb_id = mb->get_mesh_buffer_id();
 
-    uint32_t stencil_id = m_chunk_data_stencil_top++;
-
-    m_chunk_data_transfers.push_back(VkBufferCopy{
-        .srcOffset = stencil_id * sizeof(glm::uvec4),
-        .dstOffset = cdata.chunk_id * sizeof(glm::uvec4),
-        .size      = sizeof(glm::uvec4),
-    });
-
     glsl::ChunkGPUData pcdata{
         .pos  = pos,
         .mesh = {
@@ -264,7 +276,7 @@ uint32_t ChunkRenderer::set_chunk_mesh(glm::ivec3 pos, MeshBuffer* mb, uint32_t
 
     glm::uvec4 packed = glsl::pack_chunk_gpudata(pcdata);
 
-    get_current_frame().chunk_data_stencil->get_data<glm::uvec4>()[stencil_id] = packed;
+    write_chunk_gpudata(cdata.chunk_id, packed);
 
     if (auto bb = glsl::unpack_chunk_pos(packed); bb != pos)
     {
@@ -281,6 +293,19 @@ uint32_t ChunkRenderer::set_chunk_mesh(glm::ivec3 pos, MeshBuffer* mb, uint32_t
     return cdata.chunk_id;
 }
 
+void ChunkRenderer::write_chunk_gpudata(uint32_t chunk_id, glm::uvec4 packed)
+{
+    uint32_t stencil_id = m_chunk_data_stencil_top++;
+
+    m_chunk_data_transfers.push_back(VkBufferCopy{
+        .srcOffset = stencil_id * sizeof(glm::uvec4),
+        .dstOffset = chunk_id * sizeof(glm::uvec4),
+        .size      = sizeof(glm::uvec4),
+    });
+
+    get_current_frame().chunk_data_stencil->get_data<glm::uvec4>()[stencil_id] = packed;
+}
+
 ChunkRenderer::ChunkMeshStencil* ChunkRenderer::barrow_chunkmesh_stencil()
 {
     return get_current_frame().chunk_mesh_stencil.get();
@@ -290,7 +315,7 @@ void ChunkRenderer::return_chunkmesh_stencil(ChunkMeshStencil* mb)
 {
 }
 
-void ChunkRenderer::mesh_vchunk(const Chunk* chunk, int vertical)
+void ChunkRenderer::mesh_vchunk(const ChunkSnapshot& snapshot)
 {
     auto& current_frame = get_current_frame();
 
@@ -299,18 +324,23 @@ void ChunkRenderer::mesh_vchunk(const Chunk* chunk, int vertical)
     Quad* buf_start = cm_stencil->buffer->get_data<Quad>() + cm_stencil->buffer_top;
     Quad* it        = buf_start;
 
-    if (!mesh_vertical_chunk(chunk, vertical, it, cm_stencil->buffer->get_data_end<Quad>())) return;
+    if (!mesh_vertical_chunk(snapshot, it, cm_stencil->buffer->get_data_end<Quad>())) return;
 
     uint32_t vert_count = (it - buf_start) * 4;
 
-    if (vert_count == 0) return;
+    auto cpos = snapshot.pos();
 
-    auto cpos = glm::ivec3(chunk->x(), vertical, chunk->z());
+    // an edit may have removed the last visible face
+    if (vert_count == 0)
+    {
+        release_vchunk(cpos);
+        return;
+    }
 
-    if (auto it = m_chunk_meshes.find(cpos); it != m_chunk_meshes.end())
-        it->second.mesh_buffer->free_chunkmesh(cpos);
-    else
+    if (auto it = m_chunk_meshes.find(cpos); it == m_chunk_meshes.end())
         register_chunk(cpos);
+    else if (auto* mb = it->second.mesh_buffer) // null while the previous mesh waits for upload
+        mb->free_chunkmesh(cpos);
 
     cm_stencil->meshes.push_back(ChunkMeshStencil::ReadyMeshes{
         .pos         = cpos,
@@ -325,8 +355,37 @@ void ChunkRenderer::mesh_chunk(const Chunk* chunk)
 {
     for (int i = 0; i < Chunk::vertical_chunk_count; ++i)
     {
-        mesh_vchunk(chunk, i);
+        mesh_vchunk(ChunkSnapshot(chunk, i));
+    }
+}
+
+void ChunkRenderer::release_chunk(glm::ivec2 pos)
+{
+    for (int i = 0; i < Chunk::vertical_chunk_count; ++i)
+        release_vchunk(glm::ivec3(pos.x, i + Chunk::min_vertical_chunk, pos.y));
+}
+
+void ChunkRenderer::release_vchunk(glm::ivec3 pos)
+{
+    auto& current_frame = get_current_frame();
+
+    auto it = m_chunk_meshes.find(pos);
+    if (it == m_chunk_meshes.end()) return;
+
+    // mesh of this frame that wasn't uploaded yet
+    std::erase_if(current_frame.chunk_mesh_stencil->meshes, [&](const ChunkMeshStencil::ReadyMeshes& mesh) { return mesh.pos == pos; });
+
+    if (auto* mb = it->second.mesh_buffer)
+    {
+        mb->free_chunkmesh(pos);
+        if (mb->get_chunk_count() == 0) current_frame.emptied_meshbuffers.push_back(mb);
     }
+
+    // an empty mesh is skipped by the cull shader
+    write_chunk_gpudata(it->second.chunk_id, glsl::pack_chunk_gpudata(glsl::ChunkGPUData{.pos = pos, .mesh = {}}));
+
+    m_released_chunk_ids.push_back(it->second.chunk_id);
+    m_chunk_meshes.erase(it);
 }
 
 ChunkRenderer::MeshBuffer* ChunkRenderer::allocate_new_meshbuffer()
@@ -341,7 +400,11 @@ void ChunkRenderer::prepare_frame(VkCommandBuffer cmd)
 {
     auto& current_frame = get_current_frame();
 
+    // the last frame recorded with these frame datas has finished, nothing draws from buffers emptied back then
+    for (auto* mb : current_frame.emptied_meshbuffers)
+        if (mb->get_chunk_count() == 0) mb->reset();
 
+    current_frame.emptied_meshbuffers.clear();
 
     auto* mesh_stencil = current_frame.chunk_mesh_stencil.get();
 
@@ -350,7 +413,7 @@ void ChunkRenderer::prepare_frame(VkCommandBuffer cmd)
         return a.vert_count < b.vert_count;
     });
 
-    if (meshes.size() == 0) return;
+    if (meshes.size() == 0 && m_chunk_data_transfers.size() == 0) return;
 
     auto mesh_it = meshes.begin();
 
@@ -425,6 +488,10 @@ void ChunkRenderer::prepare_frame(VkCommandBuffer cmd)
     }
     m_chunk_data_stencil_top = 0;
 
+    // their slots were cleared by the transfer above
+    m_free_chunk_ids.insert(m_free_chunk_ids.end(), m_released_chunk_ids.begin(), m_released_chunk_ids.end());
+    m_released_chunk_ids.clear();
+
     mesh_stencil->buffer_top = 0;
 
     VkBufferMemoryBarrier barriers[]{
@@ -18,6 +18,7 @@ class DescriptorPool;
 }
 
 class Chunk;
+class ChunkSnapshot;
 
 class ChunkRenderer : public IRenderSystem
 {
@@ -34,7 +35,10 @@ public:
 
     [[deprecated]] void mesh_chunk(const Chunk* chunk);
 
-    void mesh_vchunk(const Chunk* chunk, int vertical);
+    void mesh_vchunk(const ChunkSnapshot& snapshot);
+
+    // drops the meshes of all vertical chunks of the chunk column at pos
+    void release_chunk(glm::ivec2 pos);
 
     void cleanup() override;
 
@@ -47,7 +51,9 @@ private:
     void return_chunkmesh_stencil(ChunkMeshStencil* mb);
 
     uint32_t register_chunk(glm::ivec3 pos);
+    void release_vchunk(glm::ivec3 pos);
     uint32_t set_chunk_mesh(glm::ivec3 pos, MeshBuffer* mb, uint32_t v_offset, uint32_t v_count);
+    void write_chunk_gpudata(uint32_t chunk_id, glm::uvec4 packed);
     inline FrameData& get_current_frame() { return m_frame_datas[m_core->frame_index()]; }
 
     MeshBuffer* allocate_new_meshbuffer();
@@ -123,6 +129,9 @@ private:
     {
         std::unique_ptr<vke::Buffer> chunk_data_stencil;
         std::unique_ptr<ChunkMeshStencil> chunk_mesh_stencil;
+
+        // mesh buffers emptied while recording this frame, their space is reused once the frame is recorded again
+        std::vector<MeshBuffer*> emptied_meshbuffers;
     };
 
     std::array<FrameData, vke::Core::FRAME_OVERLAP> m_frame_datas;
@@ -131,6 +140,8 @@ private:
     uint32_t m_chunk_capacity         = 8 * 1024;
     uint32_t m_chunk_data_stencil_top = 0;
     uint32_t m_chunk_id_counter       = 0;
+    std::vector<uint32_t> m_free_chunk_ids;
+    std::vector<uint32_t> m_released_chunk_ids; // freed this frame, reusable after its gpu data is cleared
     uint32_t m_meshbuffer_counter = 0;
 
     std::unordered_map<vke::RenderPass*, RPData> m_rpdata; // render pass data
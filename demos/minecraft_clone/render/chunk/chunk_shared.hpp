@@ -2,6 +2,7 @@
 #define CHUNKR_SHARED_HPP
 
 #include "../glsl_shared.hpp"
+#include "../../game/world/chunk_dims.hpp"
 
 #ifdef LANG_CPP
 namespace glsl
@@ -10,6 +11,13 @@ namespace glsl
 
 #define GROUP_X_SIZE 128
 
+// a quad vertex packs its tile in the vertical chunk with VERT_POS_BITS per axis, x in the highest and z in the lowest
+// bits, then the corner of the tile it is at, the axis of the face and the texture
+#define VERT_POS_BITS      CHUNK_SIZE_LOG2
+#define VERT_CORNER_SHIFT  (3 * VERT_POS_BITS)
+#define VERT_PLANE_SHIFT   (VERT_CORNER_SHIFT + 3)
+#define VERT_TEXTURE_SHIFT (VERT_PLANE_SHIFT + 2)
+
 struct GhunkGPUMeshData
 {
     uint buffer_id;
@@ -31,15 +39,14 @@ struct ChunkGPUData
     GhunkGPUMeshData mesh;
 };
 
+// chunk y is stored in 8 bits, the low half above x and the high half above z. it covers vertical chunks -128 to 127
 INLINE uvec4 pack_chunk_gpudata(ChunkGPUData data)
 {
     uint ybits = uint(data.pos.y + (1 << 7)) & 0xFF;
 
-    // ybits = 0;
-
     uvec4 packed;
-    packed.x = (ybits << 28)            | (uint(data.pos.x + int(1 << 27)) & 0xFFFFFFFu);
-    packed.y = ((ybits & 0xF0) << 28)   | (uint(data.pos.z + int(1 << 27)) & 0xFFFFFFFu);
+    packed.x = ((ybits & 0xF) << 28)    | (uint(data.pos.x + int(1 << 27)) & 0xFFFFFFFu);
+    packed.y = ((ybits >> 4) << 28)     | (uint(data.pos.z + int(1 << 27)) & 0xFFFFFFFu);
     packed.z = data.mesh.vert_offset;
     packed.w = (data.mesh.vert_count & 0xFFFFFu) | (data.mesh.buffer_id << 20u);
 
@@ -51,7 +58,7 @@ INLINE ivec3 unpack_chunk_pos(uvec2 packed)
     ivec3 pos;
     pos.x = int(packed.x & 0xFFFFFFFu) - int(1 << 27);
     pos.z = int(packed.y & 0xFFFFFFFu) - int(1 << 27);
-    pos.y = int((packed.x >> 28) | ((packed.y >> 24) & 0xF0));
+    pos.y = int((packed.x >> 28) | ((packed.y >> 28) << 4)) - (1 << 7);
 
     return pos;
 };
@@ -1,8 +1,11 @@
 #include "renderer.hpp"
 
+#include <bit>
 #include <random>
 
 #include "../../game/game.hpp"
+#include "../../game/world/chunk_snapshot.hpp"
+#include "../../game/world/light_engine.hpp"
 #include "../math.hpp"
 
 #include "deferedlight_buffer.hpp"
@@ -268,9 +271,15 @@ void VkRenderer::frame(std::function<void(float)>& update, vke::Core::FrameArgs&
         current_f->dubo->reset();
     });
 
-    for (auto c : m_world->get_updated_chunks())
+    for (auto pos : m_world->get_evicted_chunks())
     {
-        m_chunk_renderer->mesh_chunk(c);
+        m_chunk_renderer->release_chunk(pos);
+    }
+
+    for (auto [c, vertical_mask] : m_world->get_updated_chunks())
+    {
+        for (auto mask = vertical_mask; mask; mask &= mask - 1)
+            m_chunk_renderer->mesh_vchunk(ChunkSnapshot(c, std::countr_zero(mask)));
     }
 
 
@@ -284,8 +293,14 @@ void VkRenderer::frame(std::function<void(float)>& update, vke::Core::FrameArgs&
 
     auto cascades = calc_cascaded_shadows(*m_game->camera(), m_main_pass->size(), view, m_deferedlightning.sun_dir, {35.f, 50.f, 250.f});
 
+    auto tile_pool   = Chunk::tile_array_pool().stats();
+    auto light_pool  = Chunk::light_array_pool().stats();
+    auto light_stats = m_world->light_engine().stats();
+
     m_textrenderer->render_text_px(m_main_pass.get(),
-        fmt::format("shadow bias min: {}\nshadow bias max: {}", m_deferedlightning.shadow_bias.x, m_deferedlightning.shadow_bias.y),
+        fmt::format("shadow bias min: {}\nshadow bias max: {}\ntile arrays: {} live {} peak {} reserved\nlight arrays: {} live, {} light nodes pending",
+            m_deferedlightning.shadow_bias.x, m_deferedlightning.shadow_bias.y, tile_pool.live_blocks, tile_pool.peak_blocks, tile_pool.reserved_blocks,
+            light_pool.live_blocks, light_stats.pending_nodes),
         glm::vec2(20.f, 25.f), glm::vec2(16.f, 16.f));
 
     uint32_t update_in_frames[] = {2, 5, 11, 17};
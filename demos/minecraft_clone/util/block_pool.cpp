@@ -0,0 +1,150 @@
+#include "block_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+namespace
+{
+constexpr size_t huge_page_size    = 2 * 1024 * 1024;
+constexpr size_t max_thread_caches = 4;
+} // namespace
+
+struct BlockPool::ThreadCache
+{
+    BlockPool* pool = nullptr;
+    void* blocks[cache_capacity];
+    size_t count = 0;
+
+    ~ThreadCache()
+    {
+        if (pool) pool->spill(*this, count);
+    }
+};
+
+BlockPool::BlockPool(size_t block_size, size_t slab_size)
+    : m_block_size(std::max(block_size, sizeof(FreeBlock))), m_slab_size(slab_size)
+{
+}
+
+BlockPool::~BlockPool()
+{
+    for (void* slab : m_slabs)
+        std::free(slab);
+}
+
+BlockPool::ThreadCache& BlockPool::thread_cache()
+{
+    thread_local ThreadCache caches[max_thread_caches];
+
+    for (auto& cache : caches)
+        if (cache.pool == this) return cache;
+
+    for (auto& cache : caches)
+    {
+        if (cache.pool == nullptr)
+        {
+            cache.pool = this;
+            return cache;
+        }
+    }
+
+    throw std::runtime_error("too many BlockPools used from a single thread");
+}
+
+void* BlockPool::allocate()
+{
+    auto& cache = thread_cache();
+
+    if (cache.count == 0) refill(cache, batch_size);
+
+    void* block = cache.blocks[--cache.count];
+
+    size_t live = ++m_live_blocks;
+    size_t peak = m_peak_blocks.load(std::memory_order_relaxed);
+    while (live > peak && !m_peak_blocks.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        ;
+
+    return block;
+}
+
+void BlockPool::free(void* block)
+{
+    if (block == nullptr) return;
+
+    auto& cache = thread_cache();
+
+    if (cache.count == cache_capacity) spill(cache, batch_size);
+
+    cache.blocks[cache.count++] = block;
+
+    m_live_blocks--;
+}
+
+void BlockPool::refill(ThreadCache& cache, size_t count)
+{
+    auto guard = std::lock_guard(m_lock);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (m_free_list == nullptr) allocate_slab();
+
+        cache.blocks[cache.count++] = m_free_list;
+        m_free_list                 = m_free_list->next;
+    }
+}
+
+void BlockPool::spill(ThreadCache& cache, size_t count)
+{
+    auto guard = std::lock_guard(m_lock);
+
+    assert(count <= cache.count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto* block = static_cast<FreeBlock*>(cache.blocks[--cache.count]);
+        block->next = m_free_list;
+        m_free_list = block;
+    }
+}
+
+void BlockPool::allocate_slab()
+{
+    size_t block_count = std::max<size_t>(m_slab_size / m_block_size, 1);
+    size_t slab_bytes  = (block_count * m_block_size + huge_page_size - 1) / huge_page_size * huge_page_size;
+    block_count        = slab_bytes / m_block_size;
+
+    auto* slab = static_cast<uint8_t*>(std::aligned_alloc(huge_page_size, slab_bytes));
+    if (slab == nullptr) throw std::bad_alloc();
+
+#ifdef MADV_HUGEPAGE
+    madvise(slab, slab_bytes, MADV_HUGEPAGE);
+#endif
+
+    m_slabs.push_back(slab);
+
+    for (size_t i = block_count; i-- > 0;)
+    {
+        auto* block = reinterpret_cast<FreeBlock*>(slab + i * m_block_size);
+        block->next = m_free_list;
+        m_free_list = block;
+    }
+
+    m_reserved_blocks += block_count;
+    m_slab_count++;
+}
+
+BlockPoolStats BlockPool::stats() const
+{
+    return BlockPoolStats{
+        .block_size      = m_block_size,
+        .live_blocks     = m_live_blocks.load(),
+        .peak_blocks     = m_peak_blocks.load(),
+        .reserved_blocks = m_reserved_blocks.load(),
+        .slab_count      = m_slab_count.load(),
+    };
+}
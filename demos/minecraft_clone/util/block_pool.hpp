@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+struct BlockPoolStats
+{
+    size_t block_size;
+    size_t live_blocks;     // handed out and not freed yet
+    size_t peak_blocks;     // highest live_blocks seen
+    size_t reserved_blocks; // blocks in all slabs, live or free
+    size_t slab_count;
+};
+
+// allocator for blocks of one fixed size. blocks are carved out of large slabs backed by transparent huge pages,
+// each thread keeps a small cache of free blocks and refills it from / spills it to a shared free list in batches.
+// slabs are never given back to the system
+class BlockPool
+{
+    BlockPool(const BlockPool&) = delete;
+
+public:
+    BlockPool(size_t block_size, size_t slab_size = 2 * 1024 * 1024);
+    ~BlockPool();
+
+    void* allocate();
+    void free(void* block);
+
+    BlockPoolStats stats() const;
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct ThreadCache;
+
+    ThreadCache& thread_cache();
+
+    // moves up to count blocks from the shared free list into cache, allocating a new slab if it is empty
+    void refill(ThreadCache& cache, size_t count);
+    void spill(ThreadCache& cache, size_t count);
+    void allocate_slab();
+
+    static constexpr size_t cache_capacity = 16;
+    static constexpr size_t batch_size     = cache_capacity / 2;
+
+    const size_t m_block_size;
+    const size_t m_slab_size;
+
+    std::mutex m_lock;
+    FreeBlock* m_free_list = nullptr;
+    std::vector<void*> m_slabs;
+
+    std::atomic<size_t> m_live_blocks     = 0;
+    std::atomic<size_t> m_peak_blocks     = 0;
+    std::atomic<size_t> m_reserved_blocks = 0;
+    std::atomic<size_t> m_slab_count      = 0;
+};
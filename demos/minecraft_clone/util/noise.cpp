@@ -0,0 +1,377 @@
+#include "noise.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+// the helpers of the kernels return vectors wider than the baseline registers, they are always inlined into the
+// functions with the instruction set enabled
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NOISE_X86 1
+#else
+#define NOISE_X86 0
+#endif
+
+namespace
+{
+// the kernels are written once with vector extensions and inlined into a function per instruction set, with vectors
+// as wide as its registers. none of them enable fma, so every operation rounds like the scalar code and the double
+// results stay exact
+template <class T, uint32_t N>
+struct Lanes
+{
+    typedef T V __attribute__((vector_size(N * sizeof(T))));
+    typedef int32_t Index __attribute__((vector_size(N * sizeof(int32_t))));
+};
+
+// exact for the range of int32_t, which PerlinNoise assumes as well
+template <class T, uint32_t N, class V = typename Lanes<T, N>::V>
+[[gnu::always_inline]] inline V floor_lanes(const V& x)
+{
+    V t = __builtin_convertvector(__builtin_convertvector(x, typename Lanes<T, N>::Index), V);
+
+    // the compare gives all bits set where t was rounded up, masking 1.0 with it subtracts 1 there
+    return t - (V)((t > x) & (decltype(t > x))(V{} + T(1)));
+}
+
+template <class T, class V>
+[[gnu::always_inline]] inline V fade(const V& t)
+{
+    return t * t * t * (t * (t * T(6) - T(15)) + T(10));
+}
+
+template <class V>
+[[gnu::always_inline]] inline V lerp(const V& t, const V& a, const V& b)
+{
+    return a + t * (b - a);
+}
+
+// PerlinNoise::grad of the low 4 bits of the hashes. the compares are made on 32 bit lanes, which every instruction
+// set has, and widened to the lanes of T
+template <class T, uint32_t N, class V = typename Lanes<T, N>::V, class Index = typename Lanes<T, N>::Index>
+[[gnu::always_inline]] inline V grad(const Index& hash, const V& x, const V& y, const V& z)
+{
+    using Mask = decltype(x > y);
+
+    constexpr int sign_bit = sizeof(T) * 8 - 1;
+
+    Index h = hash & 15;
+
+    Mask lt8    = __builtin_convertvector(h < 8, Mask);
+    Mask lt4    = __builtin_convertvector(h < 4, Mask);
+    Mask uses_x = __builtin_convertvector((h == 12) | (h == 14), Mask);
+    Mask bits   = __builtin_convertvector(h, Mask);
+
+    Mask u = (lt8 & (Mask)x) | (~lt8 & (Mask)y);
+    Mask v = (lt4 & (Mask)y) | (~lt4 & ((uses_x & (Mask)x) | (~uses_x & (Mask)z)));
+
+    // negating flips the sign bit
+    return (V)(u ^ ((bits & 1) << sign_bit)) + (V)(v ^ ((bits & 2) << (sign_bit - 1)));
+}
+
+// PerlinNoise::noise3D of N samples, written in the same order of operations
+template <class T, uint32_t N>
+[[gnu::always_inline]] inline void perlin_lanes(const uint8_t* p, T freq, T amp, const T* xs, const T* ys, const T* zs, T* out)
+{
+    using V     = typename Lanes<T, N>::V;
+    using Index = typename Lanes<T, N>::Index;
+
+    V x, y, z = {};
+    memcpy(&x, xs, sizeof(V));
+    memcpy(&y, ys, sizeof(V));
+    if (zs) memcpy(&z, zs, sizeof(V));
+
+    x *= freq;
+    y *= freq;
+    z *= freq;
+
+    V fx = floor_lanes<T, N>(x), fy = floor_lanes<T, N>(y), fz = floor_lanes<T, N>(z);
+
+    Index xi = __builtin_convertvector(fx, Index) & 255;
+    Index yi = __builtin_convertvector(fy, Index) & 255;
+    Index zi = __builtin_convertvector(fz, Index) & 255;
+
+    // the permutation lookups don't vectorize, the hashes of the 8 corners are gathered lane by lane
+    int32_t hashes[8][N];
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        int32_t A = p[xi[i]] + yi[i], AA = p[A] + zi[i], AB = p[A + 1] + zi[i];
+        int32_t B = p[xi[i] + 1] + yi[i], BA = p[B] + zi[i], BB = p[B + 1] + zi[i];
+
+        hashes[0][i] = p[AA];
+        hashes[1][i] = p[BA];
+        hashes[2][i] = p[AB];
+        hashes[3][i] = p[BB];
+        hashes[4][i] = p[AA + 1];
+        hashes[5][i] = p[BA + 1];
+        hashes[6][i] = p[AB + 1];
+        hashes[7][i] = p[BB + 1];
+    }
+
+    Index h[8];
+    memcpy(h, hashes, sizeof(h));
+
+    x -= fx;
+    y -= fy;
+    z -= fz;
+
+    V u = fade<T>(x), v = fade<T>(y), w = fade<T>(z);
+
+    V x1 = x - T(1), y1 = y - T(1), z1 = z - T(1);
+
+    V r = lerp(w,
+        lerp(v, lerp(u, grad<T, N>(h[0], x, y, z), grad<T, N>(h[1], x1, y, z)),
+            lerp(u, grad<T, N>(h[2], x, y1, z), grad<T, N>(h[3], x1, y1, z))),
+        lerp(v, lerp(u, grad<T, N>(h[4], x, y, z1), grad<T, N>(h[5], x1, y, z1)),
+            lerp(u, grad<T, N>(h[6], x, y1, z1), grad<T, N>(h[7], x1, y1, z1))));
+
+    r *= amp;
+    memcpy(out, &r, sizeof(V));
+}
+
+// Bytes is the register width of the instruction set
+template <class T, uint32_t Bytes>
+[[gnu::always_inline]] inline void perlin_batch(const uint8_t* p, T freq, T amp, const T* x, const T* y, const T* z, T* out, uint32_t count)
+{
+    constexpr uint32_t N = Bytes / sizeof(T);
+
+    uint32_t i = 0;
+    for (; i + N <= count; i += N)
+        perlin_lanes<T, N>(p, freq, amp, x + i, y + i, z ? z + i : nullptr, out + i);
+
+    if (i == count) return;
+
+    // the rest is padded to a full set of lanes
+    T rest_x[N] = {}, rest_y[N] = {}, rest_z[N] = {}, rest_out[N];
+
+    std::copy(x + i, x + count, rest_x);
+    std::copy(y + i, y + count, rest_y);
+    if (z) std::copy(z + i, z + count, rest_z);
+
+    perlin_lanes<T, N>(p, freq, amp, rest_x, rest_y, z ? rest_z : nullptr, rest_out);
+
+    std::copy(rest_out, rest_out + (count - i), out + i);
+}
+
+#if NOISE_X86
+template <class T>
+__attribute__((target("avx2"))) void perlin_batch_avx2(const uint8_t* p, T freq, T amp, const T* x, const T* y, const T* z, T* out, uint32_t count)
+{
+    perlin_batch<T, 32>(p, freq, amp, x, y, z, out, count);
+}
+
+template <class T>
+__attribute__((target("sse4.1"))) void perlin_batch_sse41(const uint8_t* p, T freq, T amp, const T* x, const T* y, const T* z, T* out, uint32_t count)
+{
+    perlin_batch<T, 16>(p, freq, amp, x, y, z, out, count);
+}
+#endif
+
+NoiseBackend best_noise_backend()
+{
+    for (auto backend : {NoiseBackend::avx2, NoiseBackend::sse41})
+        if (is_noise_backend_supported(backend)) return backend;
+
+    return NoiseBackend::scalar;
+}
+
+std::atomic<NoiseBackend>& current_noise_backend()
+{
+    static std::atomic<NoiseBackend> backend = best_noise_backend();
+    return backend;
+}
+
+// runs the kernel of the current backend, or scalar(i) for every sample
+template <class T, class Scalar>
+void noise_batch(const uint8_t* p, T freq, T amp, const T* x, const T* y, const T* z, T* out, uint32_t count, Scalar&& scalar)
+{
+    switch (get_noise_backend())
+    {
+#if NOISE_X86
+    case NoiseBackend::avx2:
+        return perlin_batch_avx2<T>(p, freq, amp, x, y, z, out, count);
+    case NoiseBackend::sse41:
+        return perlin_batch_sse41<T>(p, freq, amp, x, y, z, out, count);
+#endif
+    default:
+        break;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+        out[i] = scalar(i);
+}
+
+// interval arithmetic for the bounds of the noise
+struct Interval
+{
+    double lo, hi;
+
+    Interval operator+(Interval o) const { return {lo + o.lo, hi + o.hi}; }
+    Interval operator-() const { return {-hi, -lo}; }
+};
+
+Interval fade(Interval t)
+{
+    // increasing on [0, 1]
+    auto f = [](double t) { return t * t * t * (t * (t * 6 - 15) + 10); };
+    return {f(t.lo), f(t.hi)};
+}
+
+// a + t * (b - a) is a mix of a and b with non negative weights, so its bounds are at the ends of t
+Interval lerp(Interval t, Interval a, Interval b)
+{
+    auto mix = [](double t, double a, double b) { return a + t * (b - a); };
+
+    return {
+        std::min(mix(t.lo, a.lo, b.lo), mix(t.hi, a.lo, b.lo)),
+        std::max(mix(t.lo, a.hi, b.hi), mix(t.hi, a.hi, b.hi)),
+    };
+}
+
+Interval grad(int32_t hash, Interval x, Interval y, Interval z)
+{
+    int32_t h = hash & 15;
+
+    Interval u = h < 8 ? x : y;
+    Interval v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+
+    return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+}
+
+// bounds of noise3D over the cell of the lattice at cell, local are the coordinates within it
+Interval cell_bounds(const uint8_t* p, const int32_t cell[3], const Interval local[3])
+{
+    int32_t A = p[cell[0]] + cell[1], AA = p[A] + cell[2], AB = p[A + 1] + cell[2];
+    int32_t B = p[cell[0] + 1] + cell[1], BA = p[B] + cell[2], BB = p[B + 1] + cell[2];
+
+    Interval x = local[0], y = local[1], z = local[2];
+    Interval x1 = {x.lo - 1, x.hi - 1}, y1 = {y.lo - 1, y.hi - 1}, z1 = {z.lo - 1, z.hi - 1};
+
+    Interval u = fade(x), v = fade(y), w = fade(z);
+
+    return lerp(w,
+        lerp(v, lerp(u, grad(p[AA], x, y, z), grad(p[BA], x1, y, z)), lerp(u, grad(p[AB], x, y1, z), grad(p[BB], x1, y1, z))),
+        lerp(v, lerp(u, grad(p[AA + 1], x, y, z1), grad(p[BA + 1], x1, y, z1)),
+            lerp(u, grad(p[AB + 1], x, y1, z1), grad(p[BB + 1], x1, y1, z1))));
+}
+
+// bounds of noise3D over the box from lo to hi in lattice units, split along the cells it overlaps from axis on
+Interval box_bounds(const uint8_t* p, const double lo[3], const double hi[3], int axis, int32_t cell[3], Interval local[3])
+{
+    // two components of a gradient dotted with offsets in [-1, 1], and mixes of those
+    constexpr Interval noise_range = {-2, 2};
+    // boxes across more cells than this aren't worth splitting
+    constexpr double max_cells = 4;
+
+    if (axis == 3) return cell_bounds(p, cell, local);
+
+    double first = std::floor(lo[axis]), last = std::floor(hi[axis]);
+    if (last - first >= max_cells) return noise_range;
+
+    Interval r = {noise_range.hi, noise_range.lo};
+
+    for (double c = first; c <= last; ++c)
+    {
+        // noise3D is continuous across cells, the part in a cell can include its far side
+        cell[axis]  = static_cast<int32_t>(c) & 255;
+        local[axis] = {std::max(lo[axis], c) - c, std::min(hi[axis], c + 1) - c};
+
+        Interval part = box_bounds(p, lo, hi, axis + 1, cell, local);
+        r             = {std::min(r.lo, part.lo), std::max(r.hi, part.hi)};
+    }
+
+    return r;
+}
+
+} // namespace
+
+bool is_noise_backend_supported(NoiseBackend backend)
+{
+    switch (backend)
+    {
+    case NoiseBackend::scalar:
+        return true;
+#if NOISE_X86
+    case NoiseBackend::sse41:
+        return __builtin_cpu_supports("sse4.1");
+    case NoiseBackend::avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+NoiseBackend get_noise_backend()
+{
+    return current_noise_backend().load(std::memory_order_relaxed);
+}
+
+void set_noise_backend(NoiseBackend backend)
+{
+    assert(is_noise_backend_supported(backend));
+    current_noise_backend() = backend;
+}
+
+const char* noise_backend_name(NoiseBackend backend)
+{
+    switch (backend)
+    {
+    case NoiseBackend::scalar:
+        return "scalar";
+    case NoiseBackend::sse41:
+        return "sse4.1";
+    case NoiseBackend::avx2:
+        return "avx2";
+    }
+
+    return "unknown";
+}
+
+void AmplifiedNoise::noise(const double* x, const double* y, double* out, uint32_t count) const
+{
+    noise_batch(m_permutation, m_freq, m_amp, x, y, (const double*)nullptr, out, count, [&](uint32_t i) { return noise(x[i], y[i]); });
+}
+
+void AmplifiedNoise::noise(const double* x, const double* y, const double* z, double* out, uint32_t count) const
+{
+    noise_batch(m_permutation, m_freq, m_amp, x, y, z, out, count, [&](uint32_t i) { return noise(x[i], y[i], z[i]); });
+}
+
+void AmplifiedNoise::noise(const float* x, const float* y, float* out, uint32_t count) const
+{
+    noise_batch(m_permutation, (float)m_freq, (float)m_amp, x, y, (const float*)nullptr, out, count,
+        [&](uint32_t i) { return (float)noise(x[i], y[i]); });
+}
+
+void AmplifiedNoise::noise(const float* x, const float* y, const float* z, float* out, uint32_t count) const
+{
+    noise_batch(m_permutation, (float)m_freq, (float)m_amp, x, y, z, out, count,
+        [&](uint32_t i) { return (float)noise(x[i], y[i], z[i]); });
+}
+
+NoiseBounds AmplifiedNoise::bounds(const double lo[3], const double hi[3]) const
+{
+    // far above the rounding of noise3D
+    constexpr double rounding = 1e-9;
+
+    double scaled_lo[3], scaled_hi[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        scaled_lo[i] = lo[i] * m_freq;
+        scaled_hi[i] = hi[i] * m_freq;
+    }
+
+    int32_t cell[3];
+    Interval local[3];
+
+    Interval r = box_bounds(m_permutation, scaled_lo, scaled_hi, 0, cell, local);
+
+    return {(r.lo - rounding) * m_amp, (r.hi + rounding) * m_amp};
+}
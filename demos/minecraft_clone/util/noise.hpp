@@ -1,14 +1,43 @@
 #pragma once
 
+#include <array>
+#include <inttypes.h>
+
 #include <PerlinNoise.hpp>
 
+// how the batched noise calls are evaluated. scalar runs PerlinNoise once per sample, the others as many samples at a
+// time as the vector registers of the instruction set hold. the fastest supported one is used unless another is set
+enum class NoiseBackend
+{
+    scalar,
+    sse41,
+    avx2,
+};
+
+bool is_noise_backend_supported(NoiseBackend backend);
+NoiseBackend get_noise_backend();
+// meant to be set before generation starts, for benchmarks and comparisons
+void set_noise_backend(NoiseBackend backend);
+const char* noise_backend_name(NoiseBackend backend);
+
+// lower and upper bound of a noise over a region
+struct NoiseBounds
+{
+    double min;
+    double max;
+};
+
 class AmplifiedNoise
 {
 public:
     AmplifiedNoise(double freq, double amp, uint64_t seed)
         : m_freq(freq),m_amp(amp),m_p_noise(seed)
     {
+        std::array<uint8_t, 256> permutation;
+        m_p_noise.serialize(permutation);
 
+        for (int i = 0; i < 512; ++i)
+            m_permutation[i] = permutation[i % 256];
     }
 
     double noise(double x,double y)const
@@ -21,9 +50,21 @@ public:
         return m_p_noise.noise3D(x * m_freq, y * m_freq,z * m_freq) * m_amp;
     }
 
+    // out[i] = noise(x[i], y[i]) for count samples, evaluated by the current backend. the double versions give the same
+    // values on every backend, the float ones are off by the rounding of the coordinates to float
+    void noise(const double* x, const double* y, double* out, uint32_t count) const;
+    void noise(const double* x, const double* y, const double* z, double* out, uint32_t count) const;
+    void noise(const float* x, const float* y, float* out, uint32_t count) const;
+    void noise(const float* x, const float* y, const float* z, float* out, uint32_t count) const;
+
+    // conservative bounds of noise(x, y, z) over the box from lo to hi, including the rounding of noise. close to the
+    // real range when the box lies in a single cell of the noise lattice, the range of the whole noise otherwise
+    NoiseBounds bounds(const double lo[3], const double hi[3]) const;
+
 private:
     double m_freq;
     double m_amp;
 
     siv::PerlinNoise m_p_noise;
-};
\ No newline at end of file
+    uint8_t m_permutation[512];
+};
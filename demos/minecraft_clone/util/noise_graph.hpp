@@ -0,0 +1,398 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#include "noise.hpp"
+
+// expression templates that describe a field as a graph of noise, warp, arithmetic, clamp and select nodes, like
+//
+//     auto height = noise(p, coord_x + noise(p1, coord_x, coord_y, coord_z) * 0.9, coord_z) * input(0) + 60.7;
+//
+// a graph is evaluated over a batch of positions at once. the noise nodes are sampled first through the batched
+// AmplifiedNoise kernels, then everything between them is fused into one inlined loop over the samples. every node
+// evaluates in the order the expression is written, so a graph gives the same values as the expression written by hand
+namespace noise_graph
+{
+// the most samples a batch can hold, the values of the noise nodes live on the stack
+constexpr uint32_t max_batch = 64;
+
+// the positions of a batch and the per sample inputs bound to it
+struct Batch
+{
+    const double* x;
+    const double* y;
+    const double* z;
+    const double* const* inputs = nullptr;
+};
+
+// every node has a State, which holds what prepare samples ahead for a batch, and at(batch, state, i), the value at
+// sample i once the batch is prepared
+struct Node
+{
+};
+
+template <class T>
+concept Expr = std::is_base_of_v<Node, T>;
+
+// nodes without anything to prepare
+struct Leaf : Node
+{
+    struct State
+    {
+    };
+
+    void prepare(const Batch&, State&, uint32_t) const {}
+};
+
+template <int Axis>
+struct Coord : Leaf
+{
+    const double* values(const Batch& batch) const { return Axis == 0 ? batch.x : Axis == 1 ? batch.y : batch.z; }
+
+    double at(const Batch& batch, const State&, uint32_t i) const { return values(batch)[i]; }
+};
+
+struct Constant : Leaf
+{
+    double value;
+
+    double at(const Batch&, const State&, uint32_t) const { return value; }
+};
+
+// the per sample values bound to inputs[index] of the batch
+struct Input : Leaf
+{
+    uint32_t index;
+
+    const double* values(const Batch& batch) const { return batch.inputs[index]; }
+
+    double at(const Batch& batch, const State&, uint32_t i) const { return values(batch)[i]; }
+};
+
+// the values of e over the batch, read in place when the batch already holds them
+template <Expr E>
+const double* values_of(const E& e, const Batch& batch, const typename E::State& state, double* buffer, uint32_t count)
+{
+    if constexpr (requires { e.values(batch); })
+    {
+        return e.values(batch);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            buffer[i] = e.at(batch, state, i);
+
+        return buffer;
+    }
+}
+
+template <Expr X, Expr Z>
+struct Noise2 : Node
+{
+    AmplifiedNoise noise;
+    X x;
+    Z z;
+
+    struct State
+    {
+        typename X::State x;
+        typename Z::State z;
+        double values[max_batch];
+    };
+
+    void prepare(const Batch& batch, State& state, uint32_t count) const
+    {
+        x.prepare(batch, state.x, count);
+        z.prepare(batch, state.z, count);
+
+        double xs[max_batch], zs[max_batch];
+        noise.noise(values_of(x, batch, state.x, xs, count), values_of(z, batch, state.z, zs, count), state.values, count);
+    }
+
+    double at(const Batch&, const State& state, uint32_t i) const { return state.values[i]; }
+};
+
+template <Expr X, Expr Y, Expr Z>
+struct Noise3 : Node
+{
+    AmplifiedNoise noise;
+    X x;
+    Y y;
+    Z z;
+
+    struct State
+    {
+        typename X::State x;
+        typename Y::State y;
+        typename Z::State z;
+        double values[max_batch];
+    };
+
+    void prepare(const Batch& batch, State& state, uint32_t count) const
+    {
+        x.prepare(batch, state.x, count);
+        y.prepare(batch, state.y, count);
+        z.prepare(batch, state.z, count);
+
+        double xs[max_batch], ys[max_batch], zs[max_batch];
+        noise.noise(values_of(x, batch, state.x, xs, count), values_of(y, batch, state.y, ys, count),
+            values_of(z, batch, state.z, zs, count), state.values, count);
+    }
+
+    double at(const Batch&, const State& state, uint32_t i) const { return state.values[i]; }
+};
+
+// e evaluated at the positions of the batch moved by dx, dy and dz
+template <Expr E, Expr DX, Expr DY, Expr DZ>
+struct Warp : Node
+{
+    E e;
+    DX dx;
+    DY dy;
+    DZ dz;
+
+    struct State
+    {
+        typename DX::State dx;
+        typename DY::State dy;
+        typename DZ::State dz;
+        typename E::State e;
+        double x[max_batch], y[max_batch], z[max_batch];
+    };
+
+    Batch warped(const Batch& batch, const State& state) const { return Batch{state.x, state.y, state.z, batch.inputs}; }
+
+    void prepare(const Batch& batch, State& state, uint32_t count) const
+    {
+        dx.prepare(batch, state.dx, count);
+        dy.prepare(batch, state.dy, count);
+        dz.prepare(batch, state.dz, count);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            state.x[i] = batch.x[i] + dx.at(batch, state.dx, i);
+            state.y[i] = batch.y[i] + dy.at(batch, state.dy, i);
+            state.z[i] = batch.z[i] + dz.at(batch, state.dz, i);
+        }
+
+        e.prepare(warped(batch, state), state.e, count);
+    }
+
+    double at(const Batch& batch, const State& state, uint32_t i) const { return e.at(warped(batch, state), state.e, i); }
+};
+
+template <class Op, Expr A, Expr B>
+struct Binary : Node
+{
+    A a;
+    B b;
+
+    struct State
+    {
+        typename A::State a;
+        typename B::State b;
+    };
+
+    void prepare(const Batch& batch, State& state, uint32_t count) const
+    {
+        a.prepare(batch, state.a, count);
+        b.prepare(batch, state.b, count);
+    }
+
+    double at(const Batch& batch, const State& state, uint32_t i) const
+    {
+        return Op::apply(a.at(batch, state.a, i), b.at(batch, state.b, i));
+    }
+};
+
+template <class Op, Expr A>
+struct Unary : Node
+{
+    A a;
+
+    using State = typename A::State;
+
+    void prepare(const Batch& batch, State& state, uint32_t count) const { a.prepare(batch, state, count); }
+
+    double at(const Batch& batch, const State& state, uint32_t i) const { return Op::apply(a.at(batch, state, i)); }
+};
+
+// a where condition is not 0, b elsewhere
+template <Expr C, Expr A, Expr B>
+struct Select : Node
+{
+    C condition;
+    A a;
+    B b;
+
+    struct State
+    {
+        typename C::State condition;
+        typename A::State a;
+        typename B::State b;
+    };
+
+    void prepare(const Batch& batch, State& state, uint32_t count) const
+    {
+        condition.prepare(batch, state.condition, count);
+        a.prepare(batch, state.a, count);
+        b.prepare(batch, state.b, count);
+    }
+
+    double at(const Batch& batch, const State& state, uint32_t i) const
+    {
+        return condition.at(batch, state.condition, i) != 0 ? a.at(batch, state.a, i) : b.at(batch, state.b, i);
+    }
+};
+
+struct AddOp
+{
+    static double apply(double a, double b) { return a + b; }
+};
+
+struct SubOp
+{
+    static double apply(double a, double b) { return a - b; }
+};
+
+struct MulOp
+{
+    static double apply(double a, double b) { return a * b; }
+};
+
+struct DivOp
+{
+    static double apply(double a, double b) { return a / b; }
+};
+
+struct MinOp
+{
+    static double apply(double a, double b) { return std::min(a, b); }
+};
+
+struct MaxOp
+{
+    static double apply(double a, double b) { return std::max(a, b); }
+};
+
+// 1 where a > b, 0 elsewhere
+struct GreaterOp
+{
+    static double apply(double a, double b) { return a > b ? 1.0 : 0.0; }
+};
+
+struct AbsOp
+{
+    static double apply(double a) { return std::abs(a); }
+};
+
+// numbers in expressions become constants
+template <class T>
+auto lift(T value)
+{
+    if constexpr (Expr<T>)
+        return value;
+    else
+        return Constant{.value = static_cast<double>(value)};
+}
+
+template <class T>
+concept Operand = Expr<T> || std::is_arithmetic_v<T>;
+
+template <class A, class B>
+concept Operands = Operand<A> && Operand<B> && (Expr<A> || Expr<B>);
+
+template <class Op, class A, class B>
+auto binary(A a, B b)
+{
+    return Binary<Op, decltype(lift(a)), decltype(lift(b))>{.a = lift(a), .b = lift(b)};
+}
+
+inline constexpr Coord<0> coord_x;
+inline constexpr Coord<1> coord_y;
+inline constexpr Coord<2> coord_z;
+
+inline Input input(uint32_t index) { return Input{.index = index}; }
+
+template <Operand X, Operand Z>
+auto noise(const AmplifiedNoise& noise, X x, Z z)
+{
+    return Noise2<decltype(lift(x)), decltype(lift(z))>{.noise = noise, .x = lift(x), .z = lift(z)};
+}
+
+template <Operand X, Operand Y, Operand Z>
+auto noise(const AmplifiedNoise& noise, X x, Y y, Z z)
+{
+    return Noise3<decltype(lift(x)), decltype(lift(y)), decltype(lift(z))>{.noise = noise, .x = lift(x), .y = lift(y), .z = lift(z)};
+}
+
+template <Expr E, Operand DX, Operand DY, Operand DZ>
+auto warp(E e, DX dx, DY dy, DZ dz)
+{
+    return Warp<E, decltype(lift(dx)), decltype(lift(dy)), decltype(lift(dz))>{.e = e, .dx = lift(dx), .dy = lift(dy), .dz = lift(dz)};
+}
+
+template <class A, class B> requires Operands<A, B>
+auto operator+(A a, B b) { return binary<AddOp>(a, b); }
+
+template <class A, class B> requires Operands<A, B>
+auto operator-(A a, B b) { return binary<SubOp>(a, b); }
+
+template <class A, class B> requires Operands<A, B>
+auto operator*(A a, B b) { return binary<MulOp>(a, b); }
+
+template <class A, class B> requires Operands<A, B>
+auto operator/(A a, B b) { return binary<DivOp>(a, b); }
+
+template <class A, class B> requires Operands<A, B>
+auto operator>(A a, B b) { return binary<GreaterOp>(a, b); }
+
+template <class A, class B> requires Operands<A, B>
+auto min(A a, B b) { return binary<MinOp>(a, b); }
+
+template <class A, class B> requires Operands<A, B>
+auto max(A a, B b) { return binary<MaxOp>(a, b); }
+
+template <Expr A>
+auto abs(A a) { return Unary<AbsOp, A>{.a = a}; }
+
+template <Expr E, Operand L, Operand H>
+auto clamp(E e, L lo, H hi) { return min(max(e, lo), hi); }
+
+template <Expr C, Operand A, Operand B>
+auto select(C condition, A a, B b)
+{
+    return Select<C, decltype(lift(a)), decltype(lift(b))>{.condition = condition, .a = lift(a), .b = lift(b)};
+}
+
+// evaluates e over count positions, at most max_batch
+template <Expr E>
+void evaluate(const E& e, const Batch& batch, double* out, uint32_t count)
+{
+    assert(count <= max_batch);
+
+    typename E::State state;
+    e.prepare(batch, state, count);
+
+    for (uint32_t i = 0; i < count; ++i)
+        out[i] = e.at(batch, state, i);
+}
+
+// e as the sampler(x, y, z, out, count) of a NoiseLattice
+template <Expr E>
+auto sampler(E e)
+{
+    return [e](const double* x, const double* y, const double* z, double* out, uint32_t count) {
+        for (uint32_t i = 0; i < count; i += max_batch)
+        {
+            uint32_t n = std::min(count - i, max_batch);
+            evaluate(e, Batch{x + i, y + i, z + i}, out + i, n);
+        }
+    };
+}
+
+} // namespace noise_graph
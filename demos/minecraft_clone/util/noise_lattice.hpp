@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/vec3.hpp>
+
+// a 3d noise field over a box of tiles, sampled every spacing tiles and trilinearly interpolated in between. a spacing
+// of 1 along every axis samples each tile itself. sampler(x, y, z, out, count) evaluates the field at count real
+// positions, like the batched AmplifiedNoise::noise
+template <class Sampler>
+class NoiseLattice
+{
+public:
+    NoiseLattice(Sampler sampler, glm::ivec3 spacing, glm::ivec3 origin, glm::ivec3 size)
+        : m_sampler(sampler), m_spacing(glm::max(spacing, glm::ivec3(1))), m_origin(origin)
+    {
+        m_row_x.resize(size.x);
+        m_row_y.resize(size.x);
+        m_row_z.resize(size.x);
+
+        if (full_resolution()) return;
+
+        // enough points to cover the last tile of the box
+        m_count = (glm::max(size, glm::ivec3(1)) - 1 + m_spacing - 1) / m_spacing + 1;
+        m_points.resize(m_count.x * m_count.y * m_count.z);
+
+        m_row_x.resize(std::max<size_t>(m_row_x.size(), m_count.x));
+        m_row_y.resize(m_row_x.size());
+        m_row_z.resize(m_row_x.size());
+
+        for (int32_t x = 0; x < m_count.x; ++x)
+            m_row_x[x] = origin.x + x * m_spacing.x;
+
+        for (int32_t y = 0; y < m_count.y; ++y)
+        {
+            for (int32_t z = 0; z < m_count.z; ++z)
+            {
+                std::fill_n(m_row_y.begin(), m_count.x, origin.y + y * m_spacing.y);
+                std::fill_n(m_row_z.begin(), m_count.x, origin.z + z * m_spacing.z);
+
+                m_sampler(m_row_x.data(), m_row_y.data(), m_row_z.data(), &m_points[(y * m_count.z + z) * m_count.x], m_count.x);
+            }
+        }
+
+        m_yz.resize(m_count.x);
+    }
+
+    bool full_resolution() const { return m_spacing == glm::ivec3(1); }
+
+    // the field at the tiles xs[i] of the row at y and z of the box
+    void sample(int32_t y, int32_t z, const int32_t* xs, uint32_t count, double* out)
+    {
+        if (full_resolution())
+        {
+            for (uint32_t i = 0; i < count; ++i)
+                m_row_x[i] = m_origin.x + xs[i];
+
+            std::fill_n(m_row_y.begin(), count, m_origin.y + y);
+            std::fill_n(m_row_z.begin(), count, m_origin.z + z);
+
+            m_sampler(m_row_x.data(), m_row_y.data(), m_row_z.data(), out, count);
+            return;
+        }
+
+        auto [y0, y1, ty] = cell(y, 1);
+        auto [z0, z1, tz] = cell(z, 2);
+
+        // the row of lattice points interpolated to y and z first, then along x for each tile
+        for (int32_t x = 0; x < m_count.x; ++x)
+        {
+            double a = lerp(point(x, y0, z0), point(x, y0, z1), tz);
+            double b = lerp(point(x, y1, z0), point(x, y1, z1), tz);
+
+            m_yz[x] = lerp(a, b, ty);
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            auto [x0, x1, tx] = cell(xs[i], 0);
+            out[i]            = lerp(m_yz[x0], m_yz[x1], tx);
+        }
+    }
+
+private:
+    struct Cell
+    {
+        int32_t p0, p1;
+        double t;
+    };
+
+    // the lattice points around a tile along an axis and where the tile lies between them
+    Cell cell(int32_t tile, int axis) const
+    {
+        int32_t p0 = tile / m_spacing[axis];
+        int32_t p1 = std::min(p0 + 1, m_count[axis] - 1);
+
+        return {p0, p1, static_cast<double>(tile % m_spacing[axis]) / m_spacing[axis]};
+    }
+
+    double point(int32_t x, int32_t y, int32_t z) const { return m_points[(y * m_count.z + z) * m_count.x + x]; }
+
+    static double lerp(double a, double b, double t) { return a + (b - a) * t; }
+
+    Sampler m_sampler;
+
+    glm::ivec3 m_spacing;
+    glm::ivec3 m_origin;
+    glm::ivec3 m_count = {};
+
+    std::vector<double> m_points;
+    std::vector<double> m_yz;
+
+    std::vector<double> m_row_x, m_row_y, m_row_z;
+};
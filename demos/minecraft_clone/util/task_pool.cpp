@@ -0,0 +1,155 @@
+#include "task_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+uint64_t ns_since(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+// the pool and index of the worker running on this thread
+thread_local const TaskPool* current_pool = nullptr;
+thread_local uint32_t current_worker      = 0;
+
+} // namespace
+
+TaskPool::TaskPool(uint32_t worker_count)
+{
+    if (worker_count == 0) worker_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    for (uint32_t i = 0; i < worker_count; ++i)
+        m_workers.push_back(std::make_unique<Worker>());
+
+    for (uint32_t i = 0; i < worker_count; ++i)
+        m_threads.emplace_back([this, i] { worker_func(i); });
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        auto guard = std::lock_guard(m_sleep_lock);
+        m_stopping = true;
+    }
+
+    m_sleep_cv.notify_all();
+    m_threads.clear();
+}
+
+TaskPool& TaskPool::shared()
+{
+    static TaskPool pool;
+    return pool;
+}
+
+void TaskPool::submit(TaskQoS qos, Task task)
+{
+    uint32_t index = current_pool == this ? current_worker : m_next_worker++ % worker_count();
+
+    // counted first so it never drops below 0 when the task is taken right away, and under the sleep lock so a worker
+    // deciding to sleep either sees it or gets woken
+    {
+        auto guard = std::lock_guard(m_sleep_lock);
+        m_queued++;
+    }
+
+    {
+        auto guard = std::lock_guard(m_workers[index]->lock);
+        m_workers[index]->tasks[static_cast<size_t>(qos)].push_back(std::move(task));
+    }
+
+    m_sleep_cv.notify_one();
+}
+
+std::vector<TaskPoolWorkerStats> TaskPool::stats() const
+{
+    std::vector<TaskPoolWorkerStats> stats;
+
+    for (auto& worker : m_workers)
+    {
+        stats.push_back(TaskPoolWorkerStats{
+            .tasks   = worker->task_count.load(),
+            .steals  = worker->steals.load(),
+            .busy_ms = worker->busy_ns.load() / 1e6,
+            .idle_ms = worker->idle_ns.load() / 1e6,
+        });
+    }
+
+    return stats;
+}
+
+std::optional<TaskPool::Task> TaskPool::take(uint32_t index, bool& stolen)
+{
+    uint32_t count = worker_count();
+
+    for (size_t qos = 0; qos < task_qos_count; ++qos)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Worker& worker = *m_workers[(index + i) % count];
+            auto guard     = std::lock_guard(worker.lock);
+
+            auto& tasks = worker.tasks[qos];
+            if (tasks.empty()) continue;
+
+            Task task;
+
+            if (i == 0)
+            {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            stolen = i != 0;
+            m_queued--;
+
+            return task;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void TaskPool::worker_func(uint32_t index)
+{
+    current_pool   = this;
+    current_worker = index;
+
+    Worker& worker = *m_workers[index];
+
+    while (true)
+    {
+        bool stolen = false;
+
+        if (auto task = take(index, stolen))
+        {
+            auto start = Clock::now();
+            (*task)();
+
+            worker.busy_ns += ns_since(start);
+            worker.task_count++;
+            worker.steals += stolen;
+            continue;
+        }
+
+        auto start = Clock::now();
+
+        {
+            auto guard = std::unique_lock(m_sleep_lock);
+            m_sleep_cv.wait(guard, [this] { return m_queued > 0 || m_stopping; });
+
+            if (m_stopping) return;
+        }
+
+        worker.idle_ns += ns_since(start);
+    }
+}
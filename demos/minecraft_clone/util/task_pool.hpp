@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// the classes of tasks in the order they run, a worker only takes a task of a class once none of the classes before
+// it are queued anywhere in the pool
+enum class TaskQoS : uint8_t
+{
+    latency_critical, // remeshing what the player is looking at
+    background,       // generation
+    prefetch,         // anything the player may need later
+};
+
+constexpr size_t task_qos_count = 3;
+
+struct TaskPoolWorkerStats
+{
+    uint64_t tasks;  // run by the worker
+    uint64_t steals; // of them taken from other workers
+    double busy_ms;
+    double idle_ms;
+};
+
+// the workers shared by all background work. every worker has a deque per class, tasks submitted from a worker go to
+// its own deques and the others round robin. workers run their own newest task first and steal the oldest ones of the
+// others when they run out
+class TaskPool
+{
+    TaskPool(const TaskPool&) = delete;
+
+public:
+    using Task = std::function<void()>;
+
+    // 0 workers takes a worker per core but one, which is left to the render thread
+    explicit TaskPool(uint32_t worker_count = 0);
+    // tasks still queued are dropped
+    ~TaskPool();
+
+    // the pool of the engine, sized for the cores of the machine
+    static TaskPool& shared();
+
+    void submit(TaskQoS qos, Task task);
+
+    uint32_t worker_count() const { return static_cast<uint32_t>(m_workers.size()); }
+    std::vector<TaskPoolWorkerStats> stats() const;
+
+private:
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Task> tasks[task_qos_count];
+
+        std::atomic<uint64_t> task_count = 0;
+        std::atomic<uint64_t> steals     = 0;
+        std::atomic<uint64_t> busy_ns    = 0;
+        std::atomic<uint64_t> idle_ns    = 0;
+    };
+
+    void worker_func(uint32_t index);
+    // the task of the first class queued anywhere, from the worker's own deque if it has one
+    std::optional<Task> take(uint32_t index, bool& stolen);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    std::mutex m_sleep_lock;
+    std::condition_variable m_sleep_cv;
+    bool m_stopping = false;
+
+    std::atomic<size_t> m_queued         = 0;
+    std::atomic<uint32_t> m_next_worker = 0;
+
+    std::vector<std::jthread> m_threads;
+};
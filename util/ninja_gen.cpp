@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <regex>
@@ -225,7 +226,7 @@ int main()
 
     builder.compile_flags += " -Isrc/";
 
-    auto compile_sub_project = [&](const std::string& dir, const std::string& exec_name) {
+    auto compile_sub_project = [&](const std::string& dir, const std::string& exec_name, const std::string& defines = "") {
         std::vector<std::string> cpp_files;
         find_files_in_dir_append(cpp_files, dir, ".cpp", true);
 
@@ -238,20 +239,32 @@ int main()
 
         auto glsl_files = find_glsl_files(dir);
 
-        auto glsl_compiler = builder.glsl_compiler();
+        auto glsl_compiler        = builder.glsl_compiler();
+        glsl_compiler.glslc_flags = defines;
 
         for (const auto& glsl_file : glsl_files)
             glsl_compiler.compile_glsl(glsl_file);
 
         cpp_files.push_back(glsl_compiler.embed(fmt::format(".obj_files/{}.cpp", exec_name_raw)));
 
+        std::string compile_flags = builder.compile_flags;
+        builder.compile_flags += defines;
+
         auto obj_files = compile_cpp_files(cpp_files);
         obj_files.push_back(lib_vke);
 
         builder.build_executable(exec_name, fmt::format("{}", fmt::join(obj_files, " ")));
+        builder.compile_flags = compile_flags;
     };
 
+    // chunk dimensions of the minecraft clone, `CHUNK_SIZE_LOG2=4 make` builds it with 16^3 chunks. its c++ and glsl
+    // sources are given the same ones
+    std::string chunk_dims;
+    for (const char* name : {"CHUNK_SIZE_LOG2", "VERTICAL_CHUNK_COUNT"})
+        if (const char* value = std::getenv(name)) chunk_dims += fmt::format(" -D{}={}", name, value);
+
+
     // compile_sub_project("demos/plane_and_cam/", "bin/1.out");
     // compile_sub_project("demos/portals/", "bin/portals.out");
-    compile_sub_project("demos/minecraft_clone/", "bin/mc.out");
+    compile_sub_project("demos/minecraft_clone/", "bin/mc.out", chunk_dims);
 }
\ No newline at end of file